@@ -153,6 +153,48 @@ chat_session_no_activity(const char * const recipient)
     }
 }
 
+/*
+ * Milliseconds until the next session moves to paused, inactive or gone when
+ * nothing else happens, -1 when no session supporting chat states will
+ */
+gint
+chat_sessions_next_state_change(void)
+{
+    gint result = -1;
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, sessions);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        ChatSession session = value;
+        if (!session->recipient_supports || (session->active_timer == NULL)) {
+            continue;
+        }
+
+        gdouble due;
+        if (session->state == CHAT_STATE_GONE) {
+            continue;
+        } else if (session->state == CHAT_STATE_INACTIVE) {
+            if (prefs_get_gone() == 0) {
+                continue;
+            }
+            due = prefs_get_gone() * 60.0;
+        } else if (session->state == CHAT_STATE_COMPOSING) {
+            due = PAUSED_TIMOUT;
+        } else {
+            due = INACTIVE_TIMOUT;
+        }
+
+        // states change once the timeout has passed, not when it is reached
+        gdouble remaining = due - g_timer_elapsed(session->active_timer, NULL);
+        gint ms = (remaining > 0) ? (gint)(remaining * 1000) + 1 : 0;
+        if ((result == -1) || (ms < result)) {
+            result = ms;
+        }
+    }
+
+    return result;
+}
+
 void
 chat_session_set_sent(const char * const recipient)
 {
@@ -56,5 +56,6 @@ gboolean chat_session_is_gone(const char * const recipient);
 void chat_session_set_gone(const char * const recipient);
 void chat_session_set_sent(const char * const recipient);
 gboolean chat_session_get_sent(const char * const recipient);
+gint chat_sessions_next_state_change(void);
 
 #endif
@@ -451,6 +451,23 @@ static struct cmd_t command_defs[] =
           "Example : /duck dennis ritchie",
           NULL } } },
 
+    { "/search",
+        cmd_search, parse_args, 1, 10, NULL,
+        { "/search query", "Search chat and chat room logs.",
+        { "/search query",
+          "-------------",
+          "Search chat and chat room logs for lines containing all the words in the query.",
+          "Use quotes to search for a phrase. The query may also contain:",
+          "with:jid        : Only search logs with this contact or room.",
+          "from:YYYY-MM-DD : Only search logs from this date.",
+          "to:YYYY-MM-DD   : Only search logs up to this date.",
+          "The 100 most recent matches are shown in the search window,",
+          "where further queries may be typed directly.",
+          "",
+          "Example : /search \"release date\" with:room@conference.server.org",
+          "Example : /search profanity from:2014-01-01 to:2014-06-30",
+          NULL } } },
+
     { "/who",
         cmd_who, parse_args, 0, 2, NULL,
         { "/who [status] [group]", "Show contacts/room participants with chosen status.",
@@ -602,6 +619,16 @@ static struct cmd_t command_defs[] =
           "Show information in the window title bar.",
           NULL  } } },
 
+    { "/fps",
+        cmd_fps, parse_args, 1, 1, &cons_fps_setting,
+        { "/fps rate", "Maximum screen refresh rate.",
+        { "/fps rate",
+          "---------",
+          "Set the maximum number of times per second the screen is redrawn.",
+          "Messages received between redraws are shown together on the next one.",
+          "A value of 0 will redraw after every event.",
+          NULL  } } },
+
     { "/mouse",
         cmd_mouse, parse_args, 1, 1, &cons_mouse_setting,
         { "/mouse on|off", "Use profanity mouse handling.",
@@ -719,6 +746,11 @@ static struct cmd_t command_defs[] =
           "rotate  : Rotate log, accepts 'on' or 'off', defaults to 'on'.",
           "maxsize : With rotate enabled, specifies the max log size, defaults to 1048580 (1MB).",
           "shared  : Share logs between all instances, accepts 'on' or 'off', defaults to 'on'.",
+          "flush   : When chat logs are written to disk, accepts 'message', 'timed' or 'idle', defaults to 'timed'.",
+          "          message : after every message.",
+          "          timed   : at most one second after a message.",
+          "          idle    : when there is nothing else to do.",
+          "async   : Write the log file from a background thread, accepts 'on' or 'off', defaults to 'off'.",
           NULL } } },
 
     { "/reconnect",
@@ -944,6 +976,7 @@ static Autocomplete notify_typing_ac;
 static Autocomplete prefs_ac;
 static Autocomplete sub_ac;
 static Autocomplete log_ac;
+static Autocomplete log_flush_ac;
 static Autocomplete autoaway_ac;
 static Autocomplete autoaway_mode_ac;
 static Autocomplete autoconnect_ac;
@@ -1074,6 +1107,13 @@ cmd_init(void)
     autocomplete_add(log_ac, "rotate");
     autocomplete_add(log_ac, "shared");
     autocomplete_add(log_ac, "where");
+    autocomplete_add(log_ac, "flush");
+    autocomplete_add(log_ac, "async");
+
+    log_flush_ac = autocomplete_new();
+    autocomplete_add(log_flush_ac, "message");
+    autocomplete_add(log_flush_ac, "timed");
+    autocomplete_add(log_flush_ac, "idle");
 
     autoaway_ac = autocomplete_new();
     autocomplete_add(autoaway_ac, "mode");
@@ -1252,6 +1292,7 @@ cmd_uninit(void)
     autocomplete_free(sub_ac);
     autocomplete_free(titlebar_ac);
     autocomplete_free(log_ac);
+    autocomplete_free(log_flush_ac);
     autocomplete_free(prefs_ac);
     autocomplete_free(autoaway_ac);
     autocomplete_free(autoaway_mode_ac);
@@ -1376,6 +1417,7 @@ cmd_reset_autocomplete()
     autocomplete_reset(who_ac);
     autocomplete_reset(prefs_ac);
     autocomplete_reset(log_ac);
+    autocomplete_reset(log_flush_ac);
     autocomplete_reset(commands_ac);
     autocomplete_reset(autoaway_ac);
     autocomplete_reset(autoaway_mode_ac);
@@ -1574,6 +1616,14 @@ cmd_execute_default(const char * inp)
             }
             break;
 
+        case WIN_SEARCH:
+        {
+            gchar *search = g_strdup_printf("/search %s", inp);
+            cmd_execute("/search", search);
+            g_free(search);
+            break;
+        }
+
         default:
             break;
     }
@@ -1998,6 +2048,16 @@ _log_autocomplete(char *input, int *size)
     if (result != NULL) {
         return result;
     }
+    result = autocomplete_param_with_func(input, size, "/log async",
+        prefs_autocomplete_boolean_choice);
+    if (result != NULL) {
+        return result;
+    }
+    result = autocomplete_param_with_ac(input, size, "/log flush", log_flush_ac, TRUE);
+    if (result != NULL) {
+        return result;
+    }
+
     result = autocomplete_param_with_ac(input, size, "/log", log_ac, TRUE);
     if (result != NULL) {
         return result;
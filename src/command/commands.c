@@ -59,6 +59,7 @@
 #include "otr/otr.h"
 #endif
 #include "profanity.h"
+#include "search.h"
 #include "tools/autocomplete.h"
 #include "tools/parser.h"
 #include "tools/tinyurl.h"
@@ -583,8 +584,8 @@ cmd_help(gchar **args, struct cmd_help_t help)
 
     } else if (strcmp(args[0], "chatting") == 0) {
         gchar *filter[] = { "/chlog", "/otr", "/duck", "/gone", "/history",
-            "/info", "/intype", "/msg", "/notify", "/outtype", "/status",
-            "/close", "/clear", "/tiny" };
+            "/info", "/intype", "/msg", "/notify", "/outtype", "/search",
+            "/status", "/close", "/clear", "/tiny" };
         _cmd_show_filtered_help("Chat commands", filter, ARRAY_SIZE(filter));
 
     } else if (strcmp(args[0], "groupchat") == 0) {
@@ -612,11 +613,11 @@ cmd_help(gchar **args, struct cmd_help_t help)
             "/chlog", "/flash", "/gone", "/grlog", "/history", "/intype",
             "/log", "/mouse", "/notify", "/outtype", "/prefs", "/priority",
             "/reconnect", "/roster", "/splash", "/states", "/statuses", "/theme",
-            "/titlebar", "/vercheck" };
+            "/titlebar", "/fps", "/vercheck" };
         _cmd_show_filtered_help("Settings commands", filter, ARRAY_SIZE(filter));
 
     } else if (strcmp(args[0], "other") == 0) {
-        gchar *filter[] = { "/duck", "/vercheck" };
+        gchar *filter[] = { "/duck", "/search", "/vercheck" };
         _cmd_show_filtered_help("Other commands", filter, ARRAY_SIZE(filter));
 
     } else if (strcmp(args[0], "navigation") == 0) {
@@ -1402,6 +1403,46 @@ cmd_duck(gchar **args, struct cmd_help_t help)
     return TRUE;
 }
 
+gboolean
+cmd_search(gchar **args, struct cmd_help_t help)
+{
+    jabber_conn_status_t conn_status = jabber_get_connection_status();
+
+    if (conn_status != JABBER_CONNECTED) {
+        cons_show("You are not currently connected.");
+        return TRUE;
+    }
+
+    Jid *jidp = jid_create(jabber_get_fulljid());
+    GSList *results = NULL;
+    if (search_query(jidp->barejid, args, &results)) {
+        // show phrases quoted as they were entered
+        GString *query = g_string_new("");
+        int i;
+        for (i = 0; args[i] != NULL; i++) {
+            if (i > 0) {
+                g_string_append(query, " ");
+            }
+            if (strchr(args[i], ' ') != NULL) {
+                g_string_append_printf(query, "\"%s\"", args[i]);
+            } else {
+                g_string_append(query, args[i]);
+            }
+        }
+        ui_search_results(query->str, results);
+        g_string_free(query, TRUE);
+        g_slist_free_full(results, g_free);
+        if (!search_built(jidp->barejid)) {
+            cons_show("The search index is still being built, older logs may be missing from the results.");
+        }
+    } else {
+        cons_show("Usage: %s", help.usage);
+    }
+    jid_destroy(jidp);
+
+    return TRUE;
+}
+
 gboolean
 cmd_status(gchar **args, struct cmd_help_t help)
 {
@@ -2823,6 +2864,28 @@ cmd_log(gchar **args, struct cmd_help_t help)
         return result;
     }
 
+    if (strcmp(subcmd, "flush") == 0) {
+        if ((g_strcmp0(value, "message") != 0) && (g_strcmp0(value, "timed") != 0) &&
+                (g_strcmp0(value, "idle") != 0)) {
+            cons_show("Usage: %s", help.usage);
+            return TRUE;
+        }
+        prefs_set_string(PREF_LOG_FLUSH, value);
+        chat_log_update_flush_policy();
+        cons_show("Chat log flush set to: %s", value);
+        return TRUE;
+    }
+
+    if (strcmp(subcmd, "async") == 0) {
+        if (value == NULL) {
+            cons_show("Usage: %s", help.usage);
+            return TRUE;
+        }
+        gboolean result = _cmd_set_boolean_preference(value, help, "Async log", PREF_LOG_ASYNC);
+        log_reinit();
+        return result;
+    }
+
     if (strcmp(subcmd, "where") == 0) {
         char *logfile = get_log_file_location();
         cons_show("Log file: %s", logfile);
@@ -2856,6 +2919,26 @@ cmd_reconnect(gchar **args, struct cmd_help_t help)
     return TRUE;
 }
 
+gboolean
+cmd_fps(gchar **args, struct cmd_help_t help)
+{
+    char *value = args[0];
+    int intval;
+
+    if (_strtoi(value, &intval, 0, INT_MAX) == 0) {
+        prefs_set_max_fps(intval);
+        if (intval == 0) {
+            cons_show("Frame rate limit disabled.");
+        } else {
+            cons_show("Frame rate limit set to %d per second.", intval);
+        }
+    } else {
+        cons_show("Usage: %s", help.usage);
+    }
+
+    return TRUE;
+}
+
 gboolean
 cmd_autoping(gchar **args, struct cmd_help_t help)
 {
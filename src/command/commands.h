@@ -80,6 +80,7 @@ gboolean cmd_disco(gchar **args, struct cmd_help_t help);
 gboolean cmd_disconnect(gchar **args, struct cmd_help_t help);
 gboolean cmd_dnd(gchar **args, struct cmd_help_t help);
 gboolean cmd_duck(gchar **args, struct cmd_help_t help);
+gboolean cmd_search(gchar **args, struct cmd_help_t help);
 gboolean cmd_flash(gchar **args, struct cmd_help_t help);
 gboolean cmd_gone(gchar **args, struct cmd_help_t help);
 gboolean cmd_grlog(gchar **args, struct cmd_help_t help);
@@ -117,6 +118,7 @@ gboolean cmd_sub(gchar **args, struct cmd_help_t help);
 gboolean cmd_theme(gchar **args, struct cmd_help_t help);
 gboolean cmd_tiny(gchar **args, struct cmd_help_t help);
 gboolean cmd_titlebar(gchar **args, struct cmd_help_t help);
+gboolean cmd_fps(gchar **args, struct cmd_help_t help);
 gboolean cmd_vercheck(gchar **args, struct cmd_help_t help);
 gboolean cmd_who(gchar **args, struct cmd_help_t help);
 gboolean cmd_win(gchar **args, struct cmd_help_t help);
@@ -32,14 +32,14 @@
  *
  */
 
+#include <glib.h>
+
 #include "tools/history.h"
 
 #define MAX_HISTORY 100
 
 static History history;
 
-void _stringify_input(char *inp, int size, char *string);
-
 void
 cmd_history_init(void)
 {
@@ -55,27 +55,20 @@ cmd_history_append(char *inp)
 char *
 cmd_history_previous(char *inp, int *size)
 {
-    char inp_str[*size + 1];
-    _stringify_input(inp, *size, inp_str);
+    // the input can be any length, keep it off the stack
+    char *inp_str = g_strndup(inp, *size);
+    char *result = history_previous(history, inp_str);
+    g_free(inp_str);
 
-    return history_previous(history, inp_str);
+    return result;
 }
 
 char *
 cmd_history_next(char *inp, int *size)
 {
-    char inp_str[*size + 1];
-    _stringify_input(inp, *size, inp_str);
-
-    return history_next(history, inp_str);
-}
+    char *inp_str = g_strndup(inp, *size);
+    char *result = history_next(history, inp_str);
+    g_free(inp_str);
 
-void
-_stringify_input(char *inp, int size, char *string)
-{
-    int i;
-    for (i = 0; i < size; i++) {
-        string[i] = inp[i];
-    }
-    string[size] = '\0';
+    return result;
 }
@@ -45,7 +45,7 @@
 #include <curl/easy.h>
 #include <glib.h>
 
-#include "tools/p_sha1.h"
+#include "tools/sha1.h"
 
 #include "log.h"
 #include "common.h"
@@ -430,16 +430,9 @@ create_unique_id(char *prefix)
 char *
 p_sha1_hash(char *str)
 {
-    P_SHA1_CTX ctx;
-    uint8_t digest[20];
-    uint8_t *input = (uint8_t*)malloc(strlen(str) + 1);
-    memcpy(input, str, strlen(str) + 1);
+    unsigned char digest[SHA1_DIGEST_SIZE];
+    sha1_digest(str, strlen(str), digest);
 
-    P_SHA1_Init(&ctx);
-    P_SHA1_Update(&ctx, input, strlen(str));
-    P_SHA1_Final(&ctx, digest);
-
-    free(input);
     return g_base64_encode(digest, sizeof(digest));
 }
 
@@ -506,6 +499,54 @@ get_next_available_win_num(GList *used)
 }
 
 
+static void
+_delayed_write_run(DelayedWrite *dw)
+{
+    if (dw->source != 0) {
+        g_source_remove(dw->source);
+        dw->source = 0;
+    }
+    if (dw->deadline != 0) {
+        g_source_remove(dw->deadline);
+        dw->deadline = 0;
+    }
+    dw->write();
+}
+
+static gboolean
+_delayed_write_fired(gpointer data)
+{
+    _delayed_write_run(data);
+    return FALSE;
+}
+
+/*
+ * Note a change, each one pushes the write back by delay_ms up to the
+ * deadline set by the first
+ */
+void
+delayed_write_schedule(DelayedWrite *dw)
+{
+    if (dw->source != 0) {
+        g_source_remove(dw->source);
+    }
+    dw->source = g_timeout_add(dw->delay_ms, _delayed_write_fired, dw);
+    if (dw->deadline == 0) {
+        dw->deadline = g_timeout_add(dw->max_ms, _delayed_write_fired, dw);
+    }
+}
+
+/*
+ * Write any pending changes now
+ */
+void
+delayed_write_flush(DelayedWrite *dw)
+{
+    if (dw->source != 0) {
+        _delayed_write_run(dw);
+    }
+}
+
 static size_t
 _data_callback(void *ptr, size_t size, size_t nmemb, void *data)
 {
@@ -88,6 +88,19 @@ typedef enum {
     RESOURCE_XA
 } resource_presence_t;
 
+// longest a write is put off after the first unsaved change
+#define DELAYED_WRITE_MAX_MS 5000
+
+// writes once changes stop arriving for delay_ms, but no later than max_ms
+// after the first change that has not been written
+typedef struct delayed_write_t {
+    guint delay_ms;
+    guint max_ms;
+    void (*write)(void);
+    guint source;
+    guint deadline;
+} DelayedWrite;
+
 gchar* p_utf8_substring(const gchar *str, glong start_pos, glong end_pos);
 void p_slist_free_full(GSList *items, GDestroyNotify free_func);
 void p_list_free_full(GList *items, GDestroyNotify free_func);
@@ -113,6 +126,9 @@ contact_presence_t contact_presence_from_resource_presence(resource_presence_t r
 char * p_sha1_hash(char *str);
 char * create_unique_id(char *prefix);
 
+void delayed_write_schedule(DelayedWrite *dw);
+void delayed_write_flush(DelayedWrite *dw);
+
 int cmp_win_num(gconstpointer a, gconstpointer b);
 int get_next_available_win_num(GList *used);
 
@@ -46,6 +46,9 @@
 #include "tools/autocomplete.h"
 #include "xmpp/xmpp.h"
 
+// write changes once no more have arrived for this long
+#define ACCOUNTS_SAVE_DELAY_MS 500
+
 static gchar *accounts_loc;
 static GKeyFile *accounts;
 
@@ -68,9 +71,13 @@ static gchar *string_keys[] = {
 
 static void _fix_legacy_accounts(const char * const account_name);
 static void _save_accounts(void);
+static void _write_accounts(void);
 static gchar * _get_accounts_file(void);
 static void _remove_from_list(GKeyFile *accounts, const char * const account_name, const char * const key, const char * const contact_jid);
 
+static DelayedWrite accounts_write = { ACCOUNTS_SAVE_DELAY_MS,
+    DELAYED_WRITE_MAX_MS, _write_accounts, 0, 0 };
+
 
 static void
 _accounts_load(void)
@@ -105,6 +112,7 @@ _accounts_load(void)
 static void
 _accounts_close(void)
 {
+    delayed_write_flush(&accounts_write);
     autocomplete_free(all_ac);
     autocomplete_free(enabled_ac);
     g_key_file_free(accounts);
@@ -800,6 +808,12 @@ _fix_legacy_accounts(const char * const account_name)
 
 static void
 _save_accounts(void)
+{
+    delayed_write_schedule(&accounts_write);
+}
+
+static void
+_write_accounts(void)
 {
     gsize g_data_size;
     gchar *g_accounts_data = g_key_file_to_data(accounts, &g_data_size, NULL);
@@ -59,18 +59,36 @@
 #define PREF_GROUP_ALIAS "alias"
 #define PREF_GROUP_OTR "otr"
 
+// write changes once no more have arrived for this long
+#define PREFS_SAVE_DELAY_MS 500
+
+// current value of each preference, with defaults applied
+typedef struct pref_value_t {
+    gboolean boolean;
+    char *string;
+} PrefValue;
+
 static gchar *prefs_loc;
 static GKeyFile *prefs;
+static PrefValue values[PREF_COUNT];
 gint log_maxsize = 0;
+static gint max_fps = PREFS_DEFAULT_MAX_FPS;
 
 static Autocomplete boolean_choice_ac;
 
 static void _save_prefs(void);
+static void _write_prefs(void);
 static gchar * _get_preferences_file(void);
 static const char * _get_group(preference_t pref);
 static const char * _get_key(preference_t pref);
 static gboolean _get_default_boolean(preference_t pref);
 static char * _get_default_string(preference_t pref);
+static gint _get_buffer_size(const char * const key, gint def);
+static void _value_update(preference_t pref);
+static void _values_free(void);
+
+static DelayedWrite prefs_write = { PREFS_SAVE_DELAY_MS, DELAYED_WRITE_MAX_MS,
+    _write_prefs, 0, 0 };
 
 void
 prefs_load(void)
@@ -91,6 +109,13 @@ prefs_load(void)
         g_error_free(err);
     }
 
+    // read on every main loop iteration, so kept outside the key file
+    if (g_key_file_has_key(prefs, PREF_GROUP_UI, "fps", NULL)) {
+        max_fps = g_key_file_get_integer(prefs, PREF_GROUP_UI, "fps", NULL);
+    } else {
+        max_fps = PREFS_DEFAULT_MAX_FPS;
+    }
+
     // move pre 0.4.1 OTR preferences to [otr] group
     err = NULL;
     gboolean ui_otr_warn = g_key_file_get_boolean(prefs, PREF_GROUP_UI, "otr.warn", &err);
@@ -121,6 +146,11 @@ prefs_load(void)
 
     _save_prefs();
 
+    preference_t pref;
+    for (pref = 0; pref < PREF_COUNT; pref++) {
+        _value_update(pref);
+    }
+
     boolean_choice_ac = autocomplete_new();
     autocomplete_add(boolean_choice_ac, "on");
     autocomplete_add(boolean_choice_ac, "off");
@@ -129,9 +159,11 @@ prefs_load(void)
 void
 prefs_close(void)
 {
+    prefs_save();
     autocomplete_free(boolean_choice_ac);
     g_key_file_free(prefs);
     prefs = NULL;
+    _values_free();
 }
 
 char *
@@ -149,15 +181,11 @@ prefs_reset_boolean_choice(void)
 gboolean
 prefs_get_boolean(preference_t pref)
 {
-    const char *group = _get_group(pref);
-    const char *key = _get_key(pref);
-    gboolean def = _get_default_boolean(pref);
-
-    if (!g_key_file_has_key(prefs, group, key, NULL)) {
-        return def;
+    if (prefs == NULL) {
+        return _get_default_boolean(pref);
     }
 
-    return g_key_file_get_boolean(prefs, group, key, NULL);
+    return values[pref].boolean;
 }
 
 void
@@ -166,27 +194,33 @@ prefs_set_boolean(preference_t pref, gboolean value)
     const char *group = _get_group(pref);
     const char *key = _get_key(pref);
     g_key_file_set_boolean(prefs, group, key, value);
+    _value_update(pref);
     _save_prefs();
 }
 
 char *
 prefs_get_string(preference_t pref)
 {
-    const char *group = _get_group(pref);
-    const char *key = _get_key(pref);
-    char *def = _get_default_string(pref);
+    const char *value = prefs_get_string_value(pref);
+    if (value == NULL) {
+        return NULL;
+    }
 
-    char *result = g_key_file_get_string(prefs, group, key, NULL);
+    return strdup(value);
+}
 
-    if (result == NULL) {
-        if (def != NULL) {
-            return strdup(def);
-        } else {
-            return NULL;
-        }
-    } else {
-        return result;
+/*
+ * Get a string preference without copying it, the value is only valid until
+ * the preference is next set
+ */
+const char *
+prefs_get_string_value(preference_t pref)
+{
+    if (prefs == NULL) {
+        return _get_default_string(pref);
     }
+
+    return values[pref].string;
 }
 
 void
@@ -209,6 +243,7 @@ prefs_set_string(preference_t pref, char *value)
     } else {
         g_key_file_set_string(prefs, group, key, value);
     }
+    _value_update(pref);
     _save_prefs();
 }
 
@@ -255,6 +290,38 @@ prefs_set_max_log_size(gint value)
     _save_prefs();
 }
 
+gint
+prefs_get_max_fps(void)
+{
+    return max_fps;
+}
+
+void
+prefs_set_max_fps(gint value)
+{
+    max_fps = value;
+    g_key_file_set_integer(prefs, PREF_GROUP_UI, "fps", value);
+    _save_prefs();
+}
+
+gint
+prefs_get_buffer_console(void)
+{
+    return _get_buffer_size("buffer.console", PREFS_DEFAULT_BUFFER_CONSOLE);
+}
+
+gint
+prefs_get_buffer_chat(void)
+{
+    return _get_buffer_size("buffer.chat", PREFS_DEFAULT_BUFFER_CHAT);
+}
+
+gint
+prefs_get_buffer_muc(void)
+{
+    return _get_buffer_size("buffer.muc", PREFS_DEFAULT_BUFFER_MUC);
+}
+
 gint
 prefs_get_priority(void)
 {
@@ -395,8 +462,23 @@ prefs_free_aliases(GList *aliases)
     g_list_free_full(aliases, (GDestroyNotify)_free_alias);
 }
 
+/*
+ * Write any pending changes now
+ */
+void
+prefs_save(void)
+{
+    delayed_write_flush(&prefs_write);
+}
+
 static void
 _save_prefs(void)
+{
+    delayed_write_schedule(&prefs_write);
+}
+
+static void
+_write_prefs(void)
 {
     gsize g_data_size;
     gchar *g_prefs_data = g_key_file_to_data(prefs, &g_data_size, NULL);
@@ -454,6 +536,8 @@ _get_group(preference_t pref)
         case PREF_GRLOG:
         case PREF_LOG_ROTATE:
         case PREF_LOG_SHARED:
+        case PREF_LOG_FLUSH:
+        case PREF_LOG_ASYNC:
             return PREF_GROUP_LOGGING;
         case PREF_AUTOAWAY_CHECK:
         case PREF_AUTOAWAY_MODE:
@@ -547,6 +631,10 @@ _get_key(preference_t pref)
             return "rotate";
         case PREF_LOG_SHARED:
             return "shared";
+        case PREF_LOG_FLUSH:
+            return "flush";
+        case PREF_LOG_ASYNC:
+            return "async";
         default:
             return NULL;
     }
@@ -584,6 +672,8 @@ _get_default_string(preference_t pref)
             return "redact";
         case PREF_OTR_POLICY:
             return "manual";
+        case PREF_LOG_FLUSH:
+            return "timed";
         case PREF_STATUSES_CONSOLE:
         case PREF_STATUSES_CHAT:
         case PREF_STATUSES_MUC:
@@ -592,3 +682,54 @@ _get_default_string(preference_t pref)
             return NULL;
     }
 }
+
+static void
+_value_update(preference_t pref)
+{
+    const char *group = _get_group(pref);
+    const char *key = _get_key(pref);
+    PrefValue *value = &values[pref];
+
+    if (g_key_file_has_key(prefs, group, key, NULL)) {
+        value->boolean = g_key_file_get_boolean(prefs, group, key, NULL);
+    } else {
+        value->boolean = _get_default_boolean(pref);
+    }
+
+    free(value->string);
+    value->string = g_key_file_get_string(prefs, group, key, NULL);
+    if (value->string == NULL) {
+        char *def = _get_default_string(pref);
+        if (def != NULL) {
+            value->string = strdup(def);
+        }
+    }
+}
+
+static void
+_values_free(void)
+{
+    preference_t pref;
+    for (pref = 0; pref < PREF_COUNT; pref++) {
+        free(values[pref].string);
+        values[pref].string = NULL;
+    }
+}
+
+// sizes that could not hold a line fall back to the default
+static gint
+_get_buffer_size(const char * const key, gint def)
+{
+    if (!g_key_file_has_key(prefs, PREF_GROUP_UI, key, NULL)) {
+        return def;
+    }
+
+    gint size = g_key_file_get_integer(prefs, PREF_GROUP_UI, key, NULL);
+    if (size < 1) {
+        return def;
+    } else if (size > PREFS_MAX_BUFFER_SIZE) {
+        return PREFS_MAX_BUFFER_SIZE;
+    } else {
+        return size;
+    }
+}
@@ -46,6 +46,13 @@
 
 #define PREFS_MIN_LOG_SIZE 64
 #define PREFS_MAX_LOG_SIZE 1048580
+#define PREFS_DEFAULT_MAX_FPS 30
+
+// entries kept in a window's buffer, by window type
+#define PREFS_DEFAULT_BUFFER_CONSOLE 500
+#define PREFS_DEFAULT_BUFFER_CHAT 1200
+#define PREFS_DEFAULT_BUFFER_MUC 2000
+#define PREFS_MAX_BUFFER_SIZE 100000
 
 typedef enum {
     PREF_SPLASH,
@@ -81,9 +88,13 @@ typedef enum {
     PREF_CONNECT_ACCOUNT,
     PREF_LOG_ROTATE,
     PREF_LOG_SHARED,
+    PREF_LOG_FLUSH,
+    PREF_LOG_ASYNC,
     PREF_OTR_LOG,
     PREF_OTR_WARN,
-    PREF_OTR_POLICY
+    PREF_OTR_POLICY,
+    // number of preferences, keep last
+    PREF_COUNT
 } preference_t;
 
 typedef struct prof_alias_t {
@@ -93,6 +104,7 @@ typedef struct prof_alias_t {
 
 void prefs_load(void);
 void prefs_close(void);
+void prefs_save(void);
 
 char * prefs_find_login(char *prefix);
 void prefs_reset_login_search(void);
@@ -107,6 +119,11 @@ gint prefs_get_notify_remind(void);
 
 void prefs_set_max_log_size(gint value);
 gint prefs_get_max_log_size(void);
+void prefs_set_max_fps(gint value);
+gint prefs_get_max_fps(void);
+gint prefs_get_buffer_console(void);
+gint prefs_get_buffer_chat(void);
+gint prefs_get_buffer_muc(void);
 gint prefs_get_priority(void);
 void prefs_set_reconnect(gint value);
 gint prefs_get_reconnect(void);
@@ -127,6 +144,7 @@ void prefs_free_aliases(GList *aliases);
 gboolean prefs_get_boolean(preference_t pref);
 void prefs_set_boolean(preference_t pref, gboolean value);
 char * prefs_get_string(preference_t pref);
+const char * prefs_get_string_value(preference_t pref);
 void prefs_free_string(char *pref);
 void prefs_set_string(preference_t pref, char *value);
 
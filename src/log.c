@@ -34,37 +34,120 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
+#include <sys/stat.h>
 
 #include "glib.h"
 
 #include "log.h"
 
 #include "common.h"
+#include "search.h"
 #include "config/preferences.h"
 
 #define PROF "prof"
 
 static FILE *logp;
+static long logp_size;
 GString *mainlogfile;
 
-static GTimeZone *tz;
-static GDateTime *dt;
-static log_level_t level_filter;
+log_level_t log_level_filter;
+
+// max size of the main log before it is rotated, 0 when not rotating
+static gint rotate_size;
+
+// With /log async on, formatted records are passed to a writer thread
+// through a ring buffer. Records are only added from the main thread and
+// only removed by the writer, so the ring needs no lock. The writer sleeps
+// on writer_wake when the ring is empty.
+#define LOG_RING_SIZE 1024
+
+static gchar *ring[LOG_RING_SIZE];
+static gint ring_head;
+static gint ring_tail;
+static gint ring_dropped;
+
+static gboolean writer_started;
+static gint writer_running;
+static gint writer_waiting;
+static pthread_t writer_thread;
+static pthread_mutex_t writer_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t writer_wake = PTHREAD_COND_INITIALIZER;
 
 static GHashTable *logs;
 static GHashTable *groupchat_logs;
 static GDateTime *session_started;
 
+// chat log files are kept open, closing the least recently used when
+// more than CHAT_LOG_MAX_OPEN are open
+#define CHAT_LOG_MAX_OPEN 32
+#define CHAT_LOG_BUFFER_SIZE 4096
+#define CHAT_LOG_FLUSH_INTERVAL_MS 1000
+
+typedef enum {
+    CHAT_LOG_FLUSH_MESSAGE,
+    CHAT_LOG_FLUSH_TIMED,
+    CHAT_LOG_FLUSH_IDLE
+} chat_log_flush_t;
+
+static chat_log_flush_t flush_policy;
+static guint flush_source;
+static int open_logs;
+static guint64 last_use;
+
 struct dated_chat_log {
     gchar *filename;
     GDateTime *date;
+    FILE *fp;
+    char *buffer;
+    guint64 last_used;
+    gboolean dirty;
+};
+
+static gboolean _log_roll_needed(struct dated_chat_log *dated_log,
+    struct tm *now);
+static FILE * _log_open(struct dated_chat_log *dated_log);
+static guint32 _log_date(struct tm *tm);
+static void _log_written(struct dated_chat_log *dated_log);
+static void _log_close_file(struct dated_chat_log *dated_log);
+static void _log_close_lru(void);
+static void _flush_all(void);
+static gboolean _flush_source_fired(gpointer data);
+
+#define HISTORY_READ_BLOCK 4096
+
+// day log files that exist for a contact, oldest first
+struct history_index {
+    GPtrArray *days;
+    GDateTime *next_day;
+};
+
+struct history_day {
+    guint32 date;
+    gchar *filename;
+    gchar *header;
 };
 
-static gboolean _log_roll_needed(struct dated_chat_log *dated_log);
+// history indexes, keyed on login and recipient
+static GHashTable *history_indexes;
+
+static struct history_index * _history_index_get(const gchar * const login,
+    const gchar * const recipient);
+static void _free_history_index(struct history_index *index);
+static GSList * _read_lines_before(const char * const filename, long end,
+    int max_lines, long *start, int *count);
+static GSList * _read_lines(FILE *fp, long start, long end, int *count);
+static long _file_size(const char * const filename);
+static gchar * _get_log_dir(const char * const login,
+    const char * const recipient, gboolean room);
+static gchar * _get_day_filename(const char * const dir, guint32 date);
+static guint32 _log_day_before(const char * const dir, guint32 date);
+static char * _day_header(guint32 date);
 static struct dated_chat_log * _create_log(char *other, const  char * const login);
 static struct dated_chat_log * _create_groupchat_log(char *room, const char * const login);
 static void _free_chat_log(struct dated_chat_log *dated_log);
@@ -75,73 +158,51 @@ static char * _get_groupchat_log_filename(const char * const room,
     const char * const login, GDateTime *dt, gboolean create);
 static gchar * _get_chatlog_dir(void);
 static gchar * _get_main_log_file(void);
+static gchar * _log_record(log_level_t level, const char * const area,
+    const char * const msg);
+static void _log_write(const char * const record);
 static void _rotate_log_file(void);
+static void _writer_start(void);
+static void _writer_stop(void);
+static void _writer_push(gchar *record);
+static void * _writer_run(void *data);
 static char* _log_string_from_level(log_level_t level);
 
 void
-log_debug(const char * const msg, ...)
-{
-    va_list arg;
-    va_start(arg, msg);
-    GString *fmt_msg = g_string_new(NULL);
-    g_string_vprintf(fmt_msg, msg, arg);
-    log_msg(PROF_LEVEL_DEBUG, PROF, fmt_msg->str);
-    g_string_free(fmt_msg, TRUE);
-    va_end(arg);
-}
-
-void
-log_info(const char * const msg, ...)
+log_format(log_level_t level, const char * const msg, ...)
 {
     va_list arg;
     va_start(arg, msg);
-    GString *fmt_msg = g_string_new(NULL);
-    g_string_vprintf(fmt_msg, msg, arg);
-    log_msg(PROF_LEVEL_INFO, PROF, fmt_msg->str);
-    g_string_free(fmt_msg, TRUE);
-    va_end(arg);
-}
-
-void
-log_warning(const char * const msg, ...)
-{
-    va_list arg;
-    va_start(arg, msg);
-    GString *fmt_msg = g_string_new(NULL);
-    g_string_vprintf(fmt_msg, msg, arg);
-    log_msg(PROF_LEVEL_WARN, PROF, fmt_msg->str);
-    g_string_free(fmt_msg, TRUE);
-    va_end(arg);
-}
-
-void
-log_error(const char * const msg, ...)
-{
-    va_list arg;
-    va_start(arg, msg);
-    GString *fmt_msg = g_string_new(NULL);
-    g_string_vprintf(fmt_msg, msg, arg);
-    log_msg(PROF_LEVEL_ERROR, PROF, fmt_msg->str);
-    g_string_free(fmt_msg, TRUE);
+    gchar *fmt_msg = g_strdup_vprintf(msg, arg);
+    log_msg(level, PROF, fmt_msg);
+    g_free(fmt_msg);
     va_end(arg);
 }
 
 void
 log_init(log_level_t filter)
 {
-    level_filter = filter;
-    tz = g_time_zone_new_local();
+    log_level_filter = filter;
     gchar *log_file = _get_main_log_file();
     logp = fopen(log_file, "a");
+    logp_size = 0;
+    if (logp != NULL) {
+        fseek(logp, 0, SEEK_END);
+        logp_size = ftell(logp);
+    }
     mainlogfile = g_string_new(log_file);
     free(log_file);
+
+    if ((logp != NULL) && prefs_get_boolean(PREF_LOG_ASYNC)) {
+        _writer_start();
+    }
 }
 
 void
 log_reinit(void)
 {
     log_close();
-    log_init(level_filter);
+    log_init(log_level_filter);
 }
 
 char *
@@ -153,41 +214,40 @@ get_log_file_location(void)
 log_level_t
 log_get_filter(void)
 {
-    return level_filter;
+    return log_level_filter;
 }
 
 void
 log_close(void)
 {
+    _writer_stop();
     g_string_free(mainlogfile, TRUE);
-    g_time_zone_unref(tz);
     if (logp != NULL) {
         fclose(logp);
+        logp = NULL;
     }
 }
 
 void
 log_msg(log_level_t level, const char * const area, const char * const msg)
 {
-    if (level >= level_filter && logp != NULL) {
-        dt = g_date_time_new_now(tz);
-
-        char *level_str = _log_string_from_level(level);
-
-        gchar *date_fmt = g_date_time_format(dt, "%d/%m/%Y %H:%M:%S");
+    if (level < log_level_filter) {
+        return;
+    }
 
-        fprintf(logp, "%s: %s: %s: %s\n", date_fmt, area, level_str, msg);
-        g_date_time_unref(dt);
+    if (prefs_get_boolean(PREF_LOG_ROTATE)) {
+        g_atomic_int_set(&rotate_size, prefs_get_max_log_size());
+    } else {
+        g_atomic_int_set(&rotate_size, 0);
+    }
 
+    if (writer_started) {
+        _writer_push(_log_record(level, area, msg));
+    } else if (logp != NULL) {
+        gchar *record = _log_record(level, area, msg);
+        _log_write(record);
+        g_free(record);
         fflush(logp);
-        g_free(date_fmt);
-
-        if (prefs_get_boolean(PREF_LOG_ROTATE)) {
-            long result = ftell(logp);
-            if (result != -1 && result >= prefs_get_max_log_size()) {
-                _rotate_log_file();
-            }
-        }
     }
 }
 
@@ -208,10 +268,44 @@ log_level_from_string(char *log_level)
     }
 }
 
+static gchar *
+_log_record(log_level_t level, const char * const area, const char * const msg)
+{
+    time_t now = time(NULL);
+    struct tm now_tm;
+    localtime_r(&now, &now_tm);
+    char date_fmt[32];
+    strftime(date_fmt, sizeof(date_fmt), "%d/%m/%Y %H:%M:%S", &now_tm);
+
+    return g_strdup_printf("%s: %s: %s: %s\n", date_fmt, area,
+        _log_string_from_level(level), msg);
+}
+
+/*
+ * Write a record to the main log, rotating it when it grows too large. Called
+ * from the writer thread when it is running.
+ */
+static void
+_log_write(const char * const record)
+{
+    if (logp == NULL) {
+        return;
+    }
+
+    if (fputs(record, logp) != EOF) {
+        logp_size += strlen(record);
+    }
+
+    gint max_size = g_atomic_int_get(&rotate_size);
+    if ((max_size > 0) && (logp_size >= max_size)) {
+        _rotate_log_file();
+    }
+}
+
 static void
 _rotate_log_file(void)
 {
-    gchar *log_file = _get_main_log_file();
+    gchar *log_file = mainlogfile->str;
     size_t len = strlen(log_file);
     char *log_file_new = malloc(len + 3);
 
@@ -220,13 +314,120 @@ _rotate_log_file(void)
     log_file_new[len+1] = '1';
     log_file_new[len+2] = 0;
 
-    log_close();
+    fclose(logp);
     rename(log_file, log_file_new);
-    log_init(log_get_filter());
+    logp = fopen(log_file, "a");
+    logp_size = 0;
 
     free(log_file_new);
-    free(log_file);
-    log_info("Log has been rotated");
+
+    gchar *record = _log_record(PROF_LEVEL_INFO, PROF, "Log has been rotated");
+    _log_write(record);
+    g_free(record);
+}
+
+static void
+_writer_start(void)
+{
+    g_atomic_int_set(&ring_head, 0);
+    g_atomic_int_set(&ring_tail, 0);
+    g_atomic_int_set(&ring_dropped, 0);
+    g_atomic_int_set(&writer_running, 1);
+    if (pthread_create(&writer_thread, NULL, _writer_run, NULL) == 0) {
+        writer_started = TRUE;
+    } else {
+        g_atomic_int_set(&writer_running, 0);
+    }
+}
+
+/*
+ * Stop the writer thread once it has written all queued records
+ */
+static void
+_writer_stop(void)
+{
+    if (!writer_started) {
+        return;
+    }
+
+    pthread_mutex_lock(&writer_lock);
+    g_atomic_int_set(&writer_running, 0);
+    pthread_cond_signal(&writer_wake);
+    pthread_mutex_unlock(&writer_lock);
+
+    pthread_join(writer_thread, NULL);
+    writer_started = FALSE;
+}
+
+static void
+_writer_push(gchar *record)
+{
+    gint head = g_atomic_int_get(&ring_head);
+    gint next = (head + 1) % LOG_RING_SIZE;
+
+    // writer is behind, drop rather than wait for the disk
+    if (next == g_atomic_int_get(&ring_tail)) {
+        g_atomic_int_inc(&ring_dropped);
+        g_free(record);
+        return;
+    }
+
+    ring[head] = record;
+    g_atomic_int_set(&ring_head, next);
+
+    if (g_atomic_int_get(&writer_waiting)) {
+        pthread_mutex_lock(&writer_lock);
+        pthread_cond_signal(&writer_wake);
+        pthread_mutex_unlock(&writer_lock);
+    }
+}
+
+static void *
+_writer_run(void *data)
+{
+    while (TRUE) {
+        gint tail = g_atomic_int_get(&ring_tail);
+
+        if (tail != g_atomic_int_get(&ring_head)) {
+            gchar *record = ring[tail];
+            _log_write(record);
+            g_free(record);
+            g_atomic_int_set(&ring_tail, (tail + 1) % LOG_RING_SIZE);
+            continue;
+        }
+
+        // ring is empty
+        gint dropped = g_atomic_int_get(&ring_dropped);
+        if (dropped > 0) {
+            g_atomic_int_add(&ring_dropped, -dropped);
+            gchar *msg = g_strdup_printf("%d log messages dropped", dropped);
+            gchar *record = _log_record(PROF_LEVEL_WARN, PROF, msg);
+            _log_write(record);
+            g_free(record);
+            g_free(msg);
+        }
+        if (logp != NULL) {
+            fflush(logp);
+        }
+
+        if (!g_atomic_int_get(&writer_running)) {
+            break;
+        }
+
+        pthread_mutex_lock(&writer_lock);
+        g_atomic_int_set(&writer_waiting, 1);
+        if ((tail == g_atomic_int_get(&ring_head)) &&
+                g_atomic_int_get(&writer_running)) {
+            struct timespec wake_at;
+            clock_gettime(CLOCK_REALTIME, &wake_at);
+            wake_at.tv_sec += 1;
+            pthread_cond_timedwait(&writer_wake, &writer_lock, &wake_at);
+        }
+        g_atomic_int_set(&writer_waiting, 0);
+        pthread_mutex_unlock(&writer_lock);
+    }
+
+    return NULL;
 }
 
 void
@@ -236,6 +437,34 @@ chat_log_init(void)
     log_info("Initialising chat logs");
     logs = g_hash_table_new_full(g_str_hash, (GEqualFunc) _key_equals, g_free,
         (GDestroyNotify)_free_chat_log);
+    open_logs = 0;
+    last_use = 0;
+    flush_source = 0;
+    chat_log_update_flush_policy();
+}
+
+void
+chat_log_update_flush_policy(void)
+{
+    char *policy = prefs_get_string(PREF_LOG_FLUSH);
+    if (g_strcmp0(policy, "message") == 0) {
+        flush_policy = CHAT_LOG_FLUSH_MESSAGE;
+    } else if (g_strcmp0(policy, "idle") == 0) {
+        flush_policy = CHAT_LOG_FLUSH_IDLE;
+    } else {
+        flush_policy = CHAT_LOG_FLUSH_TIMED;
+    }
+    prefs_free_string(policy);
+
+    // write anything buffered under the old policy
+    _flush_all();
+}
+
+// write buffered lines so the logs can be read
+void
+chat_log_flush(void)
+{
+    _flush_all();
 }
 
 void
@@ -250,6 +479,10 @@ void
 chat_log_chat(const gchar * const login, gchar *other,
     const gchar * const msg, chat_log_direction_t direction, GTimeVal *tv_stamp)
 {
+    time_t now = time(NULL);
+    struct tm now_tm;
+    localtime_r(&now, &now_tm);
+
     struct dated_chat_log *dated_log = g_hash_table_lookup(logs, other);
 
     // no log for user
@@ -258,142 +491,241 @@ chat_log_chat(const gchar * const login, gchar *other,
         g_hash_table_insert(logs, strdup(other), dated_log);
 
     // log exists but needs rolling
-    } else if (_log_roll_needed(dated_log)) {
+    } else if (_log_roll_needed(dated_log, &now_tm)) {
         dated_log = _create_log(other, login);
         g_hash_table_replace(logs, strdup(other), dated_log);
     }
 
-    gchar *date_fmt = NULL;
-    GDateTime *dt = NULL;
+    char date_fmt[9];
     if (tv_stamp == NULL) {
-        dt = g_date_time_new_now_local();
+        strftime(date_fmt, sizeof(date_fmt), "%H:%M:%S", &now_tm);
     } else {
-        dt = g_date_time_new_from_timeval_utc(tv_stamp);
+        time_t stamp = tv_stamp->tv_sec;
+        struct tm stamp_tm;
+        gmtime_r(&stamp, &stamp_tm);
+        strftime(date_fmt, sizeof(date_fmt), "%H:%M:%S", &stamp_tm);
     }
 
-    date_fmt = g_date_time_format(dt, "%H:%M:%S");
-
-    FILE *logp = fopen(dated_log->filename, "a");
-    if (logp != NULL) {
-        if (direction == PROF_IN_LOG) {
-            if (strncmp(msg, "/me ", 4) == 0) {
-                fprintf(logp, "%s - *%s %s\n", date_fmt, other, msg + 4);
-            } else {
-                fprintf(logp, "%s - %s: %s\n", date_fmt, other, msg);
-            }
+    gchar *line = NULL;
+    if (direction == PROF_IN_LOG) {
+        if (strncmp(msg, "/me ", 4) == 0) {
+            line = g_strdup_printf("%s - *%s %s", date_fmt, other, msg + 4);
         } else {
-            if (strncmp(msg, "/me ", 4) == 0) {
-                fprintf(logp, "%s - *me %s\n", date_fmt, msg + 4);
-            } else {
-                fprintf(logp, "%s - me: %s\n", date_fmt, msg);
-            }
+            line = g_strdup_printf("%s - %s: %s", date_fmt, other, msg);
         }
-        fflush(logp);
-        int result = fclose(logp);
-        if (result == EOF) {
-            log_error("Error closing file %s, errno = %d", dated_log->filename, errno);
+    } else {
+        if (strncmp(msg, "/me ", 4) == 0) {
+            line = g_strdup_printf("%s - *me %s", date_fmt, msg + 4);
+        } else {
+            line = g_strdup_printf("%s - me: %s", date_fmt, msg);
         }
     }
 
-    g_free(date_fmt);
-    g_date_time_unref(dt);
+    FILE *fp = _log_open(dated_log);
+    if (fp != NULL) {
+        long offset = ftell(fp);
+        fprintf(fp, "%s\n", line);
+        search_add(login, other, FALSE, _log_date(&now_tm), offset, line);
+        _log_written(dated_log);
+    }
+    g_free(line);
 }
 
 void
 groupchat_log_chat(const gchar * const login, const gchar * const room,
     const gchar * const nick, const gchar * const msg)
 {
-    gchar *room_copy = strdup(room);
-    struct dated_chat_log *dated_log = g_hash_table_lookup(groupchat_logs, room_copy);
+    time_t now = time(NULL);
+    struct tm now_tm;
+    localtime_r(&now, &now_tm);
+
+    struct dated_chat_log *dated_log = g_hash_table_lookup(groupchat_logs, room);
 
     // no log for room
     if (dated_log == NULL) {
-        dated_log = _create_groupchat_log(room_copy, login);
-        g_hash_table_insert(groupchat_logs, room_copy, dated_log);
+        dated_log = _create_groupchat_log((char *)room, login);
+        g_hash_table_insert(groupchat_logs, strdup(room), dated_log);
 
     // log exists but needs rolling
-    } else if (_log_roll_needed(dated_log)) {
-        dated_log = _create_groupchat_log(room_copy, login);
-        g_hash_table_replace(logs, room_copy, dated_log);
+    } else if (_log_roll_needed(dated_log, &now_tm)) {
+        dated_log = _create_groupchat_log((char *)room, login);
+        g_hash_table_replace(groupchat_logs, strdup(room), dated_log);
     }
 
-    GDateTime *dt = g_date_time_new_now_local();
+    char date_fmt[9];
+    strftime(date_fmt, sizeof(date_fmt), "%H:%M:%S", &now_tm);
 
-    gchar *date_fmt = g_date_time_format(dt, "%H:%M:%S");
+    gchar *line = NULL;
+    if (strncmp(msg, "/me ", 4) == 0) {
+        line = g_strdup_printf("%s - *%s %s", date_fmt, nick, msg + 4);
+    } else {
+        line = g_strdup_printf("%s - %s: %s", date_fmt, nick, msg);
+    }
 
-    FILE *logp = fopen(dated_log->filename, "a");
-    if (logp != NULL) {
-        if (strncmp(msg, "/me ", 4) == 0) {
-            fprintf(logp, "%s - *%s %s\n", date_fmt, nick, msg + 4);
-        } else {
-            fprintf(logp, "%s - %s: %s\n", date_fmt, nick, msg);
-        }
+    FILE *fp = _log_open(dated_log);
+    if (fp != NULL) {
+        long offset = ftell(fp);
+        fprintf(fp, "%s\n", line);
+        search_add(login, room, TRUE, _log_date(&now_tm), offset, line);
+        _log_written(dated_log);
+    }
+    g_free(line);
+}
 
-        fflush(logp);
-        int result = fclose(logp);
-        if (result == EOF) {
-            log_error("Error closing file %s, errno = %d", dated_log->filename, errno);
+
+GSList *
+chat_log_get_previous(const gchar * const login, const gchar * const recipient,
+    int max_lines, ChatLogPos *start)
+{
+    GSList *history = NULL;
+    start->date = 0;
+    start->offset = 0;
+
+    // make sure buffered messages are on disk before reading
+    _flush_all();
+
+    // read backwards through the day files until we have enough lines
+    struct history_index *index = _history_index_get(login, recipient);
+    int remaining = max_lines;
+    guint i = index->days->len;
+    while ((i > 0) && (remaining > 0)) {
+        i--;
+        struct history_day *day = g_ptr_array_index(index->days, i);
+        int count = 0;
+        long offset = 0;
+        GSList *lines = _read_lines_before(day->filename, -1, remaining,
+            &offset, &count);
+        remaining -= count;
+
+        // an empty day file gets no header
+        if (count > 0) {
+            start->date = day->date;
+            start->offset = offset;
+            history = g_slist_concat(lines, history);
+            history = g_slist_prepend(history, strdup(day->header));
         }
     }
 
-    g_free(date_fmt);
-    g_date_time_unref(dt);
+    return history;
 }
 
+/*
+ * Get the position after the last line logged today, offset 0 when nothing
+ * has been logged today
+ */
+ChatLogPos
+chat_log_get_end(const gchar * const login, const gchar * const recipient,
+    gboolean room)
+{
+    _flush_all();
 
+    time_t now = time(NULL);
+    struct tm now_tm;
+    localtime_r(&now, &now_tm);
+
+    ChatLogPos end;
+    end.date = _log_date(&now_tm);
+
+    gchar *dir = _get_log_dir(login, recipient, room);
+    gchar *filename = _get_day_filename(dir, end.date);
+    end.offset = _file_size(filename);
+    g_free(filename);
+    g_free(dir);
+
+    return end;
+}
+
+/*
+ * Read at most max_lines before pos, oldest first. Lines are only read from
+ * one day file, when pos is at the start of a day the previous day with a
+ * log is read. On return pos is the start of the first line and end the end
+ * of the last line. Returns NULL when there are no older lines.
+ */
 GSList *
-chat_log_get_previous(const gchar * const login, const gchar * const recipient)
+chat_log_get_before(const gchar * const login, const gchar * const recipient,
+    gboolean room, ChatLogPos *pos, long *end, int max_lines)
 {
-    GSList *history = NULL;
-    GDateTime *now = g_date_time_new_now_local();
-    GDateTime *log_date = g_date_time_new(tz,
-        g_date_time_get_year(session_started),
-        g_date_time_get_month(session_started),
-        g_date_time_get_day_of_month(session_started),
-        g_date_time_get_hour(session_started),
-        g_date_time_get_minute(session_started),
-        g_date_time_get_second(session_started));
-
-    // get data from all logs from the day the session was started to today
-    while (g_date_time_compare(log_date, now) != 1) {
-        char *filename = _get_log_filename(recipient, login, log_date, FALSE);
-
-        FILE *logp = fopen(filename, "r");
-        if (logp != NULL) {
-            GString *header = g_string_new("");
-            g_string_append_printf(header, "%d/%d/%d:",
-                g_date_time_get_day_of_month(log_date),
-                g_date_time_get_month(log_date),
-                g_date_time_get_year(log_date));
-            history = g_slist_append(history, header->str);
-            g_string_free(header, FALSE);
-
-            char *line;
-            while ((line = prof_getline(logp)) != NULL) {
-                history = g_slist_append(history, line);
-            }
-
-            fclose(logp);
+    _flush_all();
+
+    gchar *dir = _get_log_dir(login, recipient, room);
+    gchar *filename = NULL;
+    while (pos->offset <= 0) {
+        guint32 previous = _log_day_before(dir, pos->date);
+        if (previous == 0) {
+            g_free(dir);
+            return NULL;
         }
+        g_free(filename);
+        filename = _get_day_filename(dir, previous);
+        pos->date = previous;
+        pos->offset = _file_size(filename);
+    }
+    if (filename == NULL) {
+        filename = _get_day_filename(dir, pos->date);
+    }
+    g_free(dir);
 
-        free(filename);
+    int count = 0;
+    long start = pos->offset;
+    GSList *lines = _read_lines_before(filename, pos->offset, max_lines,
+        &start, &count);
+    g_free(filename);
 
-        GDateTime *next = g_date_time_add_days(log_date, 1);
-        g_date_time_unref(log_date);
-        log_date = next;
+    if (count == 0) {
+        return NULL;
     }
 
-    g_date_time_unref(log_date);
-    g_date_time_unref(now);
+    *end = pos->offset;
+    pos->offset = start;
+    if (start == 0) {
+        lines = g_slist_prepend(lines, _day_header(pos->date));
+    }
 
-    return history;
+    return lines;
+}
+
+/*
+ * Read the lines of a day file from start up to end, as returned by
+ * chat_log_get_before
+ */
+GSList *
+chat_log_get_range(const gchar * const login, const gchar * const recipient,
+    gboolean room, ChatLogPos start, long end)
+{
+    gchar *dir = _get_log_dir(login, recipient, room);
+    gchar *filename = _get_day_filename(dir, start.date);
+    g_free(dir);
+
+    FILE *fp = fopen(filename, "r");
+    g_free(filename);
+    if (fp == NULL) {
+        return NULL;
+    }
+
+    int count = 0;
+    GSList *lines = _read_lines(fp, start.offset, end, &count);
+    fclose(fp);
+
+    if (start.offset == 0) {
+        lines = g_slist_prepend(lines, _day_header(start.date));
+    }
+
+    return lines;
 }
 
 void
 chat_log_close(void)
 {
+    if (flush_source != 0) {
+        g_source_remove(flush_source);
+        flush_source = 0;
+    }
     g_hash_table_remove_all(logs);
     g_hash_table_remove_all(groupchat_logs);
+    if (history_indexes != NULL) {
+        g_hash_table_destroy(history_indexes);
+        history_indexes = NULL;
+    }
     g_date_time_unref(session_started);
 }
 
@@ -406,6 +738,10 @@ _create_log(char *other, const char * const login)
     struct dated_chat_log *new_log = malloc(sizeof(struct dated_chat_log));
     new_log->filename = strdup(filename);
     new_log->date = now;
+    new_log->fp = NULL;
+    new_log->buffer = NULL;
+    new_log->last_used = 0;
+    new_log->dirty = FALSE;
 
     free(filename);
 
@@ -421,6 +757,10 @@ _create_groupchat_log(char *room, const char * const login)
     struct dated_chat_log *new_log = malloc(sizeof(struct dated_chat_log));
     new_log->filename = strdup(filename);
     new_log->date = now;
+    new_log->fp = NULL;
+    new_log->buffer = NULL;
+    new_log->last_used = 0;
+    new_log->dirty = FALSE;
 
     free(filename);
 
@@ -428,23 +768,376 @@ _create_groupchat_log(char *room, const char * const login)
 }
 
 static gboolean
-_log_roll_needed(struct dated_chat_log *dated_log)
+_log_roll_needed(struct dated_chat_log *dated_log, struct tm *now)
+{
+    // day of year from GDateTime is 1 based, tm_yday is 0 based
+    return (g_date_time_get_day_of_year(dated_log->date) != now->tm_yday + 1);
+}
+
+// date of a log file as YYYYMMDD
+static guint32
+_log_date(struct tm *tm)
+{
+    return ((tm->tm_year + 1900) * 10000) + ((tm->tm_mon + 1) * 100) + tm->tm_mday;
+}
+
+static FILE *
+_log_open(struct dated_chat_log *dated_log)
+{
+    dated_log->last_used = ++last_use;
+
+    if (dated_log->fp != NULL) {
+        return dated_log->fp;
+    }
+
+    if (open_logs >= CHAT_LOG_MAX_OPEN) {
+        _log_close_lru();
+    }
+
+    dated_log->fp = fopen(dated_log->filename, "a");
+    if (dated_log->fp == NULL) {
+        log_error("Error opening file %s, errno = %d", dated_log->filename, errno);
+        return NULL;
+    }
+
+    dated_log->buffer = malloc(CHAT_LOG_BUFFER_SIZE);
+    setvbuf(dated_log->fp, dated_log->buffer, _IOFBF, CHAT_LOG_BUFFER_SIZE);
+    open_logs++;
+
+    return dated_log->fp;
+}
+
+static void
+_log_written(struct dated_chat_log *dated_log)
+{
+    switch (flush_policy)
+    {
+        case CHAT_LOG_FLUSH_MESSAGE:
+            fflush(dated_log->fp);
+            search_flush();
+            break;
+        case CHAT_LOG_FLUSH_TIMED:
+            dated_log->dirty = TRUE;
+            if (flush_source == 0) {
+                flush_source = g_timeout_add(CHAT_LOG_FLUSH_INTERVAL_MS,
+                    _flush_source_fired, NULL);
+            }
+            break;
+        case CHAT_LOG_FLUSH_IDLE:
+            dated_log->dirty = TRUE;
+            if (flush_source == 0) {
+                flush_source = g_idle_add(_flush_source_fired, NULL);
+            }
+            break;
+    }
+}
+
+static void
+_log_close_file(struct dated_chat_log *dated_log)
+{
+    if (dated_log->fp != NULL) {
+        int result = fclose(dated_log->fp);
+        if (result == EOF) {
+            log_error("Error closing file %s, errno = %d", dated_log->filename, errno);
+        }
+        dated_log->fp = NULL;
+        dated_log->dirty = FALSE;
+        open_logs--;
+    }
+    FREE_SET_NULL(dated_log->buffer);
+}
+
+static void
+_find_lru(GHashTable *table, struct dated_chat_log **lru)
+{
+    GHashTableIter iter;
+    gpointer key;
+    gpointer value;
+
+    g_hash_table_iter_init(&iter, table);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        struct dated_chat_log *dated_log = value;
+        if ((dated_log->fp != NULL) &&
+                ((*lru == NULL) || (dated_log->last_used < (*lru)->last_used))) {
+            *lru = dated_log;
+        }
+    }
+}
+
+static void
+_log_close_lru(void)
+{
+    struct dated_chat_log *lru = NULL;
+    _find_lru(logs, &lru);
+    if (groupchat_logs != NULL) {
+        _find_lru(groupchat_logs, &lru);
+    }
+
+    if (lru != NULL) {
+        _log_close_file(lru);
+    }
+}
+
+static void
+_flush_table(GHashTable *table)
+{
+    GHashTableIter iter;
+    gpointer key;
+    gpointer value;
+
+    g_hash_table_iter_init(&iter, table);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        struct dated_chat_log *dated_log = value;
+        if (dated_log->dirty) {
+            fflush(dated_log->fp);
+            dated_log->dirty = FALSE;
+        }
+    }
+}
+
+static void
+_flush_all(void)
+{
+    if (logs != NULL) {
+        _flush_table(logs);
+    }
+    if (groupchat_logs != NULL) {
+        _flush_table(groupchat_logs);
+    }
+    search_flush();
+}
+
+static gboolean
+_flush_source_fired(gpointer data)
+{
+    flush_source = 0;
+    _flush_all();
+    return FALSE;
+}
+
+/*
+ * Get the index of day files for a contact, checking for files for any days
+ * since it was last updated. Only days from the start of the session are
+ * included.
+ */
+static struct history_index *
+_history_index_get(const gchar * const login, const gchar * const recipient)
 {
-    gboolean result = FALSE;
+    if (history_indexes == NULL) {
+        history_indexes = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+            (GDestroyNotify)_free_history_index);
+    }
+
+    gchar *key = g_strdup_printf("%s/%s", login, recipient);
+    struct history_index *index = g_hash_table_lookup(history_indexes, key);
+    if (index == NULL) {
+        index = malloc(sizeof(struct history_index));
+        index->days = g_ptr_array_new();
+        index->next_day = g_date_time_new_local(
+            g_date_time_get_year(session_started),
+            g_date_time_get_month(session_started),
+            g_date_time_get_day_of_month(session_started),
+            0, 0, 0);
+        g_hash_table_insert(history_indexes, key, index);
+    } else {
+        g_free(key);
+    }
+
+    // check each day not yet found, today is checked until its file exists
     GDateTime *now = g_date_time_new_now_local();
-    if (g_date_time_get_day_of_year(dated_log->date) !=
-            g_date_time_get_day_of_year(now)) {
-        result = TRUE;
+    while (g_date_time_compare(index->next_day, now) != 1) {
+        char *filename = _get_log_filename(recipient, login, index->next_day, FALSE);
+        gboolean is_today =
+            (g_date_time_get_day_of_year(index->next_day) == g_date_time_get_day_of_year(now)) &&
+            (g_date_time_get_year(index->next_day) == g_date_time_get_year(now));
+
+        if (g_file_test(filename, G_FILE_TEST_EXISTS)) {
+            struct history_day *day = malloc(sizeof(struct history_day));
+            day->date = (g_date_time_get_year(index->next_day) * 10000) +
+                (g_date_time_get_month(index->next_day) * 100) +
+                g_date_time_get_day_of_month(index->next_day);
+            day->filename = filename;
+            day->header = g_strdup_printf("%d/%d/%d:",
+                g_date_time_get_day_of_month(index->next_day),
+                g_date_time_get_month(index->next_day),
+                g_date_time_get_year(index->next_day));
+            g_ptr_array_add(index->days, day);
+        } else {
+            free(filename);
+            if (is_today) {
+                break;
+            }
+        }
+
+        GDateTime *next = g_date_time_add_days(index->next_day, 1);
+        g_date_time_unref(index->next_day);
+        index->next_day = next;
     }
     g_date_time_unref(now);
 
+    return index;
+}
+
+static void
+_free_history_index(struct history_index *index)
+{
+    guint i;
+    for (i = 0; i < index->days->len; i++) {
+        struct history_day *day = g_ptr_array_index(index->days, i);
+        free(day->filename);
+        g_free(day->header);
+        free(day);
+    }
+    g_ptr_array_free(index->days, TRUE);
+    g_date_time_unref(index->next_day);
+    free(index);
+}
+
+/*
+ * Read at most max_lines ending at offset end of a file, -1 for the end of
+ * the file. The file is scanned backwards in blocks to find where the lines
+ * start, so only the lines returned are read in full.
+ */
+static GSList *
+_read_lines_before(const char * const filename, long end, int max_lines,
+    long *start, int *count)
+{
+    FILE *fp = fopen(filename, "r");
+    if (fp == NULL) {
+        return NULL;
+    }
+
+    if (end < 0) {
+        fseek(fp, 0, SEEK_END);
+        end = ftell(fp);
+    }
+    long offset = 0;
+    long pos = end;
+    int newlines = 0;
+    gboolean found = FALSE;
+    char block[HISTORY_READ_BLOCK];
+
+    while ((pos > 0) && !found) {
+        long len = MIN(pos, HISTORY_READ_BLOCK);
+        pos -= len;
+        fseek(fp, pos, SEEK_SET);
+        if (fread(block, 1, len, fp) != len) {
+            break;
+        }
+
+        long i;
+        for (i = len - 1; i >= 0; i--) {
+            // ignore the newline ending the last line
+            if ((block[i] == '\n') && (pos + i != end - 1)) {
+                newlines++;
+                if (newlines == max_lines) {
+                    offset = pos + i + 1;
+                    found = TRUE;
+                    break;
+                }
+            }
+        }
+    }
+
+    *start = offset;
+    GSList *lines = _read_lines(fp, offset, end, count);
+    fclose(fp);
+
+    return lines;
+}
+
+// read the lines from offset start up to end
+static GSList *
+_read_lines(FILE *fp, long start, long end, int *count)
+{
+    GSList *lines = NULL;
+    fseek(fp, start, SEEK_SET);
+    char *line;
+    while ((ftell(fp) < end) && ((line = prof_getline(fp)) != NULL)) {
+        lines = g_slist_prepend(lines, line);
+        (*count)++;
+    }
+
+    return g_slist_reverse(lines);
+}
+
+static long
+_file_size(const char * const filename)
+{
+    struct stat st;
+    if (stat(filename, &st) != 0) {
+        return 0;
+    }
+
+    return st.st_size;
+}
+
+static gchar *
+_get_log_dir(const char * const login, const char * const recipient,
+    gboolean room)
+{
+    gchar *chatlogs_dir = _get_chatlog_dir();
+    gchar *login_dir = str_replace(login, "@", "_at_");
+    gchar *recipient_dir = str_replace(recipient, "@", "_at_");
+
+    gchar *result = g_strdup_printf("%s/%s%s/%s", chatlogs_dir, login_dir,
+        room ? "/rooms" : "", recipient_dir);
+
+    free(chatlogs_dir);
+    free(login_dir);
+    free(recipient_dir);
+
     return result;
 }
 
+static gchar *
+_get_day_filename(const char * const dir, guint32 date)
+{
+    return g_strdup_printf("%s/%04u_%02u_%02u.log", dir, date / 10000,
+        (date / 100) % 100, date % 100);
+}
+
+// the latest day before date with a log file, 0 when there is none
+static guint32
+_log_day_before(const char * const dir, guint32 date)
+{
+    GDir *days_dir = g_dir_open(dir, 0, NULL);
+    if (days_dir == NULL) {
+        return 0;
+    }
+
+    guint32 result = 0;
+    const gchar *name;
+    while ((name = g_dir_read_name(days_dir)) != NULL) {
+        unsigned int year, month, day;
+        if ((strlen(name) == 14) && g_str_has_suffix(name, ".log") &&
+                (sscanf(name, "%4u_%2u_%2u", &year, &month, &day) == 3)) {
+            guint32 day_date = (year * 10000) + (month * 100) + day;
+            if ((day_date < date) && (day_date > result)) {
+                result = day_date;
+            }
+        }
+    }
+    g_dir_close(days_dir);
+
+    return result;
+}
+
+static char *
+_day_header(guint32 date)
+{
+    char header[16];
+    snprintf(header, sizeof(header), "%u/%u/%u:", date % 100,
+        (date / 100) % 100, date / 10000);
+
+    return strdup(header);
+}
+
 static void
 _free_chat_log(struct dated_chat_log *dated_log)
 {
     if (dated_log != NULL) {
+        _log_close_file(dated_log);
         if (dated_log->filename != NULL) {
             g_free(dated_log->filename);
             dated_log->filename = NULL;
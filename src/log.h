@@ -50,15 +50,34 @@ typedef enum {
     PROF_OUT_LOG
 } chat_log_direction_t;
 
+// position of a line in the chat logs for a contact or room
+typedef struct chat_log_pos_t {
+    guint32 date;   // day of the log file as YYYYMMDD, 0 when unknown
+    long offset;    // offset of the start of the line in the file
+} ChatLogPos;
+
+// messages below this level are not logged
+extern log_level_t log_level_filter;
+
+// the level is checked before the arguments are evaluated or formatted
+#define log_debug(...) log_at_level(PROF_LEVEL_DEBUG, __VA_ARGS__)
+#define log_info(...) log_at_level(PROF_LEVEL_INFO, __VA_ARGS__)
+#define log_warning(...) log_at_level(PROF_LEVEL_WARN, __VA_ARGS__)
+#define log_error(...) log_at_level(PROF_LEVEL_ERROR, __VA_ARGS__)
+
+#define log_at_level(level, ...) \
+    do { \
+        if ((level) >= log_level_filter) { \
+            log_format((level), __VA_ARGS__); \
+        } \
+    } while (0)
+
 void log_init(log_level_t filter);
 log_level_t log_get_filter(void);
 void log_close(void);
 void log_reinit(void);
 char * get_log_file_location(void);
-void log_debug(const char * const msg, ...);
-void log_info(const char * const msg, ...);
-void log_warning(const char * const msg, ...);
-void log_error(const char * const msg, ...);
+void log_format(log_level_t level, const char * const msg, ...);
 void log_msg(log_level_t level, const char * const area,
     const char * const msg);
 log_level_t log_level_from_string(char *log_level);
@@ -67,8 +86,17 @@ void chat_log_init(void);
 void chat_log_chat(const gchar * const login, gchar *other,
     const gchar * const msg, chat_log_direction_t direction, GTimeVal *tv_stamp);
 void chat_log_close(void);
+void chat_log_update_flush_policy(void);
+void chat_log_flush(void);
 GSList * chat_log_get_previous(const gchar * const login,
-    const gchar * const recipient);
+    const gchar * const recipient, int max_lines, ChatLogPos *start);
+ChatLogPos chat_log_get_end(const gchar * const login,
+    const gchar * const recipient, gboolean room);
+GSList * chat_log_get_before(const gchar * const login,
+    const gchar * const recipient, gboolean room, ChatLogPos *pos,
+    long *end, int max_lines);
+GSList * chat_log_get_range(const gchar * const login,
+    const gchar * const recipient, gboolean room, ChatLogPos start, long end);
 
 void groupchat_log_init(void);
 void groupchat_log_chat(const gchar * const login, const gchar * const room,
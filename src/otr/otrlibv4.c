@@ -41,9 +41,12 @@
 #include "otr/otr.h"
 #include "otr/otrlib.h"
 
-static GTimer *timer;
+static guint timer = 0;
 static unsigned int current_interval;
 
+static gboolean _otrlib_timer_fired(gpointer data);
+static void _otrlib_timer_start(void);
+
 OtrlPolicy
 otrlib_policy(void)
 {
@@ -54,20 +57,36 @@ void
 otrlib_init_timer(void)
 {
     OtrlUserState user_state = otr_userstate();
-    timer = g_timer_new();
     current_interval = otrl_message_poll_get_default_interval(user_state);
+    _otrlib_timer_start();
 }
 
 void
 otrlib_poll(void)
 {
-    gdouble elapsed = g_timer_elapsed(timer, NULL);
-
-    if (current_interval != 0 && elapsed > current_interval) {
+    if (current_interval != 0) {
         OtrlUserState user_state = otr_userstate();
         OtrlMessageAppOps *ops = otr_messageops();
         otrl_message_poll(user_state, ops, NULL);
-        g_timer_start(timer);
+    }
+}
+
+static gboolean
+_otrlib_timer_fired(gpointer data)
+{
+    otrlib_poll();
+    return TRUE;
+}
+
+static void
+_otrlib_timer_start(void)
+{
+    if (timer != 0) {
+        g_source_remove(timer);
+        timer = 0;
+    }
+    if (current_interval != 0) {
+        timer = g_timeout_add_seconds(current_interval, _otrlib_timer_fired, NULL);
     }
 }
 
@@ -106,6 +125,7 @@ static void
 cb_timer_control(void *opdata, unsigned int interval)
 {
     current_interval = interval;
+    _otrlib_timer_start();
 }
 
 static void
@@ -39,6 +39,7 @@
 
 #include <locale.h>
 #include <signal.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -59,15 +60,47 @@
 #include "otr/otr.h"
 #endif
 #include "resource.h"
+#include "search.h"
 #include "xmpp/xmpp.h"
 #include "ui/ui.h"
 
-static void _handle_idle_time(void);
+// upper bound on sleeping between checks, picks up changed preferences
+#define MAX_CHECK_INTERVAL_MS 60000
+// how often to check for activity whilst auto away
+#define IDLE_CHECK_INTERVAL_MS 1000
+
+static gint _handle_idle_time(void);
+static gboolean _read_input(void);
+static gboolean _stdin_ready(GIOChannel *source, GIOCondition condition,
+    gpointer data);
+static gboolean _autoaway_check(gpointer data);
+static gboolean _chat_states_check(gpointer data);
+static gboolean _chat_states_needed(void);
+static void _chat_states_schedule(void);
+static gboolean _notify_remind_check(gpointer data);
+static gboolean _clock_tick(gpointer data);
+static void _render_frame(void);
+static gboolean _frame_due(gpointer data);
 static void _init(const int disable_tls, char *log_level);
 static void _shutdown(void);
 static void _create_directories(void);
 
 static gboolean idle = FALSE;
+static GTimer *frame_timer = NULL;
+
+// when the chat states check was scheduled and how long it waits
+static GTimer *chat_states_timer = NULL;
+static gint chat_states_delay = 0;
+
+// main loop sources, 0 when not running
+static struct {
+    guint stdin_watch;
+    guint autoaway;
+    guint chat_states;
+    guint notify_remind;
+    guint clock;
+    guint frame;
+} sources;
 
 void
 prof_run(const int disable_tls, char *log_level, char *account_name)
@@ -75,59 +108,63 @@ prof_run(const int disable_tls, char *log_level, char *account_name)
     _init(disable_tls, log_level);
     log_info("Starting main event loop");
     ui_input_nonblocking();
-    GTimer *timer = g_timer_new();
     gboolean cmd_result = TRUE;
-    jabber_conn_status_t conn_status = jabber_get_connection_status();
-
-    char inp[INP_WIN_MAX];
-    int size = 0;
 
     char *pref_connect_account = prefs_get_string(PREF_CONNECT_ACCOUNT);
     if (account_name != NULL) {
         char *cmd = "/connect";
-        snprintf(inp, sizeof(inp), "%s %s", cmd, account_name);
+        char *inp = g_strdup_printf("%s %s", cmd, account_name);
         process_input(inp);
+        g_free(inp);
     } else if (pref_connect_account != NULL) {
         char *cmd = "/connect";
-        snprintf(inp, sizeof(inp), "%s %s", cmd, pref_connect_account);
+        char *inp = g_strdup_printf("%s %s", cmd, pref_connect_account);
         process_input(inp);
+        g_free(inp);
     }
     prefs_free_string(pref_connect_account);
     ui_update();
 
-    while(cmd_result == TRUE) {
-        wint_t ch = ERR;
-        size = 0;
+    GIOChannel *stdin_channel = g_io_channel_unix_new(fileno(stdin));
+    sources.stdin_watch = g_io_add_watch(stdin_channel, G_IO_IN, _stdin_ready, NULL);
+    g_io_channel_unref(stdin_channel);
 
-        while(ch != '\n') {
-            conn_status = jabber_get_connection_status();
-            if (conn_status == JABBER_CONNECTED) {
-                _handle_idle_time();
-            }
+    _autoaway_check(NULL);
+    _notify_remind_check(NULL);
+    _clock_tick(NULL);
+    frame_timer = g_timer_new();
+    chat_states_timer = g_timer_new();
 
-            gdouble elapsed = g_timer_elapsed(timer, NULL);
+    while (cmd_result == TRUE) {
+        // sleep until input, socket activity or a timer is due
+        g_main_context_iteration(NULL, TRUE);
 
-            gint remind_period = prefs_get_notify_remind();
-            if (remind_period > 0 && elapsed >= remind_period) {
-                notify_remind();
-                g_timer_start(timer);
-            }
+        // also catches KEY_RESIZE after SIGWINCH interrupts the poll
+        cmd_result = _read_input();
 
-            ui_handle_special_keys(&ch, inp, size);
-#ifdef HAVE_LIBOTR
-            otr_poll();
-#endif
-            jabber_process_events();
-            ui_update();
+        // input and messages move the next chat state change
+        _chat_states_schedule();
 
-            ch = ui_get_char(inp, &size);
-        }
-
-        inp[size++] = '\0';
-        cmd_result = process_input(inp);
+        // flush anything queued whilst handling events
+        jabber_process_events();
+        _render_frame();
     }
 
-    g_timer_destroy(timer);
+    g_source_remove(sources.stdin_watch);
+    g_source_remove(sources.autoaway);
+    g_source_remove(sources.notify_remind);
+    g_source_remove(sources.clock);
+    if (sources.chat_states != 0) {
+        g_source_remove(sources.chat_states);
+    }
+    if (sources.frame != 0) {
+        g_source_remove(sources.frame);
+    }
+    memset(&sources, 0, sizeof(sources));
+    g_timer_destroy(frame_timer);
+    frame_timer = NULL;
+    g_timer_destroy(chat_states_timer);
+    chat_states_timer = NULL;
 }
 
 void
@@ -221,19 +258,187 @@ process_input(char *inp)
     return result;
 }
 
+/*
+ * Read all input waiting on stdin, return FALSE if profanity is to quit,
+ * TRUE otherwise
+ */
+static gboolean
+_read_input(void)
+{
+    gboolean cmd_result = TRUE;
+    wint_t ch = ui_get_char();
+
+    while (ch != ERR) {
+        ui_handle_special_keys(&ch);
+
+        if (ch == '\n') {
+            char *inp = ui_get_line();
+            cmd_result = process_input(inp);
+            free(inp);
+            if (cmd_result == FALSE) {
+                break;
+            }
+        }
+
+        ch = ui_get_char();
+    }
+
+    return cmd_result;
+}
+
+static gboolean
+_stdin_ready(GIOChannel *source, GIOCondition condition, gpointer data)
+{
+    // input is read after each main loop iteration
+    return TRUE;
+}
+
+static gboolean
+_autoaway_check(gpointer data)
+{
+    gint next_check = MAX_CHECK_INTERVAL_MS;
+    if (jabber_get_connection_status() == JABBER_CONNECTED) {
+        next_check = MIN(_handle_idle_time(), MAX_CHECK_INTERVAL_MS);
+    }
+    sources.autoaway = g_timeout_add(next_check, _autoaway_check, NULL);
+
+    return FALSE;
+}
+
+static gboolean
+_chat_states_check(gpointer data)
+{
+    sources.chat_states = 0;
+    prof_handle_idle();
+
+    return FALSE;
+}
+
+/*
+ * Wake up for the next pending paused, inactive or gone chat state, keeping
+ * the scheduled check when it is not too late
+ */
 static void
-_handle_idle_time()
+_chat_states_schedule(void)
 {
+    gint next = -1;
+    if (_chat_states_needed()) {
+        next = chat_sessions_next_state_change();
+    }
+
+    if (sources.chat_states != 0) {
+        gdouble remaining = chat_states_delay -
+            (g_timer_elapsed(chat_states_timer, NULL) * 1000);
+        if ((next != -1) && (remaining <= next)) {
+            return;
+        }
+        g_source_remove(sources.chat_states);
+        sources.chat_states = 0;
+    }
+
+    if (next != -1) {
+        sources.chat_states = g_timeout_add(next, _chat_states_check, NULL);
+        chat_states_delay = next;
+        g_timer_start(chat_states_timer);
+    }
+}
+
+static gboolean
+_chat_states_needed(void)
+{
+    if (!prefs_get_boolean(PREF_STATES)) {
+        return FALSE;
+    }
+    if (jabber_get_connection_status() != JABBER_CONNECTED) {
+        return FALSE;
+    }
+
+    return ui_has_recipients();
+}
+
+static gboolean
+_notify_remind_check(gpointer data)
+{
+    guint next_check = MAX_CHECK_INTERVAL_MS / 1000;
+    gint remind_period = prefs_get_notify_remind();
+    if (remind_period > 0) {
+        if (data != NULL) {
+            notify_remind();
+        }
+        next_check = remind_period;
+    }
+    sources.notify_remind = g_timeout_add_seconds(next_check,
+        _notify_remind_check, GINT_TO_POINTER(TRUE));
+
+    return FALSE;
+}
+
+static gboolean
+_clock_tick(gpointer data)
+{
+    // wake on the minute to redraw the time in the status bar
+    GDateTime *now = g_date_time_new_now_local();
+    guint next_tick = 60 - g_date_time_get_second(now);
+    g_date_time_unref(now);
+
+    sources.clock = g_timeout_add_seconds(next_tick, _clock_tick, NULL);
+
+    return FALSE;
+}
+
+/*
+ * Redraw the screen at most max fps times per second, output from events
+ * handled before the next frame is due is drawn together
+ */
+static void
+_render_frame(void)
+{
+    gint fps = prefs_get_max_fps();
+    if (fps > 0) {
+        gulong frame_ms = 1000 / fps;
+        gulong elapsed_ms = (gulong)(g_timer_elapsed(frame_timer, NULL) * 1000);
+        if (elapsed_ms < frame_ms) {
+            if (sources.frame == 0) {
+                sources.frame = g_timeout_add(frame_ms - elapsed_ms, _frame_due, NULL);
+            }
+            return;
+        }
+    }
+
+    ui_update();
+    g_timer_start(frame_timer);
+}
+
+static gboolean
+_frame_due(gpointer data)
+{
+    // wakes the main loop, the frame is drawn after events are handled
+    sources.frame = 0;
+
+    return FALSE;
+}
+
+/*
+ * Handle auto away, return the number of milliseconds until the next check
+ * is needed
+ */
+static gint
+_handle_idle_time(void)
+{
+    gint next_check = MAX_CHECK_INTERVAL_MS;
     gint prefs_time = prefs_get_autoaway_time() * 60000;
     resource_presence_t current_presence = accounts_get_last_presence(jabber_get_account_name());
     unsigned long idle_ms = ui_get_idle_time();
-    char *pref_autoaway_mode = prefs_get_string(PREF_AUTOAWAY_MODE);
-    char *pref_autoaway_message = prefs_get_string(PREF_AUTOAWAY_MESSAGE);
+    const char *pref_autoaway_mode = prefs_get_string_value(PREF_AUTOAWAY_MODE);
+    const char *pref_autoaway_message = prefs_get_string_value(PREF_AUTOAWAY_MESSAGE);
 
     if (!idle) {
         if ((current_presence == RESOURCE_ONLINE) || (current_presence == RESOURCE_CHAT)) {
-            if (idle_ms >= prefs_time) {
+            if (idle_ms < prefs_time) {
+                next_check = prefs_time - idle_ms;
+            } else {
                 idle = TRUE;
+                next_check = IDLE_CHECK_INTERVAL_MS;
 
                 // handle away mode
                 if (strcmp(pref_autoaway_mode, "away") == 0) {
@@ -248,8 +453,10 @@ _handle_idle_time()
         }
 
     } else {
+        next_check = IDLE_CHECK_INTERVAL_MS;
         if (idle_ms < prefs_time) {
             idle = FALSE;
+            next_check = prefs_time - idle_ms;
 
             // handle check
             if (prefs_get_boolean(PREF_AUTOAWAY_CHECK)) {
@@ -263,8 +470,8 @@ _handle_idle_time()
             }
         }
     }
-    prefs_free_string(pref_autoaway_mode);
-    prefs_free_string(pref_autoaway_message);
+
+    return next_check;
 }
 
 static void
@@ -319,6 +526,7 @@ _shutdown(void)
     otr_shutdown();
 #endif
     chat_log_close();
+    search_close();
     prefs_close();
     theme_close();
     accounts_close();
@@ -338,6 +546,8 @@ _create_directories(void)
     g_string_append(chatlogs_dir, "/profanity/chatlogs");
     GString *logs_dir = g_string_new(xdg_data);
     g_string_append(logs_dir, "/profanity/logs");
+    GString *rosters_dir = g_string_new(xdg_data);
+    g_string_append(rosters_dir, "/profanity/rosters");
 
     if (!mkdir_recursive(themes_dir->str)) {
         log_error("Error while creating directory %s", themes_dir->str);
@@ -348,10 +558,14 @@ _create_directories(void)
     if (!mkdir_recursive(logs_dir->str)) {
         log_error("Error while creating directory %s", logs_dir->str);
     }
+    if (!mkdir_recursive(rosters_dir->str)) {
+        log_error("Error while creating directory %s", rosters_dir->str);
+    }
 
     g_string_free(themes_dir, TRUE);
     g_string_free(chatlogs_dir, TRUE);
     g_string_free(logs_dir, TRUE);
+    g_string_free(rosters_dir, TRUE);
 
     g_free(xdg_config);
     g_free(xdg_data);
@@ -61,6 +61,9 @@ static GHashTable *contacts;
 // nickname to jid map
 static GHashTable *name_to_barejid;
 
+// contacts are being loaded in bulk, autocompleters are sorted on commit
+static gboolean batch_loading = FALSE;
+
 static gboolean _key_equals(void *key1, void *key2);
 static gboolean _datetimes_equal(GDateTime *dt1, GDateTime *dt2);
 static void _replace_name(const char * const current_name,
@@ -68,6 +71,7 @@ static void _replace_name(const char * const current_name,
 static void _add_name_and_barejid(const char * const name,
     const char * const barejid);
 static gint _compare_contacts(PContact a, PContact b);
+static void _autocomplete_add(Autocomplete ac, const char * const item);
 
 void
 roster_clear(void)
@@ -157,6 +161,30 @@ roster_init(void)
         g_free);
 }
 
+/*
+ * Start loading contacts in bulk, roster_add only appends to the autocomplete
+ * indexes until roster_batch_commit is called, no other roster functions
+ * should be used in between
+ */
+void
+roster_batch_begin(void)
+{
+    batch_loading = TRUE;
+}
+
+void
+roster_batch_commit(void)
+{
+    if (!batch_loading) {
+        return;
+    }
+
+    autocomplete_sort(name_ac);
+    autocomplete_sort(barejid_ac);
+    autocomplete_sort(groups_ac);
+    batch_loading = FALSE;
+}
+
 void
 roster_free(void)
 {
@@ -164,6 +192,7 @@ roster_free(void)
     autocomplete_free(barejid_ac);
     autocomplete_free(fulljid_ac);
     autocomplete_free(groups_ac);
+    batch_loading = FALSE;
 }
 
 void
@@ -248,12 +277,12 @@ roster_add(const char * const barejid, const char * const name, GSList *groups,
 
     // add groups
     while (groups != NULL) {
-        autocomplete_add(groups_ac, groups->data);
+        _autocomplete_add(groups_ac, groups->data);
         groups = g_slist_next(groups);
     }
 
     g_hash_table_insert(contacts, strdup(barejid), contact);
-    autocomplete_add(barejid_ac, barejid);
+    _autocomplete_add(barejid_ac, barejid);
     _add_name_and_barejid(name, barejid);
 
     return TRUE;
@@ -275,11 +304,11 @@ roster_get_contacts(void)
 
     g_hash_table_iter_init(&iter, contacts);
     while (g_hash_table_iter_next(&iter, &key, &value)) {
-        result = g_slist_insert_sorted(result, value, (GCompareFunc)_compare_contacts);
+        result = g_slist_prepend(result, value);
     }
 
     // resturn all contact structs
-    return result;
+    return g_slist_sort(result, (GCompareFunc)_compare_contacts);
 }
 
 gboolean
@@ -398,14 +427,24 @@ static void
 _add_name_and_barejid(const char * const name, const char * const barejid)
 {
     if (name != NULL) {
-        autocomplete_add(name_ac, name);
+        _autocomplete_add(name_ac, name);
         g_hash_table_insert(name_to_barejid, strdup(name), strdup(barejid));
     } else {
-        autocomplete_add(name_ac, barejid);
+        _autocomplete_add(name_ac, barejid);
         g_hash_table_insert(name_to_barejid, strdup(barejid), strdup(barejid));
     }
 }
 
+static void
+_autocomplete_add(Autocomplete ac, const char * const item)
+{
+    if (batch_loading) {
+        autocomplete_append(ac, item);
+    } else {
+        autocomplete_add(ac, item);
+    }
+}
+
 static
 gint _compare_contacts(PContact a, PContact b)
 {
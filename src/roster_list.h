@@ -49,6 +49,8 @@ gboolean roster_contact_offline(const char * const barejid,
 void roster_reset_search_attempts(void);
 void roster_init(void);
 void roster_free(void);
+void roster_batch_begin(void);
+void roster_batch_commit(void);
 void roster_change_name(PContact contact, const char * const new_name);
 void roster_remove(const char * const name, const char * const barejid);
 void roster_update(const char * const barejid, const char * const name,
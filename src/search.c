@@ -0,0 +1,1202 @@
+/*
+ * search.c
+ *
+ * Copyright (C) 2012 - 2014 James Booth <boothj5@gmail.com>
+ *
+ * This file is part of Profanity.
+ *
+ * Profanity is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Profanity is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Profanity.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give permission to
+ * link the code of portions of this program with the OpenSSL library under
+ * certain conditions as described in each individual source file, and
+ * distribute linked combinations including the two.
+ *
+ * You must obey the GNU General Public License in all respects for all of the
+ * code used other than OpenSSL. If you modify file(s) with this exception, you
+ * may extend this exception to your version of the file(s), but you are not
+ * obligated to do so. If you do not wish to do so, delete this exception
+ * statement from your version. If you delete this exception statement from all
+ * source files in the program, then also delete it here.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <glib.h>
+
+#include "common.h"
+#include "log.h"
+#include "search.h"
+
+#define SEARCH_INDEX_FILE "searchindex.bin"
+#define SEARCH_INDEX_MAGIC "PSI\n"
+#define SEARCH_INDEX_VERSION 1
+#define SEARCH_INDEX_HEADER_SIZE 8
+#define SEARCH_MAX_RESULTS 100
+
+// records read from the index file on each pass of the main loop
+#define SEARCH_LOAD_RECORDS 4096
+
+#define SEARCH_RECORD_TERM 1
+#define SEARCH_RECORD_CONTACT 2
+#define SEARCH_RECORD_LINE 3
+#define SEARCH_RECORD_BUILT 4
+#define SEARCH_RECORD_BUILD_DONE 5
+
+// line record size without its terms: contact, date, offset and length
+#define SEARCH_LINE_SIZE 16
+
+/*
+ * The index is kept in a file beside the logs that is only ever appended
+ * to. All numbers are native 32 bit unsigned. After the magic and format
+ * version each record is its type, the size of the rest of the record and:
+ *
+ *   term        the word, numbered in the order they are added
+ *   contact     1 for a room otherwise 0, then the jid, numbered the same
+ *   line        contact, date as YYYYMMDD, offset and length of the line in
+ *               its day log, then the number of each word in the line
+ *   built       contact and date of a day log added by the initial build
+ *   build done  all logs from before the index was created have been added
+ *
+ * Matching lines are read back from the logs.
+ */
+
+// a logged line
+typedef struct search_doc_t {
+    guint32 contact;
+    guint32 date;
+    guint32 offset;
+    guint32 length;
+} SearchDoc;
+
+// occurrence of a term, the word position is used for phrase queries
+typedef struct search_posting_t {
+    guint32 doc;
+    guint32 pos;
+} SearchPosting;
+
+typedef struct search_contact_t {
+    gchar *jid;
+    gboolean room;
+} SearchContact;
+
+// a line logged before the index file has been read
+typedef struct search_line_t {
+    gchar *jid;
+    gboolean room;
+    guint32 date;
+    long offset;
+    gchar *line;
+} SearchLine;
+
+// a day log waiting to be added by the initial build
+typedef struct search_log_t {
+    gchar *filename;
+    gchar *jid;
+    gboolean room;
+    guint32 date;
+} SearchLog;
+
+typedef struct search_index_t {
+    gchar *logs_dir;
+    gchar *index_loc;
+    FILE *file;
+    GArray *docs;
+    GHashTable *term_ids;
+    GPtrArray *postings;
+    GHashTable *contact_ids;
+    GPtrArray *contacts;
+
+    // the file is read some records at a time from the main loop, lines
+    // logged until it has been are added after
+    gboolean loaded;
+    gchar *contents;
+    gsize size;
+    gsize offset;
+    gsize unbuilt;
+    GSList *waiting;
+
+    // then the initial build adds a day log at a time
+    gboolean built;
+    GHashTable *built_logs;
+    GSList *pending;
+    guint source;
+} SearchIndex;
+
+// indexes, keyed on login
+static GHashTable *indexes;
+
+static SearchIndex * _index_get(const char * const login);
+static void _index_free(SearchIndex *index);
+static void _index_add(SearchIndex *index, const char * const contact,
+    gboolean room, guint32 date, long offset, const char * const line);
+static gboolean _index_step(gpointer data);
+static void _index_load_all(SearchIndex *index);
+static void _load_step(SearchIndex *index);
+static gboolean _load_open(SearchIndex *index);
+static gboolean _load_next(SearchIndex *index);
+static void _load_done(SearchIndex *index);
+static void _index_clear(SearchIndex *index);
+static gboolean _load_record(SearchIndex *index, guint32 type,
+    const gchar *data, guint32 size);
+static void _index_write(SearchIndex *index, GString *bytes);
+static void _index_flush(SearchIndex *index);
+static guint32 _term_id(SearchIndex *index, GString *bytes,
+    const char * const term);
+static guint32 _contact_id(SearchIndex *index, GString *bytes,
+    const char * const jid, gboolean room);
+static void _add_line(SearchIndex *index, GString *bytes, guint32 contact,
+    guint32 date, guint32 offset, const char * const line);
+static gboolean _find_contact(SearchIndex *index, const char * const jid,
+    gboolean room, guint32 *id);
+static gboolean _log_built(SearchIndex *index, guint32 contact, guint32 date);
+static gboolean _build_step(SearchIndex *index);
+static void _build_scan(SearchIndex *index, const char * const dir,
+    gboolean room);
+static void _build_log(SearchIndex *index, SearchLog *log);
+static void _search_line_free(SearchLine *line);
+static void _search_log_free(SearchLog *log);
+static void _search_contact_free(SearchContact *contact);
+static gchar * _log_filename(SearchIndex *index, guint32 contact, guint32 date);
+static gchar * _contact_key(const char * const jid, gboolean room);
+static void _put_u32(GString *bytes, guint32 value);
+static void _put_record(GString *bytes, guint32 type, guint32 size);
+static guint32 _get_u32(const gchar *data);
+static GPtrArray * _tokenize(const char * const text);
+static GArray * _match_phrase(SearchIndex *index, GPtrArray *terms);
+static GArray * _intersect(GArray *a, GArray *b);
+static gboolean _has_posting(GArray *postings, guint32 doc, guint32 pos);
+static gboolean _parse_date(const char * const str, guint32 *date);
+static gint _compare_docs(guint32 *a, guint32 *b, SearchIndex *index);
+
+/*
+ * Add a line just written to a day log to the search index for login, date
+ * is in the form YYYYMMDD and offset is the start of the line in the log
+ */
+void
+search_add(const char * const login, const char * const contact,
+    gboolean room, guint32 date, long offset, const char * const line)
+{
+    SearchIndex *index = _index_get(login);
+    if (index->loaded) {
+        _index_add(index, contact, room, date, offset, line);
+        return;
+    }
+
+    SearchLine *waiting = malloc(sizeof(SearchLine));
+    waiting->jid = g_strdup(contact);
+    waiting->room = room;
+    waiting->date = date;
+    waiting->offset = offset;
+    waiting->line = g_strdup(line);
+    index->waiting = g_slist_prepend(index->waiting, waiting);
+}
+
+/*
+ * Search the logs for login. Each argument is a word or phrase that must
+ * appear in a line, or a with:, from: or to: filter. Returns FALSE if the
+ * query is invalid, otherwise results are set to the matching lines, most
+ * recent last.
+ */
+gboolean
+search_query(const char * const login, gchar **args, GSList **results)
+{
+    *results = NULL;
+
+    GPtrArray *phrases = g_ptr_array_new();
+    const char *with = NULL;
+    guint32 from = 0;
+    guint32 to = G_MAXUINT32;
+    gboolean valid = TRUE;
+
+    int i;
+    for (i = 0; args[i] != NULL; i++) {
+        if (g_str_has_prefix(args[i], "with:")) {
+            with = args[i] + strlen("with:");
+        } else if (g_str_has_prefix(args[i], "from:")) {
+            valid = valid && _parse_date(args[i] + strlen("from:"), &from);
+        } else if (g_str_has_prefix(args[i], "to:")) {
+            valid = valid && _parse_date(args[i] + strlen("to:"), &to);
+        } else {
+            GPtrArray *terms = _tokenize(args[i]);
+            if (terms->len > 0) {
+                g_ptr_array_add(phrases, terms);
+            } else {
+                g_ptr_array_free(terms, TRUE);
+            }
+        }
+    }
+
+    if (!valid || (phrases->len == 0)) {
+        for (i = 0; i < phrases->len; i++) {
+            g_ptr_array_free(g_ptr_array_index(phrases, i), TRUE);
+        }
+        g_ptr_array_free(phrases, TRUE);
+        return FALSE;
+    }
+
+    SearchIndex *index = _index_get(login);
+    _index_load_all(index);
+
+    // lines matching every phrase
+    GArray *matches = NULL;
+    for (i = 0; i < phrases->len; i++) {
+        GPtrArray *terms = g_ptr_array_index(phrases, i);
+        GArray *phrase_matches = _match_phrase(index, terms);
+        g_ptr_array_free(terms, TRUE);
+
+        if (matches == NULL) {
+            matches = phrase_matches;
+        } else {
+            GArray *intersection = _intersect(matches, phrase_matches);
+            g_array_free(matches, TRUE);
+            g_array_free(phrase_matches, TRUE);
+            matches = intersection;
+        }
+    }
+    g_ptr_array_free(phrases, TRUE);
+
+    // a jid may have been logged as a contact and as a room
+    guint32 with_chat = 0;
+    guint32 with_room = 0;
+    gboolean found_chat = FALSE;
+    gboolean found_room = FALSE;
+    if (with != NULL) {
+        found_chat = _find_contact(index, with, FALSE, &with_chat);
+        found_room = _find_contact(index, with, TRUE, &with_room);
+        if (!found_chat && !found_room) {
+            g_array_free(matches, TRUE);
+            return TRUE;
+        }
+    }
+
+    // filter, keeping the most recent
+    GArray *filtered = g_array_new(FALSE, FALSE, sizeof(guint32));
+    guint j;
+    for (j = 0; j < matches->len; j++) {
+        guint32 doc_id = g_array_index(matches, guint32, j);
+        SearchDoc *doc = &g_array_index(index->docs, SearchDoc, doc_id);
+        if ((with != NULL) &&
+                !(found_chat && (doc->contact == with_chat)) &&
+                !(found_room && (doc->contact == with_room))) {
+            continue;
+        }
+        if ((doc->date < from) || (doc->date > to)) {
+            continue;
+        }
+        g_array_append_val(filtered, doc_id);
+    }
+    g_array_free(matches, TRUE);
+    g_array_sort_with_data(filtered, (GCompareDataFunc)_compare_docs, index);
+
+    GSList *docs = NULL;
+    j = filtered->len;
+    while ((j > 0) && (filtered->len - j < SEARCH_MAX_RESULTS)) {
+        j--;
+        guint32 doc_id = g_array_index(filtered, guint32, j);
+        docs = g_slist_prepend(docs, &g_array_index(index->docs, SearchDoc, doc_id));
+    }
+    g_array_free(filtered, TRUE);
+
+    if (docs == NULL) {
+        return TRUE;
+    }
+
+    // read matching lines from the logs
+    chat_log_flush();
+    GSList *curr = docs;
+    while (curr != NULL) {
+        SearchDoc *doc = curr->data;
+        gchar *filename = _log_filename(index, doc->contact, doc->date);
+        FILE *logp = fopen(filename, "r");
+        if (logp != NULL) {
+            gchar *line = g_malloc0(doc->length + 1);
+            if ((fseek(logp, doc->offset, SEEK_SET) == 0) &&
+                    (fread(line, 1, doc->length, logp) == doc->length)) {
+                SearchContact *contact = g_ptr_array_index(index->contacts,
+                    doc->contact);
+                g_strdelimit(line, "\n", ' ');
+                *results = g_slist_prepend(*results, g_strdup_printf(
+                    "%s %u/%u/%u %s", contact->jid, doc->date % 100,
+                    (doc->date / 100) % 100, doc->date / 10000, line));
+            }
+            g_free(line);
+            fclose(logp);
+        }
+        g_free(filename);
+        curr = g_slist_next(curr);
+    }
+    g_slist_free(docs);
+
+    *results = g_slist_reverse(*results);
+    return TRUE;
+}
+
+/*
+ * Whether all logs for login that existed before its index was created
+ * have been added, lines from the rest are not found until then
+ */
+gboolean
+search_built(const char * const login)
+{
+    SearchIndex *index = _index_get(login);
+    _index_load_all(index);
+
+    return index->built;
+}
+
+// write index records buffered since the last flush
+void
+search_flush(void)
+{
+    if (indexes == NULL) {
+        return;
+    }
+
+    GHashTableIter iter;
+    gpointer index;
+    g_hash_table_iter_init(&iter, indexes);
+    while (g_hash_table_iter_next(&iter, NULL, &index)) {
+        _index_flush(index);
+    }
+}
+
+void
+search_close(void)
+{
+    if (indexes != NULL) {
+        g_hash_table_destroy(indexes);
+        indexes = NULL;
+    }
+}
+
+static SearchIndex *
+_index_get(const char * const login)
+{
+    if (indexes == NULL) {
+        indexes = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+            (GDestroyNotify)_index_free);
+    }
+
+    SearchIndex *index = g_hash_table_lookup(indexes, login);
+    if (index != NULL) {
+        return index;
+    }
+
+    index = malloc(sizeof(SearchIndex));
+    index->file = NULL;
+    index->docs = g_array_new(FALSE, FALSE, sizeof(SearchDoc));
+    index->term_ids = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    index->postings = g_ptr_array_new_with_free_func((GDestroyNotify)g_array_unref);
+    index->contact_ids = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    index->contacts = g_ptr_array_new_with_free_func(
+        (GDestroyNotify)_search_contact_free);
+    index->loaded = FALSE;
+    index->contents = NULL;
+    index->size = 0;
+    index->offset = 0;
+    index->unbuilt = 0;
+    index->waiting = NULL;
+    index->built = FALSE;
+    index->built_logs = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    index->pending = NULL;
+
+    gchar *xdg_data = xdg_get_data_home();
+    gchar *login_dir = str_replace(login, "@", "_at_");
+    index->logs_dir = g_strdup_printf("%s/profanity/chatlogs/%s", xdg_data,
+        login_dir);
+    index->index_loc = g_strdup_printf("%s/%s", index->logs_dir,
+        SEARCH_INDEX_FILE);
+    free(login_dir);
+    free(xdg_data);
+
+    mkdir_recursive(index->logs_dir);
+    index->source = g_idle_add(_index_step, index);
+
+    g_hash_table_insert(indexes, strdup(login), index);
+
+    return index;
+}
+
+static void
+_index_free(SearchIndex *index)
+{
+    // lines logged before the file was read still need writing
+    if (index->waiting != NULL) {
+        _index_load_all(index);
+    }
+
+    if (index->source != 0) {
+        g_source_remove(index->source);
+    }
+    g_free(index->contents);
+    if (index->file != NULL) {
+        fclose(index->file);
+    }
+    g_free(index->logs_dir);
+    g_free(index->index_loc);
+    g_array_free(index->docs, TRUE);
+    g_hash_table_destroy(index->term_ids);
+    g_ptr_array_free(index->postings, TRUE);
+    g_hash_table_destroy(index->contact_ids);
+    g_ptr_array_free(index->contacts, TRUE);
+    if (index->built_logs != NULL) {
+        g_hash_table_destroy(index->built_logs);
+    }
+    g_slist_free_full(index->pending, (GDestroyNotify)_search_log_free);
+    free(index);
+}
+
+static void
+_index_add(SearchIndex *index, const char * const contact, gboolean room,
+    guint32 date, long offset, const char * const line)
+{
+    if (index->file == NULL) {
+        return;
+    }
+
+    // the build reads the line with the rest of the day log
+    guint32 contact_id = 0;
+    if (!index->built && (!_find_contact(index, contact, room, &contact_id) ||
+            !_log_built(index, contact_id, date))) {
+        return;
+    }
+
+    GString *bytes = g_string_new(NULL);
+    contact_id = _contact_id(index, bytes, contact, room);
+    _add_line(index, bytes, contact_id, date, offset, line);
+    _index_write(index, bytes);
+    g_string_free(bytes, TRUE);
+}
+
+/*
+ * Read some of the index file, or once it has been read add a day log for
+ * the initial build
+ */
+static gboolean
+_index_step(gpointer data)
+{
+    SearchIndex *index = data;
+
+    if (!index->loaded) {
+        _load_step(index);
+        return TRUE;
+    }
+
+    if (!index->built && (index->file != NULL) && _build_step(index)) {
+        return TRUE;
+    }
+
+    index->source = 0;
+    return FALSE;
+}
+
+// finish reading the index file now, when it is about to be used
+static void
+_index_load_all(SearchIndex *index)
+{
+    while (!index->loaded) {
+        _load_step(index);
+    }
+}
+
+static void
+_load_step(SearchIndex *index)
+{
+    if ((index->contents == NULL) && !_load_open(index)) {
+        _load_done(index);
+        return;
+    }
+
+    int i;
+    for (i = 0; i < SEARCH_LOAD_RECORDS; i++) {
+        if (!_load_next(index)) {
+            _load_done(index);
+            return;
+        }
+    }
+}
+
+/*
+ * Read the index file into memory, starting a new one when there is none
+ * or it cannot be read. Returns FALSE if there are no records to load.
+ */
+static gboolean
+_load_open(SearchIndex *index)
+{
+    if (g_file_get_contents(index->index_loc, &index->contents, &index->size, NULL)) {
+        if ((index->size >= SEARCH_INDEX_HEADER_SIZE) &&
+                (memcmp(index->contents, SEARCH_INDEX_MAGIC, 4) == 0) &&
+                (_get_u32(index->contents + 4) == SEARCH_INDEX_VERSION)) {
+            index->offset = SEARCH_INDEX_HEADER_SIZE;
+            index->unbuilt = 0;
+            return TRUE;
+        }
+
+        log_warning("Discarding unreadable search index: %s", index->index_loc);
+        g_free(index->contents);
+        index->contents = NULL;
+    }
+
+    GString *header = g_string_new(NULL);
+    g_string_append_len(header, SEARCH_INDEX_MAGIC, 4);
+    _put_u32(header, SEARCH_INDEX_VERSION);
+    if (!g_file_set_contents(index->index_loc, header->str, header->len, NULL)) {
+        log_error("Could not create search index: %s", index->index_loc);
+    }
+    g_string_free(header, TRUE);
+
+    return FALSE;
+}
+
+// load the next record, FALSE at the end of the file or an unreadable record
+static gboolean
+_load_next(SearchIndex *index)
+{
+    gsize offset = index->offset;
+    if (offset + 8 > index->size) {
+        return FALSE;
+    }
+
+    guint32 type = _get_u32(index->contents + offset);
+    guint32 record_size = _get_u32(index->contents + offset + 4);
+    const gchar *data = index->contents + offset + 8;
+    if ((offset + 8 + record_size > index->size) ||
+            !_load_record(index, type, data, record_size)) {
+        return FALSE;
+    }
+
+    // start of lines from a day log the build did not finish
+    if ((type == SEARCH_RECORD_LINE) && (index->unbuilt == 0) &&
+            !_log_built(index, _get_u32(data), _get_u32(data + 4))) {
+        index->unbuilt = offset;
+    } else if (type == SEARCH_RECORD_BUILT) {
+        index->unbuilt = 0;
+    }
+    index->offset = offset + 8 + record_size;
+
+    return TRUE;
+}
+
+static void
+_load_done(SearchIndex *index)
+{
+    // drop anything left by an interrupted write so appends stay readable,
+    // and lines the build will add again
+    gsize end = index->offset;
+    if (index->unbuilt != 0) {
+        end = index->unbuilt;
+    }
+    gboolean reload = FALSE;
+    if ((index->contents != NULL) && (end < index->size)) {
+        log_warning("Truncating search index: %s", index->index_loc);
+        if (truncate(index->index_loc, end) != 0) {
+            log_error("Could not truncate search index: %s", index->index_loc);
+        } else {
+            reload = (index->unbuilt != 0);
+        }
+    }
+    g_free(index->contents);
+    index->contents = NULL;
+    index->size = 0;
+
+    // read what is left from the start
+    if (reload) {
+        _index_clear(index);
+        return;
+    }
+
+    index->loaded = TRUE;
+    index->file = fopen(index->index_loc, "ab");
+    if (index->file == NULL) {
+        log_error("Error opening search index %s", index->index_loc);
+    } else if (!index->built) {
+        log_info("Building search index in %s", index->logs_dir);
+    }
+
+    GSList *waiting = g_slist_reverse(index->waiting);
+    index->waiting = NULL;
+    GSList *curr = waiting;
+    while (curr != NULL) {
+        SearchLine *line = curr->data;
+        _index_add(index, line->jid, line->room, line->date, line->offset,
+            line->line);
+        curr = g_slist_next(curr);
+    }
+    g_slist_free_full(waiting, (GDestroyNotify)_search_line_free);
+}
+
+static void
+_index_clear(SearchIndex *index)
+{
+    g_array_set_size(index->docs, 0);
+    g_hash_table_remove_all(index->term_ids);
+    g_ptr_array_set_size(index->postings, 0);
+    g_hash_table_remove_all(index->contact_ids);
+    g_ptr_array_set_size(index->contacts, 0);
+    index->built = FALSE;
+    if (index->built_logs == NULL) {
+        index->built_logs = g_hash_table_new_full(g_str_hash, g_str_equal,
+            g_free, NULL);
+    }
+    g_hash_table_remove_all(index->built_logs);
+}
+
+static gboolean
+_load_record(SearchIndex *index, guint32 type, const gchar *data, guint32 size)
+{
+    switch (type)
+    {
+        case SEARCH_RECORD_TERM:
+        {
+            if (size == 0) {
+                return FALSE;
+            }
+            gchar *term = g_strndup(data, size);
+            g_hash_table_insert(index->term_ids, term,
+                GUINT_TO_POINTER(index->postings->len));
+            g_ptr_array_add(index->postings,
+                g_array_new(FALSE, FALSE, sizeof(SearchPosting)));
+            return TRUE;
+        }
+        case SEARCH_RECORD_CONTACT:
+        {
+            if (size <= 4) {
+                return FALSE;
+            }
+            SearchContact *contact = malloc(sizeof(SearchContact));
+            contact->room = (_get_u32(data) != 0);
+            contact->jid = g_strndup(data + 4, size - 4);
+            g_hash_table_insert(index->contact_ids,
+                _contact_key(contact->jid, contact->room),
+                GUINT_TO_POINTER(index->contacts->len));
+            g_ptr_array_add(index->contacts, contact);
+            return TRUE;
+        }
+        case SEARCH_RECORD_LINE:
+        {
+            if ((size < SEARCH_LINE_SIZE) || ((size % 4) != 0) ||
+                    (_get_u32(data) >= index->contacts->len)) {
+                return FALSE;
+            }
+            guint32 num_terms = (size - SEARCH_LINE_SIZE) / 4;
+            guint32 i;
+            for (i = 0; i < num_terms; i++) {
+                if (_get_u32(data + SEARCH_LINE_SIZE + (i * 4)) >= index->postings->len) {
+                    return FALSE;
+                }
+            }
+
+            SearchDoc doc;
+            doc.contact = _get_u32(data);
+            doc.date = _get_u32(data + 4);
+            doc.offset = _get_u32(data + 8);
+            doc.length = _get_u32(data + 12);
+
+            SearchPosting posting;
+            posting.doc = index->docs->len;
+            g_array_append_val(index->docs, doc);
+            for (i = 0; i < num_terms; i++) {
+                guint32 term = _get_u32(data + SEARCH_LINE_SIZE + (i * 4));
+                posting.pos = i;
+                g_array_append_val(g_ptr_array_index(index->postings, term), posting);
+            }
+            return TRUE;
+        }
+        case SEARCH_RECORD_BUILT:
+        {
+            if ((size != 8) || (_get_u32(data) >= index->contacts->len)) {
+                return FALSE;
+            }
+            if (index->built_logs != NULL) {
+                g_hash_table_add(index->built_logs, g_strdup_printf("%u/%u",
+                    _get_u32(data), _get_u32(data + 4)));
+            }
+            return TRUE;
+        }
+        case SEARCH_RECORD_BUILD_DONE:
+        {
+            if (size != 0) {
+                return FALSE;
+            }
+            index->built = TRUE;
+            if (index->built_logs != NULL) {
+                g_hash_table_destroy(index->built_logs);
+                index->built_logs = NULL;
+            }
+            return TRUE;
+        }
+        default:
+            return FALSE;
+    }
+}
+
+/*
+ * Append records already added to the index in memory, they are written
+ * out with the chat logs. Stop writing if that fails so the file stays a
+ * prefix of what is in memory.
+ */
+static void
+_index_write(SearchIndex *index, GString *bytes)
+{
+    if (fwrite(bytes->str, 1, bytes->len, index->file) != bytes->len) {
+        log_error("Could not write search index: %s", index->index_loc);
+        fclose(index->file);
+        index->file = NULL;
+    }
+}
+
+static void
+_index_flush(SearchIndex *index)
+{
+    if ((index->file != NULL) && (fflush(index->file) != 0)) {
+        log_error("Could not write search index: %s", index->index_loc);
+        fclose(index->file);
+        index->file = NULL;
+    }
+}
+
+static guint32
+_term_id(SearchIndex *index, GString *bytes, const char * const term)
+{
+    gpointer id = NULL;
+    if (g_hash_table_lookup_extended(index->term_ids, term, NULL, &id)) {
+        return GPOINTER_TO_UINT(id);
+    }
+
+    _put_record(bytes, SEARCH_RECORD_TERM, strlen(term));
+    g_string_append(bytes, term);
+    _load_record(index, SEARCH_RECORD_TERM, term, strlen(term));
+
+    return index->postings->len - 1;
+}
+
+static guint32
+_contact_id(SearchIndex *index, GString *bytes, const char * const jid,
+    gboolean room)
+{
+    guint32 id = 0;
+    if (_find_contact(index, jid, room, &id)) {
+        return id;
+    }
+
+    gsize start = bytes->len;
+    _put_record(bytes, SEARCH_RECORD_CONTACT, 4 + strlen(jid));
+    _put_u32(bytes, room ? 1 : 0);
+    g_string_append(bytes, jid);
+    _load_record(index, SEARCH_RECORD_CONTACT, bytes->str + start + 8,
+        bytes->len - start - 8);
+
+    return index->contacts->len - 1;
+}
+
+/*
+ * Add a line to the index in memory and its record to bytes, with records
+ * for any words and contact not seen before
+ */
+static void
+_add_line(SearchIndex *index, GString *bytes, guint32 contact, guint32 date,
+    guint32 offset, const char * const line)
+{
+    // skip the time at the start of the line
+    const char *text = strstr(line, " - ");
+    if (text == NULL) {
+        text = line;
+    }
+
+    GPtrArray *terms = _tokenize(text);
+    GString *record = g_string_new(NULL);
+    _put_u32(record, contact);
+    _put_u32(record, date);
+    _put_u32(record, offset);
+    _put_u32(record, strlen(line));
+    guint i;
+    for (i = 0; i < terms->len; i++) {
+        _put_u32(record, _term_id(index, bytes, g_ptr_array_index(terms, i)));
+    }
+    g_ptr_array_free(terms, TRUE);
+
+    _put_record(bytes, SEARCH_RECORD_LINE, record->len);
+    g_string_append_len(bytes, record->str, record->len);
+    _load_record(index, SEARCH_RECORD_LINE, record->str, record->len);
+    g_string_free(record, TRUE);
+}
+
+static gboolean
+_find_contact(SearchIndex *index, const char * const jid, gboolean room,
+    guint32 *id)
+{
+    gchar *key = _contact_key(jid, room);
+    gpointer found_id = NULL;
+    gboolean found = g_hash_table_lookup_extended(index->contact_ids, key,
+        NULL, &found_id);
+    g_free(key);
+
+    *id = GPOINTER_TO_UINT(found_id);
+    return found;
+}
+
+// whether the day log has been added, by the build or since it finished
+static gboolean
+_log_built(SearchIndex *index, guint32 contact, guint32 date)
+{
+    if (index->built_logs == NULL) {
+        return TRUE;
+    }
+
+    gchar *key = g_strdup_printf("%u/%u", contact, date);
+    gboolean built = g_hash_table_contains(index->built_logs, key);
+    g_free(key);
+
+    return built;
+}
+
+/*
+ * Add one day log, once none are left look again for logs started since,
+ * the build is done when there are none
+ */
+static gboolean
+_build_step(SearchIndex *index)
+{
+    if (index->pending == NULL) {
+        _build_scan(index, index->logs_dir, FALSE);
+        gchar *rooms_dir = g_strdup_printf("%s/rooms", index->logs_dir);
+        _build_scan(index, rooms_dir, TRUE);
+        g_free(rooms_dir);
+    }
+
+    if (index->pending == NULL) {
+        GString *bytes = g_string_new(NULL);
+        _put_record(bytes, SEARCH_RECORD_BUILD_DONE, 0);
+        _load_record(index, SEARCH_RECORD_BUILD_DONE, NULL, 0);
+        _index_write(index, bytes);
+        _index_flush(index);
+        g_string_free(bytes, TRUE);
+        return FALSE;
+    }
+
+    SearchLog *log = index->pending->data;
+    index->pending = g_slist_delete_link(index->pending, index->pending);
+    _build_log(index, log);
+    _search_log_free(log);
+
+    return (index->file != NULL);
+}
+
+/*
+ * Find day logs in dir not yet built, each subdirectory holds the logs for
+ * one contact or room, with a file per day
+ */
+static void
+_build_scan(SearchIndex *index, const char * const dir, gboolean room)
+{
+    GDir *logs_dir = g_dir_open(dir, 0, NULL);
+    if (logs_dir == NULL) {
+        return;
+    }
+
+    const gchar *contact_dir;
+    while ((contact_dir = g_dir_read_name(logs_dir)) != NULL) {
+        if (!room && (g_strcmp0(contact_dir, "rooms") == 0)) {
+            continue;
+        }
+
+        gchar *contact_path = g_strdup_printf("%s/%s", dir, contact_dir);
+        GDir *days_dir = g_dir_open(contact_path, 0, NULL);
+        if (days_dir == NULL) {
+            g_free(contact_path);
+            continue;
+        }
+
+        char *jid = str_replace(contact_dir, "_at_", "@");
+        const gchar *day;
+        while ((day = g_dir_read_name(days_dir)) != NULL) {
+            guint year, month, dayofmonth;
+            if (sscanf(day, "%4u_%2u_%2u.log", &year, &month, &dayofmonth) != 3) {
+                continue;
+            }
+
+            guint32 date = (year * 10000) + (month * 100) + dayofmonth;
+            guint32 contact = 0;
+            if (_find_contact(index, jid, room, &contact) &&
+                    _log_built(index, contact, date)) {
+                continue;
+            }
+
+            SearchLog *log = malloc(sizeof(SearchLog));
+            log->filename = g_strdup_printf("%s/%s", contact_path, day);
+            log->jid = g_strdup(jid);
+            log->room = room;
+            log->date = date;
+            index->pending = g_slist_prepend(index->pending, log);
+        }
+        free(jid);
+        g_dir_close(days_dir);
+        g_free(contact_path);
+    }
+    g_dir_close(logs_dir);
+}
+
+static void
+_build_log(SearchIndex *index, SearchLog *log)
+{
+    GString *bytes = g_string_new(NULL);
+    guint32 contact = _contact_id(index, bytes, log->jid, log->room);
+
+    // lines logged while the day was waiting may still be buffered
+    chat_log_flush();
+    FILE *logp = fopen(log->filename, "r");
+    if (logp != NULL) {
+        long offset = 0;
+        char *line;
+        while ((line = prof_getline(logp)) != NULL) {
+            _add_line(index, bytes, contact, log->date, offset, line);
+            free(line);
+            offset = ftell(logp);
+        }
+        fclose(logp);
+    }
+
+    gsize start = bytes->len;
+    _put_record(bytes, SEARCH_RECORD_BUILT, 8);
+    _put_u32(bytes, contact);
+    _put_u32(bytes, log->date);
+    _load_record(index, SEARCH_RECORD_BUILT, bytes->str + start + 8, 8);
+
+    // a day log is much more to read than a flush, keep the progress
+    _index_write(index, bytes);
+    _index_flush(index);
+    g_string_free(bytes, TRUE);
+}
+
+static void
+_search_line_free(SearchLine *line)
+{
+    g_free(line->jid);
+    g_free(line->line);
+    free(line);
+}
+
+static void
+_search_log_free(SearchLog *log)
+{
+    g_free(log->filename);
+    g_free(log->jid);
+    free(log);
+}
+
+static void
+_search_contact_free(SearchContact *contact)
+{
+    g_free(contact->jid);
+    free(contact);
+}
+
+static gchar *
+_log_filename(SearchIndex *index, guint32 contact_id, guint32 date)
+{
+    SearchContact *contact = g_ptr_array_index(index->contacts, contact_id);
+    char *contact_dir = str_replace(contact->jid, "@", "_at_");
+    gchar *filename = g_strdup_printf("%s%s/%s/%04u_%02u_%02u.log",
+        index->logs_dir, contact->room ? "/rooms" : "", contact_dir,
+        date / 10000, (date / 100) % 100, date % 100);
+    free(contact_dir);
+
+    return filename;
+}
+
+static gchar *
+_contact_key(const char * const jid, gboolean room)
+{
+    return g_strdup_printf("%c%s", room ? 'r' : 'c', jid);
+}
+
+static void
+_put_u32(GString *bytes, guint32 value)
+{
+    g_string_append_len(bytes, (const gchar *)&value, 4);
+}
+
+static void
+_put_record(GString *bytes, guint32 type, guint32 size)
+{
+    _put_u32(bytes, type);
+    _put_u32(bytes, size);
+}
+
+static guint32
+_get_u32(const gchar *data)
+{
+    guint32 value;
+    memcpy(&value, data, 4);
+    return value;
+}
+
+/*
+ * Split text into lower case words
+ */
+static GPtrArray *
+_tokenize(const char * const text)
+{
+    GPtrArray *terms = g_ptr_array_new_with_free_func(g_free);
+    GString *term = g_string_new("");
+
+    const gchar *curr;
+    for (curr = text; *curr != '\0'; curr = g_utf8_next_char(curr)) {
+        gunichar ch = g_utf8_get_char(curr);
+        if (g_unichar_isalnum(ch)) {
+            g_string_append_unichar(term, g_unichar_tolower(ch));
+        } else if (term->len > 0) {
+            g_ptr_array_add(terms, g_strdup(term->str));
+            g_string_truncate(term, 0);
+        }
+    }
+    if (term->len > 0) {
+        g_ptr_array_add(terms, g_strdup(term->str));
+    }
+    g_string_free(term, TRUE);
+
+    return terms;
+}
+
+/*
+ * Find the lines containing terms in sequence, returns sorted line ids
+ */
+static GArray *
+_match_phrase(SearchIndex *index, GPtrArray *terms)
+{
+    GArray *result = g_array_new(FALSE, FALSE, sizeof(guint32));
+    GArray **postings = g_new(GArray *, terms->len);
+
+    guint i;
+    for (i = 0; i < terms->len; i++) {
+        gpointer id = NULL;
+        if (!g_hash_table_lookup_extended(index->term_ids,
+                g_ptr_array_index(terms, i), NULL, &id)) {
+            g_free(postings);
+            return result;
+        }
+        postings[i] = g_ptr_array_index(index->postings, GPOINTER_TO_UINT(id));
+    }
+
+    guint k;
+    for (k = 0; k < postings[0]->len; k++) {
+        SearchPosting *posting = &g_array_index(postings[0], SearchPosting, k);
+
+        // already matched this line
+        if ((result->len > 0) &&
+                (g_array_index(result, guint32, result->len - 1) == posting->doc)) {
+            continue;
+        }
+
+        gboolean matched = TRUE;
+        for (i = 1; i < terms->len; i++) {
+            if (!_has_posting(postings[i], posting->doc, posting->pos + i)) {
+                matched = FALSE;
+                break;
+            }
+        }
+        if (matched) {
+            g_array_append_val(result, posting->doc);
+        }
+    }
+    g_free(postings);
+
+    return result;
+}
+
+static GArray *
+_intersect(GArray *a, GArray *b)
+{
+    GArray *result = g_array_new(FALSE, FALSE, sizeof(guint32));
+    guint i = 0;
+    guint j = 0;
+
+    while ((i < a->len) && (j < b->len)) {
+        guint32 doc_a = g_array_index(a, guint32, i);
+        guint32 doc_b = g_array_index(b, guint32, j);
+        if (doc_a < doc_b) {
+            i++;
+        } else if (doc_a > doc_b) {
+            j++;
+        } else {
+            g_array_append_val(result, doc_a);
+            i++;
+            j++;
+        }
+    }
+
+    return result;
+}
+
+/*
+ * Binary search, postings are ordered by line then position
+ */
+static gboolean
+_has_posting(GArray *postings, guint32 doc, guint32 pos)
+{
+    guint low = 0;
+    guint high = postings->len;
+
+    while (low < high) {
+        guint mid = low + (high - low) / 2;
+        SearchPosting *posting = &g_array_index(postings, SearchPosting, mid);
+        if ((posting->doc == doc) && (posting->pos == pos)) {
+            return TRUE;
+        } else if ((posting->doc < doc) ||
+                ((posting->doc == doc) && (posting->pos < pos))) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    return FALSE;
+}
+
+static gboolean
+_parse_date(const char * const str, guint32 *date)
+{
+    guint year, month, day;
+    if ((sscanf(str, "%4u-%2u-%2u", &year, &month, &day) != 3) ||
+            !g_date_valid_dmy(day, month, year)) {
+        return FALSE;
+    }
+
+    *date = (year * 10000) + (month * 100) + day;
+    return TRUE;
+}
+
+/*
+ * Order lines by date, lines from the same day are kept in the order they
+ * were added
+ */
+static gint
+_compare_docs(guint32 *a, guint32 *b, SearchIndex *index)
+{
+    SearchDoc *doc_a = &g_array_index(index->docs, SearchDoc, *a);
+    SearchDoc *doc_b = &g_array_index(index->docs, SearchDoc, *b);
+
+    if (doc_a->date != doc_b->date) {
+        return (doc_a->date < doc_b->date) ? -1 : 1;
+    } else if (*a != *b) {
+        return (*a < *b) ? -1 : 1;
+    } else {
+        return 0;
+    }
+}
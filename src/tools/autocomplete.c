@@ -40,20 +40,32 @@
 #include "tools/autocomplete.h"
 #include "tools/parser.h"
 
+#define AC_INITIAL_CAPACITY 16
+
+// items are kept in a sorted array so lookups and prefix searches can use
+// binary search, all items sharing a prefix are contiguous
 struct autocomplete_t {
-    GSList *items;
-    GSList *last_found;
+    gchar **items;
+    guint length;
+    guint capacity;
+    gint last_found;
     gchar *search_str;
 };
 
-static gchar * _search_from(Autocomplete ac, GSList *curr, gboolean quote);
+static gboolean _find(Autocomplete ac, const char * const item, guint *index);
+static gboolean _has_prefix(Autocomplete ac, guint index);
+static gchar * _found_at(Autocomplete ac, guint index, gboolean quote);
+static void _grow(Autocomplete ac);
+static int _compare_items(const void *a, const void *b);
 
 Autocomplete
 autocomplete_new(void)
 {
     Autocomplete new = malloc(sizeof(struct autocomplete_t));
     new->items = NULL;
-    new->last_found = NULL;
+    new->length = 0;
+    new->capacity = 0;
+    new->last_found = -1;
     new->search_str = NULL;
 
     return new;
@@ -63,8 +75,13 @@ void
 autocomplete_clear(Autocomplete ac)
 {
     if (ac != NULL) {
-        g_slist_free_full(ac->items, free);
-        ac->items = NULL;
+        guint i;
+        for (i = 0; i < ac->length; i++) {
+            free(ac->items[i]);
+        }
+        FREE_SET_NULL(ac->items);
+        ac->length = 0;
+        ac->capacity = 0;
 
         autocomplete_reset(ac);
     }
@@ -73,7 +90,7 @@ autocomplete_clear(Autocomplete ac)
 void
 autocomplete_reset(Autocomplete ac)
 {
-    ac->last_found = NULL;
+    ac->last_found = -1;
     FREE_SET_NULL(ac->search_str);
 }
 
@@ -89,10 +106,8 @@ autocomplete_length(Autocomplete ac)
 {
     if (ac == NULL) {
         return 0;
-    } else if (ac->items == NULL) {
-        return 0;
     } else {
-        return g_slist_length(ac->items);
+        return ac->length;
     }
 }
 
@@ -100,16 +115,23 @@ void
 autocomplete_add(Autocomplete ac, const char *item)
 {
     if (ac != NULL) {
-        char *item_cpy;
-        GSList *curr = g_slist_find_custom(ac->items, item, (GCompareFunc)strcmp);
+        guint index;
 
         // if item already exists
-        if (curr != NULL) {
+        if (_find(ac, item, &index)) {
             return;
         }
 
-        item_cpy = strdup(item);
-        ac->items = g_slist_insert_sorted(ac->items, item_cpy, (GCompareFunc)strcmp);
+        _grow(ac);
+        memmove(&ac->items[index + 1], &ac->items[index],
+            (ac->length - index) * sizeof(gchar *));
+        ac->items[index] = strdup(item);
+        ac->length++;
+
+        // keep last found pointing at the same item
+        if ((ac->last_found != -1) && (index <= ac->last_found)) {
+            ac->last_found++;
+        }
     }
     return;
 }
@@ -118,33 +140,70 @@ void
 autocomplete_remove(Autocomplete ac, const char * const item)
 {
     if (ac != NULL) {
-        GSList *curr = g_slist_find_custom(ac->items, item, (GCompareFunc)strcmp);
+        guint index;
 
-        if (!curr) {
+        if (!_find(ac, item, &index)) {
             return;
         }
 
         // reset last found if it points to the item to be removed
-        if (ac->last_found == curr) {
-            ac->last_found = NULL;
+        if (ac->last_found == index) {
+            ac->last_found = -1;
+        } else if ((ac->last_found != -1) && (index < ac->last_found)) {
+            ac->last_found--;
         }
 
-        free(curr->data);
-        ac->items = g_slist_delete_link(ac->items, curr);
+        free(ac->items[index]);
+        memmove(&ac->items[index], &ac->items[index + 1],
+            (ac->length - index - 1) * sizeof(gchar *));
+        ac->length--;
     }
 
     return;
 }
 
+void
+autocomplete_append(Autocomplete ac, const char *item)
+{
+    if (ac != NULL) {
+        _grow(ac);
+        ac->items[ac->length++] = strdup(item);
+    }
+}
+
+void
+autocomplete_sort(Autocomplete ac)
+{
+    if ((ac == NULL) || (ac->length == 0)) {
+        return;
+    }
+
+    qsort(ac->items, ac->length, sizeof(gchar *), _compare_items);
+
+    // remove duplicates
+    guint i;
+    guint unique = 1;
+    for (i = 1; i < ac->length; i++) {
+        if (strcmp(ac->items[i], ac->items[unique - 1]) == 0) {
+            free(ac->items[i]);
+        } else {
+            ac->items[unique++] = ac->items[i];
+        }
+    }
+    ac->length = unique;
+
+    autocomplete_reset(ac);
+}
+
 GSList *
 autocomplete_get_list(Autocomplete ac)
 {
     GSList *copy = NULL;
-    GSList *curr = ac->items;
+    guint i = ac->length;
 
-    while(curr) {
-        copy = g_slist_append(copy, strdup(curr->data));
-        curr = g_slist_next(curr);
+    while (i > 0) {
+        i--;
+        copy = g_slist_prepend(copy, strdup(ac->items[i]));
     }
 
     return copy;
@@ -153,49 +212,42 @@ autocomplete_get_list(Autocomplete ac)
 gboolean
 autocomplete_contains(Autocomplete ac, const char *value)
 {
-    GSList *curr = ac->items;
-
-    while(curr) {
-        if (strcmp(curr->data, value) == 0) {
-            return TRUE;
-        }
-        curr = g_slist_next(curr);
-    }
-
-    return FALSE;
+    guint index;
+    return _find(ac, value, &index);
 }
 
 gchar *
 autocomplete_complete(Autocomplete ac, gchar *search_str, gboolean quote)
 {
-    gchar *found = NULL;
+    guint first;
 
     // no autocomplete to search
     if (ac == NULL)
         return NULL;
 
     // no items to search
-    if (!ac->items)
+    if (ac->length == 0)
         return NULL;
 
     // first search attempt
-    if (ac->last_found == NULL) {
+    if (ac->last_found == -1) {
         if (ac->search_str != NULL) {
             FREE_SET_NULL(ac->search_str);
         }
         ac->search_str = strdup(search_str);
-        found = _search_from(ac, ac->items, quote);
-        return found;
+        _find(ac, ac->search_str, &first);
+        return _found_at(ac, first, quote);
 
     // subsequent search attempt
     } else {
-        // search from here+1 to end
-        found = _search_from(ac, g_slist_next(ac->last_found), quote);
+        // next item, if it shares the prefix
+        gchar *found = _found_at(ac, ac->last_found + 1, quote);
         if (found != NULL)
             return found;
 
-        // search from beginning
-        found = _search_from(ac, ac->items, quote);
+        // wrap around to first item with the prefix
+        _find(ac, ac->search_str, &first);
+        found = _found_at(ac, first, quote);
         if (found != NULL)
             return found;
 
@@ -309,36 +361,84 @@ autocomplete_param_no_with_func(char *input, int *size, char *command,
     return NULL;
 }
 
-static gchar *
-_search_from(Autocomplete ac, GSList *curr, gboolean quote)
+/*
+ * Binary search for item, return TRUE if found. index is set to the position
+ * of the item, or the position it would be inserted at if not found, which is
+ * also the first item prefixed with it
+ */
+static gboolean
+_find(Autocomplete ac, const char * const item, guint *index)
 {
-    while(curr) {
+    guint low = 0;
+    guint high = ac->length;
+
+    while (low < high) {
+        guint mid = low + (high - low) / 2;
+        int cmp = strcmp(ac->items[mid], item);
+        if (cmp == 0) {
+            *index = mid;
+            return TRUE;
+        } else if (cmp < 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    *index = low;
+    return FALSE;
+}
+
+static gboolean
+_has_prefix(Autocomplete ac, guint index)
+{
+    if (index >= ac->length) {
+        return FALSE;
+    }
 
-        // match found
-        if (strncmp(curr->data, ac->search_str, strlen(ac->search_str)) == 0) {
+    return (strncmp(ac->items[index], ac->search_str, strlen(ac->search_str)) == 0);
+}
 
-            // set pointer to last found
-            ac->last_found = curr;
+static gchar *
+_found_at(Autocomplete ac, guint index, gboolean quote)
+{
+    // match found
+    if (_has_prefix(ac, index)) {
 
-            // if contains space, quote before returning
-            if (quote && g_strrstr(curr->data, " ")) {
-                GString *quoted = g_string_new("\"");
-                g_string_append(quoted, curr->data);
-                g_string_append(quoted, "\"");
+        // set pointer to last found
+        ac->last_found = index;
 
-                gchar *result = quoted->str;
-                g_string_free(quoted, FALSE);
+        // if contains space, quote before returning
+        if (quote && g_strrstr(ac->items[index], " ")) {
+            GString *quoted = g_string_new("\"");
+            g_string_append(quoted, ac->items[index]);
+            g_string_append(quoted, "\"");
 
-                return result;
+            gchar *result = quoted->str;
+            g_string_free(quoted, FALSE);
 
-            // otherwise just return the string
-            } else {
-                return strdup(curr->data);
-            }
-        }
+            return result;
 
-        curr = g_slist_next(curr);
+        // otherwise just return the string
+        } else {
+            return strdup(ac->items[index]);
+        }
     }
 
     return NULL;
 }
+
+static void
+_grow(Autocomplete ac)
+{
+    if (ac->length == ac->capacity) {
+        ac->capacity = (ac->capacity == 0) ? AC_INITIAL_CAPACITY : ac->capacity * 2;
+        ac->items = realloc(ac->items, ac->capacity * sizeof(gchar *));
+    }
+}
+
+static int
+_compare_items(const void *a, const void *b)
+{
+    return strcmp(*(gchar * const *)a, *(gchar * const *)b);
+}
@@ -52,6 +52,11 @@ void autocomplete_free(Autocomplete ac);
 void autocomplete_add(Autocomplete ac, const char *item);
 void autocomplete_remove(Autocomplete ac, const char * const item);
 
+// append item without keeping the list sorted, for loading many items at once,
+// autocomplete_sort must be called before the autocompleter is used again
+void autocomplete_append(Autocomplete ac, const char *item);
+void autocomplete_sort(Autocomplete ac);
+
 // find the next item prefixed with search string
 gchar * autocomplete_complete(Autocomplete ac, gchar *search_str, gboolean quote);
 
@@ -0,0 +1,528 @@
+/*
+ * gapbuffer.c
+ *
+ * Copyright (C) 2012 - 2014 James Booth <boothj5@gmail.com>
+ *
+ * This file is part of Profanity.
+ *
+ * Profanity is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Profanity is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Profanity.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give permission to
+ * link the code of portions of this program with the OpenSSL library under
+ * certain conditions as described in each individual source file, and
+ * distribute linked combinations including the two.
+ *
+ * You must obey the GNU General Public License in all respects for all of the
+ * code used other than OpenSSL. If you modify file(s) with this exception, you
+ * may extend this exception to your version of the file(s), but you are not
+ * obligated to do so. If you do not wish to do so, delete this exception
+ * statement from your version. If you delete this exception statement from all
+ * source files in the program, then also delete it here.
+ *
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "tools/gapbuffer.h"
+
+#define GAP_MIN 64
+
+// text is kept in one allocation with a gap at the last edit, edits move the
+// gap to the cursor so typing at the same place only copies the new bytes,
+// moving the cursor never copies
+struct gap_buffer_t {
+    gchar *buf;
+    gsize size;
+    gsize gap_start;
+    gsize gap_end;
+
+    // cursor as a byte offset into the text, ignoring the gap
+    gsize point;
+
+    // cached counts so callers never need to scan the text
+    glong point_chars;
+    glong chars;
+    glong point_line;
+    glong lines;
+    int column;
+
+    // first byte changed since gap_buffer_take_changed was last called
+    gboolean changed;
+    gsize changed_from;
+};
+
+static gsize _gap(GapBuffer gb);
+static const gchar * _at(GapBuffer gb, gsize pos);
+static void _move_gap(GapBuffer gb, gsize pos);
+static void _reserve(GapBuffer gb, gsize len);
+static gunichar _step_left(GapBuffer gb);
+static gunichar _step_right(GapBuffer gb);
+static void _update_column(GapBuffer gb);
+static void _forward_to_column(GapBuffer gb, int column);
+static void _changed(GapBuffer gb, gsize pos);
+
+GapBuffer
+gap_buffer_new(void)
+{
+    GapBuffer new = malloc(sizeof(struct gap_buffer_t));
+    new->size = GAP_MIN;
+    new->buf = malloc(new->size);
+    new->gap_start = 0;
+    new->gap_end = new->size;
+    new->point = 0;
+    new->point_chars = 0;
+    new->chars = 0;
+    new->point_line = 0;
+    new->lines = 0;
+    new->column = 0;
+    new->changed = FALSE;
+    new->changed_from = 0;
+
+    return new;
+}
+
+void
+gap_buffer_free(GapBuffer gb)
+{
+    if (gb != NULL) {
+        free(gb->buf);
+        free(gb);
+    }
+}
+
+void
+gap_buffer_clear(GapBuffer gb)
+{
+    _changed(gb, 0);
+    gb->gap_start = 0;
+    gb->gap_end = gb->size;
+    gb->point = 0;
+    gb->point_chars = 0;
+    gb->chars = 0;
+    gb->point_line = 0;
+    gb->lines = 0;
+    gb->column = 0;
+}
+
+void
+gap_buffer_set(GapBuffer gb, const char * const text)
+{
+    gap_buffer_clear(gb);
+    gap_buffer_insert(gb, text, strlen(text));
+}
+
+void
+gap_buffer_insert(GapBuffer gb, const char * const text, gsize len)
+{
+    // only whole characters are stored
+    const gchar *valid_end = NULL;
+    g_utf8_validate(text, len, &valid_end);
+    len = valid_end - text;
+    if (len == 0) {
+        return;
+    }
+
+    _changed(gb, gb->point);
+    _move_gap(gb, gb->point);
+    _reserve(gb, len);
+    memcpy(gb->buf + gb->gap_start, text, len);
+    gb->gap_start += len;
+    gb->point += len;
+
+    const gchar *curr = text;
+    while (curr < valid_end) {
+        gunichar ch = g_utf8_get_char(curr);
+        gb->chars++;
+        gb->point_chars++;
+        if (ch == '\n') {
+            gb->lines++;
+            gb->point_line++;
+            gb->column = 0;
+        } else {
+            gb->column += gap_buffer_char_width(ch);
+        }
+        curr = g_utf8_next_char(curr);
+    }
+}
+
+gboolean
+gap_buffer_delete_before(GapBuffer gb)
+{
+    if (gb->point == 0) {
+        return FALSE;
+    }
+
+    _move_gap(gb, gb->point);
+    gunichar ch = _step_left(gb);
+    _changed(gb, gb->point);
+    gb->gap_start = gb->point;
+    gb->chars--;
+    if (ch == '\n') {
+        gb->lines--;
+        _update_column(gb);
+    } else {
+        gb->column -= gap_buffer_char_width(ch);
+    }
+
+    return TRUE;
+}
+
+gboolean
+gap_buffer_delete_after(GapBuffer gb)
+{
+    if (gb->point == gap_buffer_bytes(gb)) {
+        return FALSE;
+    }
+
+    _move_gap(gb, gb->point);
+    const gchar *curr = gb->buf + gb->gap_end;
+    gunichar ch = g_utf8_get_char(curr);
+    gsize len = g_utf8_next_char(curr) - curr;
+    _changed(gb, gb->point);
+    gb->gap_end += len;
+    gb->chars--;
+    if (ch == '\n') {
+        gb->lines--;
+    }
+
+    return TRUE;
+}
+
+gboolean
+gap_buffer_left(GapBuffer gb)
+{
+    if (gb->point == 0) {
+        return FALSE;
+    }
+
+    gunichar ch = _step_left(gb);
+    if (ch == '\n') {
+        _update_column(gb);
+    } else {
+        gb->column -= gap_buffer_char_width(ch);
+    }
+
+    return TRUE;
+}
+
+gboolean
+gap_buffer_right(GapBuffer gb)
+{
+    if (gb->point == gap_buffer_bytes(gb)) {
+        return FALSE;
+    }
+
+    gunichar ch = _step_right(gb);
+    if (ch == '\n') {
+        gb->column = 0;
+    } else {
+        gb->column += gap_buffer_char_width(ch);
+    }
+
+    return TRUE;
+}
+
+gboolean
+gap_buffer_up(GapBuffer gb)
+{
+    if (gb->point_line == 0) {
+        return FALSE;
+    }
+
+    int column = gb->column;
+    gap_buffer_home(gb);
+    _step_left(gb);
+    gap_buffer_home(gb);
+    _forward_to_column(gb, column);
+
+    return TRUE;
+}
+
+gboolean
+gap_buffer_down(GapBuffer gb)
+{
+    if (gb->point_line == gb->lines) {
+        return FALSE;
+    }
+
+    int column = gb->column;
+    gap_buffer_end(gb);
+    _step_right(gb);
+    gb->column = 0;
+    _forward_to_column(gb, column);
+
+    return TRUE;
+}
+
+void
+gap_buffer_home(GapBuffer gb)
+{
+    while ((gb->point > 0) && (gap_buffer_before(gb) != '\n')) {
+        _step_left(gb);
+    }
+    gb->column = 0;
+}
+
+void
+gap_buffer_end(GapBuffer gb)
+{
+    gunichar ch = gap_buffer_after(gb);
+    while ((ch != 0) && (ch != '\n')) {
+        gap_buffer_right(gb);
+        ch = gap_buffer_after(gb);
+    }
+}
+
+gunichar
+gap_buffer_before(GapBuffer gb)
+{
+    if (gb->point == 0) {
+        return 0;
+    }
+
+    gsize pos = gb->point - 1;
+    while ((pos > 0) && ((*_at(gb, pos) & 0xc0) == 0x80)) {
+        pos--;
+    }
+
+    return g_utf8_get_char(_at(gb, pos));
+}
+
+gunichar
+gap_buffer_after(GapBuffer gb)
+{
+    if (gb->point == gap_buffer_bytes(gb)) {
+        return 0;
+    }
+
+    return g_utf8_get_char(_at(gb, gb->point));
+}
+
+gboolean
+gap_buffer_starts_with(GapBuffer gb, const char * const prefix)
+{
+    gsize len = strlen(prefix);
+    if (len > gap_buffer_bytes(gb)) {
+        return FALSE;
+    }
+
+    gsize i;
+    for (i = 0; i < len; i++) {
+        if (*_at(gb, i) != prefix[i]) {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+gsize
+gap_buffer_bytes(GapBuffer gb)
+{
+    return gb->size - _gap(gb);
+}
+
+glong
+gap_buffer_length(GapBuffer gb)
+{
+    return gb->chars;
+}
+
+gsize
+gap_buffer_point(GapBuffer gb)
+{
+    return gb->point;
+}
+
+const char *
+gap_buffer_at(GapBuffer gb, gsize pos)
+{
+    return _at(gb, pos);
+}
+
+/*
+ * The first byte of the text changed since the last call, the text before it
+ * is as it was. FALSE if nothing has changed.
+ */
+gboolean
+gap_buffer_take_changed(GapBuffer gb, gsize *from)
+{
+    if (!gb->changed) {
+        return FALSE;
+    }
+
+    *from = gb->changed_from;
+    gb->changed = FALSE;
+
+    return TRUE;
+}
+
+glong
+gap_buffer_cursor(GapBuffer gb)
+{
+    return gb->point_chars;
+}
+
+glong
+gap_buffer_line(GapBuffer gb)
+{
+    return gb->point_line;
+}
+
+int
+gap_buffer_column(GapBuffer gb)
+{
+    return gb->column;
+}
+
+const char *
+gap_buffer_text(GapBuffer gb)
+{
+    // the gap is never empty after an edit, so there is room for the nul
+    _move_gap(gb, gap_buffer_bytes(gb));
+    gb->buf[gb->gap_start] = '\0';
+
+    return gb->buf;
+}
+
+int
+gap_buffer_char_width(gunichar ch)
+{
+    if (g_unichar_iszerowidth(ch)) {
+        return 0;
+    } else if (g_unichar_iswide(ch)) {
+        return 2;
+    } else {
+        return 1;
+    }
+}
+
+static gsize
+_gap(GapBuffer gb)
+{
+    return gb->gap_end - gb->gap_start;
+}
+
+static const gchar *
+_at(GapBuffer gb, gsize pos)
+{
+    if (pos < gb->gap_start) {
+        return gb->buf + pos;
+    } else {
+        return gb->buf + pos + _gap(gb);
+    }
+}
+
+static void
+_move_gap(GapBuffer gb, gsize pos)
+{
+    if (pos < gb->gap_start) {
+        gsize len = gb->gap_start - pos;
+        memmove(gb->buf + gb->gap_end - len, gb->buf + pos, len);
+        gb->gap_start -= len;
+        gb->gap_end -= len;
+    } else if (pos > gb->gap_start) {
+        gsize len = pos - gb->gap_start;
+        memmove(gb->buf + gb->gap_start, gb->buf + gb->gap_end, len);
+        gb->gap_start += len;
+        gb->gap_end += len;
+    }
+}
+
+// make room for len bytes at the gap, keeping at least one byte spare
+static void
+_reserve(GapBuffer gb, gsize len)
+{
+    if (_gap(gb) > len) {
+        return;
+    }
+
+    gsize tail = gb->size - gb->gap_end;
+    gsize size = gb->size * 2;
+    if (size < gb->size + len + GAP_MIN) {
+        size = gb->size + len + GAP_MIN;
+    }
+
+    gb->buf = realloc(gb->buf, size);
+    memmove(gb->buf + size - tail, gb->buf + gb->gap_end, tail);
+    gb->gap_end = size - tail;
+    gb->size = size;
+}
+
+// move the cursor back a character without updating its column
+static gunichar
+_step_left(GapBuffer gb)
+{
+    gunichar ch = gap_buffer_before(gb);
+    gchar bytes[6];
+    gb->point -= g_unichar_to_utf8(ch, bytes);
+    gb->point_chars--;
+    if (ch == '\n') {
+        gb->point_line--;
+    }
+
+    return ch;
+}
+
+// move the cursor forward a character without updating its column
+static gunichar
+_step_right(GapBuffer gb)
+{
+    const gchar *curr = _at(gb, gb->point);
+    gunichar ch = g_utf8_get_char(curr);
+    gb->point += g_utf8_next_char(curr) - curr;
+    gb->point_chars++;
+    if (ch == '\n') {
+        gb->point_line++;
+    }
+
+    return ch;
+}
+
+// work out the column after the cursor moved onto a different line, only
+// scans back as far as the start of that line
+static void
+_update_column(GapBuffer gb)
+{
+    gsize point = gb->point;
+    gap_buffer_home(gb);
+    while (gb->point < point) {
+        gb->column += gap_buffer_char_width(_step_right(gb));
+    }
+}
+
+static void
+_forward_to_column(GapBuffer gb, int column)
+{
+    gunichar ch = gap_buffer_after(gb);
+    while ((ch != 0) && (ch != '\n')
+            && (gb->column + gap_buffer_char_width(ch) <= column)) {
+        gap_buffer_right(gb);
+        ch = gap_buffer_after(gb);
+    }
+}
+
+// remember the earliest edit for gap_buffer_take_changed
+static void
+_changed(GapBuffer gb, gsize pos)
+{
+    if (!gb->changed || (pos < gb->changed_from)) {
+        gb->changed_from = pos;
+    }
+    gb->changed = TRUE;
+}
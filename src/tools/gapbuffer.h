@@ -0,0 +1,105 @@
+/*
+ * gapbuffer.h
+ *
+ * Copyright (C) 2012 - 2014 James Booth <boothj5@gmail.com>
+ *
+ * This file is part of Profanity.
+ *
+ * Profanity is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Profanity is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Profanity.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give permission to
+ * link the code of portions of this program with the OpenSSL library under
+ * certain conditions as described in each individual source file, and
+ * distribute linked combinations including the two.
+ *
+ * You must obey the GNU General Public License in all respects for all of the
+ * code used other than OpenSSL. If you modify file(s) with this exception, you
+ * may extend this exception to your version of the file(s), but you are not
+ * obligated to do so. If you do not wish to do so, delete this exception
+ * statement from your version. If you delete this exception statement from all
+ * source files in the program, then also delete it here.
+ *
+ */
+
+
+#ifndef GAPBUFFER_H
+#define GAPBUFFER_H
+
+#include <glib.h>
+
+typedef struct gap_buffer_t *GapBuffer;
+
+// allocate a new empty buffer
+GapBuffer gap_buffer_new(void);
+void gap_buffer_free(GapBuffer gb);
+
+// remove all text
+void gap_buffer_clear(GapBuffer gb);
+
+// replace all text, leaving the cursor at the end
+void gap_buffer_set(GapBuffer gb, const char * const text);
+
+// insert UTF-8 text at the cursor, leaving the cursor after it
+void gap_buffer_insert(GapBuffer gb, const char * const text, gsize len);
+
+// delete the character before or after the cursor, FALSE if there was none
+gboolean gap_buffer_delete_before(GapBuffer gb);
+gboolean gap_buffer_delete_after(GapBuffer gb);
+
+// move the cursor by one character, FALSE if already at the start or end
+gboolean gap_buffer_left(GapBuffer gb);
+gboolean gap_buffer_right(GapBuffer gb);
+
+// move the cursor to the same column on the previous or next line, FALSE if
+// there is no such line
+gboolean gap_buffer_up(GapBuffer gb);
+gboolean gap_buffer_down(GapBuffer gb);
+
+// move the cursor to the start or end of its line
+void gap_buffer_home(GapBuffer gb);
+void gap_buffer_end(GapBuffer gb);
+
+// the character before or after the cursor, 0 if there is none
+gunichar gap_buffer_before(GapBuffer gb);
+gunichar gap_buffer_after(GapBuffer gb);
+
+gboolean gap_buffer_starts_with(GapBuffer gb, const char * const prefix);
+
+// length in bytes and characters
+gsize gap_buffer_bytes(GapBuffer gb);
+glong gap_buffer_length(GapBuffer gb);
+
+// characters before the cursor, lines before the cursor and the display
+// column of the cursor in its line
+glong gap_buffer_cursor(GapBuffer gb);
+glong gap_buffer_line(GapBuffer gb);
+int gap_buffer_column(GapBuffer gb);
+
+// cursor as a byte offset into the text
+gsize gap_buffer_point(GapBuffer gb);
+
+// the text from byte pos up to the gap or the end, without moving the gap
+const char * gap_buffer_at(GapBuffer gb, gsize pos);
+
+// the first byte edited since the last call, FALSE if there were no edits
+gboolean gap_buffer_take_changed(GapBuffer gb, gsize *from);
+
+// the text as a nul terminated string, valid until the buffer is changed,
+// moves the gap to the end
+const char * gap_buffer_text(GapBuffer gb);
+
+// number of terminal columns a character takes
+int gap_buffer_char_width(gunichar ch);
+
+#endif
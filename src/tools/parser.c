@@ -39,6 +39,9 @@
 
 #include "common.h"
 
+static gchar ** _parse(const char * const inp, int min, int max,
+    gboolean with_freetext, gboolean *result);
+
 /*
  * Take a full line of input and return an array of strings representing
  * the arguments of a command.
@@ -64,109 +67,7 @@
 gchar **
 parse_args(const char * const inp, int min, int max, gboolean *result)
 {
-    if (inp == NULL) {
-        *result = FALSE;
-        return NULL;
-    }
-
-    // copy and strip input of leading/trailing whitepsace
-    char *copy = strdup(inp);
-    g_strstrip(copy);
-
-    int inp_size = g_utf8_strlen(copy, -1);
-    gboolean in_token = FALSE;
-    gboolean in_quotes = FALSE;
-    char *token_start = &copy[0];
-    int token_size = 0;
-    GSList *tokens = NULL;
-
-    // add tokens to GSList
-    int i;
-    for (i = 0; i < inp_size; i++) {
-        gchar *curr_ch = g_utf8_offset_to_pointer(copy, i);
-        gunichar curr_uni = g_utf8_get_char(curr_ch);
-
-        if (!in_token) {
-            if (curr_uni  == ' ') {
-                continue;
-            } else {
-                in_token = TRUE;
-                if (curr_uni == '"') {
-                    in_quotes = TRUE;
-                    i++;
-                    gchar *next_ch = g_utf8_next_char(curr_ch);
-                    gunichar next_uni = g_utf8_get_char(next_ch);
-                    token_start = next_ch;
-                    token_size += g_unichar_to_utf8(next_uni, NULL);
-                } else {
-                    token_start = curr_ch;
-                    token_size += g_unichar_to_utf8(curr_uni, NULL);
-                }
-            }
-        } else {
-            if (in_quotes) {
-                if (curr_uni == '"') {
-                    tokens = g_slist_append(tokens, g_strndup(token_start,
-                        token_size));
-                    token_size = 0;
-                    in_token = FALSE;
-                    in_quotes = FALSE;
-                } else {
-                    token_size += g_unichar_to_utf8(curr_uni, NULL);
-                }
-            } else {
-                if (curr_uni == ' ') {
-                    tokens = g_slist_append(tokens, g_strndup(token_start,
-                        token_size));
-                    token_size = 0;
-                    in_token = FALSE;
-                } else {
-                    token_size += g_unichar_to_utf8(curr_uni, NULL);
-                }
-            }
-        }
-    }
-
-    if (in_token) {
-        tokens = g_slist_append(tokens, g_strndup(token_start, token_size));
-    }
-
-    int num = g_slist_length(tokens) - 1;
-
-    // if num args not valid return NULL
-    if ((num < min) || (num > max)) {
-        g_slist_free_full(tokens, free);
-        g_free(copy);
-        *result = FALSE;
-        return NULL;
-
-    // if min allowed is 0 and 0 found, return empty char* array
-    } else if (min == 0 && num == 0) {
-        g_slist_free_full(tokens, free);
-        gchar **args = malloc((num + 1) * sizeof(*args));
-        args[0] = NULL;
-        g_free(copy);
-        *result = TRUE;
-        return args;
-
-    // otherwise return args array
-    } else {
-        gchar **args = malloc((num + 1) * sizeof(*args));
-        GSList *token = tokens;
-        token = g_slist_next(token);
-        int arg_count = 0;
-
-        while (token != NULL) {
-            args[arg_count++] = strdup(token->data);
-            token = g_slist_next(token);
-        }
-
-        args[arg_count] = NULL;
-        g_slist_free_full(tokens, free);
-        g_free(copy);
-        *result = TRUE;
-        return args;
-    }
+    return _parse(inp, min, max, FALSE, result);
 }
 
 /*
@@ -197,6 +98,19 @@ parse_args(const char * const inp, int min, int max, gboolean *result)
  */
 gchar **
 parse_args_with_freetext(const char * const inp, int min, int max, gboolean *result)
+{
+    return _parse(inp, min, max, TRUE, result);
+}
+
+/*
+ * Split the input into tokens in a single pass over its bytes, spaces and
+ * quotes are ASCII so never part of a multibyte character. The arguments
+ * are written to an array sized for max arguments, parsing stops as soon
+ * as there are too many.
+ */
+static gchar **
+_parse(const char * const inp, int min, int max, gboolean with_freetext,
+    gboolean *result)
 {
     if (inp == NULL) {
         *result = FALSE;
@@ -207,112 +121,76 @@ parse_args_with_freetext(const char * const inp, int min, int max, gboolean *res
     char *copy = strdup(inp);
     g_strstrip(copy);
 
-    int inp_size = g_utf8_strlen(copy, -1);
-    gboolean in_token = FALSE;
-    gboolean in_freetext = FALSE;
-    gboolean in_quotes = FALSE;
-    char *token_start = &copy[0];
-    int token_size = 0;
+    gchar **args = malloc((max + 2) * sizeof(*args));
     int num_tokens = 0;
-    GSList *tokens = NULL;
+    const char *curr = copy;
 
-    // add tokens to GSList
-    int i;
-    for (i = 0; i < inp_size; i++) {
-        gchar *curr_ch = g_utf8_offset_to_pointer(copy, i);
-        gunichar curr_uni = g_utf8_get_char(curr_ch);
+    while (*curr != '\0') {
+        if (*curr == ' ') {
+            curr++;
+            continue;
+        }
 
-        if (!in_token) {
-            if (curr_uni == ' ') {
-                continue;
-            } else {
-                in_token = TRUE;
-                num_tokens++;
-                if ((num_tokens == max + 1) && (curr_uni != '"')) {
-                    in_freetext = TRUE;
-                } else if (curr_uni == '"') {
-                    in_quotes = TRUE;
-                    i++;
-                    gchar *next_ch = g_utf8_next_char(curr_ch);
-                    gunichar next_uni = g_utf8_get_char(next_ch);
-                    token_start = next_ch;
-                    token_size += g_unichar_to_utf8(next_uni, NULL);
-                }
-                if (curr_uni == '"') {
-                    gchar *next_ch = g_utf8_next_char(curr_ch);
-                    token_start = next_ch;
-                } else {
-                    token_start = curr_ch;
-                    token_size += g_unichar_to_utf8(curr_uni, NULL);
-                }
+        // the command counts as the first token
+        num_tokens++;
+        if (num_tokens > max + 1) {
+            break;
+        }
+
+        const char *token_start;
+        size_t token_size;
+
+        if (*curr == '"') {
+            // the character after the opening quote always starts the token
+            curr++;
+            token_start = curr;
+            if (*curr != '\0') {
+                curr = g_utf8_next_char(curr);
+            }
+            while ((*curr != '\0') && (*curr != '"')) {
+                curr++;
             }
+            token_size = curr - token_start;
+            if (*curr == '"') {
+                curr++;
+            }
+        } else if (with_freetext && (num_tokens == max + 1)) {
+            token_start = curr;
+            token_size = strlen(curr);
+            curr += token_size;
         } else {
-            if (in_quotes) {
-                if (curr_uni == '"') {
-                    tokens = g_slist_append(tokens, g_strndup(token_start,
-                        token_size));
-                    token_size = 0;
-                    in_token = FALSE;
-                    in_quotes = FALSE;
-                } else {
-                    if (curr_uni != '"') {
-                        token_size += g_unichar_to_utf8(curr_uni, NULL);
-                    }
-                }
-            } else {
-                if (in_freetext) {
-                    token_size += g_unichar_to_utf8(curr_uni, NULL);
-                } else if (curr_uni == ' ') {
-                    tokens = g_slist_append(tokens, g_strndup(token_start,
-                        token_size));
-                    token_size = 0;
-                    in_token = FALSE;
-                } else if (curr_uni != '"') {
-                    token_size += g_unichar_to_utf8(curr_uni, NULL);
+            // quotes within freetext arguments are not counted in the size,
+            // which shortens the token rather than removing them
+            int quotes = 0;
+            token_start = curr;
+            while ((*curr != '\0') && (*curr != ' ')) {
+                if (with_freetext && (*curr == '"')) {
+                    quotes++;
                 }
+                curr++;
             }
+            token_size = (curr - token_start) - quotes;
         }
-    }
 
-    if (in_token) {
-        tokens = g_slist_append(tokens, g_strndup(token_start, token_size));
+        if (num_tokens > 1) {
+            args[num_tokens - 2] = g_strndup(token_start, token_size);
+        }
     }
 
     free(copy);
 
-    int num = g_slist_length(tokens) - 1;
+    int num = num_tokens - 1;
+    args[CLAMP(num, 0, max)] = NULL;
 
     // if num args not valid return NULL
     if ((num < min) || (num > max)) {
-        g_slist_free_full(tokens, free);
+        g_strfreev(args);
         *result = FALSE;
         return NULL;
-
-    // if min allowed is 0 and 0 found, return empty char* array
-    } else if (min == 0 && num == 0) {
-        g_slist_free_full(tokens, free);
-        gchar **args = malloc((num + 1) * sizeof(*args));
-        args[0] = NULL;
-        *result = TRUE;
-        return args;
-
-    // otherwise return args array
-    } else {
-        gchar **args = malloc((num + 1) * sizeof(*args));
-        GSList *token = tokens;
-        token = g_slist_next(token);
-        int arg_count = 0;
-
-        while (token != NULL) {
-            args[arg_count++] = strdup(token->data);
-            token = g_slist_next(token);
-        }
-
-        args[arg_count] = NULL;
-        g_slist_free_full(tokens, free);
-        *result = TRUE;
-        return args;
     }
+
+    *result = TRUE;
+    return args;
 }
 
 int
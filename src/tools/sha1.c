@@ -0,0 +1,99 @@
+/*
+ * sha1.c
+ *
+ * Copyright (C) 2012 - 2014 James Booth <boothj5@gmail.com>
+ *
+ * This file is part of Profanity.
+ *
+ * Profanity is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Profanity is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Profanity.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give permission to
+ * link the code of portions of this program with the OpenSSL library under
+ * certain conditions as described in each individual source file, and
+ * distribute linked combinations including the two.
+ *
+ * You must obey the GNU General Public License in all respects for all of the
+ * code used other than OpenSSL. If you modify file(s) with this exception, you
+ * may extend this exception to your version of the file(s), but you are not
+ * obligated to do so. If you do not wish to do so, delete this exception
+ * statement from your version. If you delete this exception statement from all
+ * source files in the program, then also delete it here.
+ *
+ */
+
+#include "config.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_OPENSSL_SHA_H
+#include <openssl/sha.h>
+#endif
+
+#include "tools/p_sha1.h"
+#include "tools/sha1.h"
+
+void
+sha1_digest_portable(const void * const data, size_t len,
+    unsigned char digest[SHA1_DIGEST_SIZE])
+{
+    // the transform scribbles over the blocks it is given
+    uint8_t *input = malloc(len + 1);
+    memcpy(input, data, len);
+
+    P_SHA1_CTX ctx;
+    P_SHA1_Init(&ctx);
+    P_SHA1_Update(&ctx, input, len);
+    P_SHA1_Final(&ctx, digest);
+
+    free(input);
+}
+
+// the low level calls skip the algorithm lookup EVP does on every digest,
+// which costs more than hashing a typical disco#info string
+#if defined(HAVE_OPENSSL_SHA_H) && !defined(OPENSSL_NO_SHA1)
+
+void
+sha1_digest(const void * const data, size_t len,
+    unsigned char digest[SHA1_DIGEST_SIZE])
+{
+    SHA_CTX ctx;
+    SHA1_Init(&ctx);
+    SHA1_Update(&ctx, data, len);
+    SHA1_Final(digest, &ctx);
+}
+
+const char *
+sha1_backend(void)
+{
+    return "libcrypto";
+}
+
+#else
+
+void
+sha1_digest(const void * const data, size_t len,
+    unsigned char digest[SHA1_DIGEST_SIZE])
+{
+    sha1_digest_portable(data, len, digest);
+}
+
+const char *
+sha1_backend(void)
+{
+    return "portable";
+}
+
+#endif
@@ -0,0 +1,54 @@
+/*
+ * sha1.h
+ *
+ * Copyright (C) 2012 - 2014 James Booth <boothj5@gmail.com>
+ *
+ * This file is part of Profanity.
+ *
+ * Profanity is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Profanity is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Profanity.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give permission to
+ * link the code of portions of this program with the OpenSSL library under
+ * certain conditions as described in each individual source file, and
+ * distribute linked combinations including the two.
+ *
+ * You must obey the GNU General Public License in all respects for all of the
+ * code used other than OpenSSL. If you modify file(s) with this exception, you
+ * may extend this exception to your version of the file(s), but you are not
+ * obligated to do so. If you do not wish to do so, delete this exception
+ * statement from your version. If you delete this exception statement from all
+ * source files in the program, then also delete it here.
+ *
+ */
+
+#ifndef SHA1_H
+#define SHA1_H
+
+#include <stddef.h>
+
+#define SHA1_DIGEST_SIZE 20
+
+// hash len bytes of data, using libcrypto when profanity was built with it,
+// which picks SHA-NI or ARMv8 crypto instructions when the CPU has them
+void sha1_digest(const void * const data, size_t len,
+    unsigned char digest[SHA1_DIGEST_SIZE]);
+
+// hash with the bundled implementation, whatever profanity was built with
+void sha1_digest_portable(const void * const data, size_t len,
+    unsigned char digest[SHA1_DIGEST_SIZE]);
+
+// name of the implementation sha1_digest uses
+const char * sha1_backend(void);
+
+#endif
@@ -49,75 +49,101 @@
 #include "ui/window.h"
 #include "ui/buffer.h"
 
-#define BUFF_SIZE 1200
-
+// entries are kept in a circular array, once full the oldest entry is
+// overwritten, each entry and its strings are a single allocation
 struct prof_buff_t {
-    GSList *entries;
+    ProfBuffEntry **entries;
+    int capacity;
+    int start;
+    int size;
+    int pushed;
 };
 
-static void _free_entry(ProfBuffEntry *entry);
-
 ProfBuff
-buffer_create()
+buffer_create(int capacity)
 {
+    assert(capacity > 0);
+
     ProfBuff new_buff = malloc(sizeof(struct prof_buff_t));
-    new_buff->entries = NULL;
+    new_buff->entries = calloc(capacity, sizeof(ProfBuffEntry *));
+    new_buff->capacity = capacity;
+    new_buff->start = 0;
+    new_buff->size = 0;
+    new_buff->pushed = 0;
     return new_buff;
 }
 
 int
 buffer_size(ProfBuff buffer)
 {
-    return g_slist_length(buffer->entries);
+    return buffer->size;
+}
+
+/*
+ * Entries pushed since the buffer was created, including those dropped
+ * since. Entry i of the buffer was pushed at buffer_pushed - size + i.
+ */
+int
+buffer_pushed(ProfBuff buffer)
+{
+    return buffer->pushed;
 }
 
 void
 buffer_free(ProfBuff buffer)
 {
-    g_slist_free_full(buffer->entries, (GDestroyNotify)_free_entry);
+    int i;
+    for (i = 0; i < buffer->size; i++) {
+        free(buffer_yield_entry(buffer, i));
+    }
+    free(buffer->entries);
     free(buffer);
-    buffer = NULL;
 }
 
 void
 buffer_push(ProfBuff buffer, const char show_char, const char * const date_fmt,
     int flags, int attrs, const char * const from, const char * const message)
 {
-    ProfBuffEntry *e = malloc(sizeof(struct prof_buff_entry_t));
+    size_t date_fmt_len = strlen(date_fmt) + 1;
+    size_t from_len = strlen(from) + 1;
+    size_t message_len = strlen(message) + 1;
+
+    ProfBuffEntry *e = malloc(sizeof(struct prof_buff_entry_t) + date_fmt_len +
+        from_len + message_len);
     e->show_char = show_char;
     e->flags = flags;
     e->attrs = attrs;
-
-    e->date_fmt = malloc(strlen(date_fmt)+1);
-    strcpy(e->date_fmt, date_fmt);
-
-    e->from = malloc(strlen(from)+1);
-    strcpy(e->from, from);
-
-    e->message = malloc(strlen(message)+1);
-    strcpy(e->message, message);
-
-    if (g_slist_length(buffer->entries) == BUFF_SIZE) {
-        _free_entry(buffer->entries->data);
-        buffer->entries = g_slist_delete_link(buffer->entries, buffer->entries);
+    e->layout_width = 0;
+    e->layout_col = 0;
+    e->rows = 0;
+    e->end_col = 0;
+
+    e->date_fmt = (char *)(e + 1);
+    memcpy(e->date_fmt, date_fmt, date_fmt_len);
+
+    e->from = e->date_fmt + date_fmt_len;
+    memcpy(e->from, from, from_len);
+
+    e->message = e->from + from_len;
+    memcpy(e->message, message, message_len);
+
+    buffer->pushed++;
+
+    // full, replace the oldest entry
+    if (buffer->size == buffer->capacity) {
+        free(buffer->entries[buffer->start]);
+        buffer->entries[buffer->start] = e;
+        buffer->start = (buffer->start + 1) % buffer->capacity;
+    } else {
+        buffer->entries[(buffer->start + buffer->size) % buffer->capacity] = e;
+        buffer->size++;
     }
-
-    buffer->entries = g_slist_append(buffer->entries, e);
 }
 
 ProfBuffEntry*
 buffer_yield_entry(ProfBuff buffer, int entry)
 {
-    GSList *node = g_slist_nth(buffer->entries, entry);
-    return node->data;
-}
+    assert(entry >= 0 && entry < buffer->size);
 
-static void
-_free_entry(ProfBuffEntry *entry)
-{
-    free(entry->message);
-    free(entry->from);
-    free(entry->date_fmt);
-    free(entry);
+    return buffer->entries[(buffer->start + entry) % buffer->capacity];
 }
-
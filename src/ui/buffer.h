@@ -44,13 +44,23 @@ typedef struct prof_buff_entry_t {
     int attrs;
     char *from;
     char *message;
+
+    // wrapped layout, valid for the width and start column it was made for
+    int layout_width;
+    int layout_col;
+    int rows;
+    int end_col;
 } ProfBuffEntry;
 
+// entries kept for window types without a buffer preference
+#define BUFF_SIZE_DEFAULT 500
+
 typedef struct prof_buff_t *ProfBuff;
 
-ProfBuff buffer_create();
+ProfBuff buffer_create(int capacity);
 void buffer_free(ProfBuff buffer);
 void buffer_push(ProfBuff buffer, const char show_char, const char * const date_fmt, int flags, int attrs, const char * const from, const char * const message);
 int buffer_size(ProfBuff buffer);
+int buffer_pushed(ProfBuff buffer);
 ProfBuffEntry* buffer_yield_entry(ProfBuff buffer, int entry);
 #endif
@@ -157,8 +157,6 @@ static void
 _cons_about(void)
 {
     ProfWin *console = wins_get_console();
-    int rows, cols;
-    getmaxyx(stdscr, rows, cols);
 
     if (prefs_get_boolean(PREF_SPLASH)) {
         _cons_splash_logo();
@@ -188,8 +186,6 @@ _cons_about(void)
         cons_check_version(FALSE);
     }
 
-    pnoutrefresh(console->win, 0, 0, 1, 0, rows-3, cols-1);
-
     cons_alert();
 }
 
@@ -334,15 +330,14 @@ _cons_show_caps(const char * const fulljid, Resource *resource)
             win_save_newline(console);
         }
 
-        if (caps->features != NULL) {
+        if (caps->num_features > 0) {
             win_save_println(console, "Features:");
-            GSList *feature = caps->features;
-            while (feature != NULL) {
-                win_save_vprint(console, '-', NULL, 0, 0, "", " %s", feature->data);
-                feature = g_slist_next(feature);
+            guint i;
+            for (i = 0; i < caps->num_features; i++) {
+                win_save_vprint(console, '-', NULL, 0, 0, "", " %s", caps->features[i]);
             }
         }
-        caps_destroy(caps);
+        caps_unref(caps);
 
     } else {
         cons_show("No capabilities found for %s", fulljid);
@@ -778,7 +773,7 @@ _cons_show_account(ProfAccount *account)
                 if ((caps->os != NULL) || (caps->os_version != NULL)) {
                     win_save_newline(console);
                 }
-                caps_destroy(caps);
+                caps_unref(caps);
             }
 
             ordered_resources = g_list_next(ordered_resources);
@@ -903,6 +898,17 @@ _cons_titlebar_setting(void)
     }
 }
 
+static void
+_cons_fps_setting(void)
+{
+    gint fps = prefs_get_max_fps();
+    if (fps == 0) {
+        cons_show("Frame rate limit (/fps)       : OFF");
+    } else {
+        cons_show("Frame rate limit (/fps)       : %d per second", fps);
+    }
+}
+
 static void
 _cons_show_ui_prefs(void)
 {
@@ -916,6 +922,7 @@ _cons_show_ui_prefs(void)
     cons_mouse_setting();
     cons_statuses_setting();
     cons_titlebar_setting();
+    cons_fps_setting();
 
     cons_alert();
 }
@@ -1076,6 +1083,15 @@ _cons_log_setting(void)
         cons_show("Shared log (/log shared)    : ON");
     else
         cons_show("Shared log (/log shared)    : OFF");
+
+    char *flush_value = prefs_get_string(PREF_LOG_FLUSH);
+    cons_show("Chat log flush (/log flush) : %s", flush_value);
+    prefs_free_string(flush_value);
+
+    if (prefs_get_boolean(PREF_LOG_ASYNC))
+        cons_show("Async log (/log async)      : ON");
+    else
+        cons_show("Async log (/log async)      : OFF");
 }
 
 static void
@@ -1293,10 +1309,11 @@ _cons_navigation_help(void)
     cons_show("Alt-2..Alt-0 (F2..F10)   : Chat windows.");
     cons_show("Alt-LEFT                 : Previous chat window");
     cons_show("Alt-RIGHT                : Next chat window");
-    cons_show("UP, DOWN                 : Navigate input history.");
+    cons_show("UP, DOWN                 : Navigate input lines and history.");
     cons_show("LEFT, RIGHT, HOME, END   : Edit current input.");
     cons_show("CTRL-LEFT, CTRL-RIGHT    : Jump word in input.");
     cons_show("ESC                      : Clear current input.");
+    cons_show("Alt-ENTER                : New line in current input.");
     cons_show("TAB                      : Autocomplete.");
     cons_show("PAGE UP, PAGE DOWN       : Page the main window.");
     cons_show("");
@@ -1515,6 +1532,7 @@ console_init_module(void)
     cons_mouse_setting = _cons_mouse_setting;
     cons_statuses_setting = _cons_statuses_setting;
     cons_titlebar_setting = _cons_titlebar_setting;
+    cons_fps_setting = _cons_fps_setting;
     cons_show_ui_prefs = _cons_show_ui_prefs;
     cons_notify_setting = _cons_notify_setting;
     cons_show_desktop_prefs = _cons_show_desktop_prefs;
@@ -79,10 +79,16 @@ static Display *display;
 
 static GTimer *ui_idle_time;
 
+// the window and position last copied to the screen
+static ProfWin *drawn_win = NULL;
+static int drawn_y_pos;
+static int drawn_inp_height = 1;
+
 static void _win_handle_switch(const wint_t * const ch);
 static void _win_handle_page(const wint_t * const ch);
 static void _win_show_history(WINDOW *win, int win_index,
     const char * const contact);
+static GSList * _win_scrollback_older(ProfWin *window);
 static void _ui_draw_term_title(void);
 
 static void
@@ -108,27 +114,61 @@ _ui_init(void)
     display = XOpenDisplay(0);
 #endif
     ui_idle_time = g_timer_new();
-    ProfWin *window = wins_get_current();
-    win_update_virtual(window);
+    drawn_win = NULL;
 }
 
+/*
+ * Copy the parts of the UI that have changed to the screen, does nothing
+ * when nothing has changed
+ */
 static void
 _ui_update(void)
 {
+    gboolean changed = FALSE;
+
+    // the input goes first, its height decides the space left for the window
+    if (inp_changed()) {
+        changed = TRUE;
+    }
+    if (inp_win_height() != drawn_inp_height) {
+        drawn_inp_height = inp_win_height();
+        status_bar_resize();
+        drawn_win = NULL;
+    }
+
     ProfWin *current = wins_get_current();
+    win_print_pending(current);
     if (current->paged == 0) {
         win_move_to_end(current);
     }
 
-    win_update_virtual(current);
+    if ((current != drawn_win) || (current->y_pos != drawn_y_pos) ||
+            is_wintouched(current->win)) {
+        win_update_virtual(current);
+        drawn_win = current;
+        drawn_y_pos = current->y_pos;
+        changed = TRUE;
+    }
+
+    if (title_bar_update_virtual()) {
+        changed = TRUE;
+    }
+    if (status_bar_update_virtual()) {
+        changed = TRUE;
+    }
+
+    if (!changed) {
+        return;
+    }
 
     if (prefs_get_boolean(PREF_TITLEBAR)) {
         _ui_draw_term_title();
     }
-    title_bar_update_virtual();
-    status_bar_update_virtual();
+
+    // leave the cursor in the input window
     inp_put_back();
     doupdate();
+    inp_enable_paste();
 }
 
 static void
@@ -171,19 +211,26 @@ _ui_close(void)
 {
     notifier_uninit();
     wins_destroy();
+    inp_close();
     endwin();
 }
 
 static wint_t
-_ui_get_char(char *input, int *size)
+_ui_get_char(void)
 {
-    wint_t ch = inp_get_char(input, size);
+    wint_t ch = inp_get_char();
     if (ch != ERR) {
         ui_reset_idle_time();
     }
     return ch;
 }
 
+static char *
+_ui_get_line(void)
+{
+    return inp_get_line();
+}
+
 static void
 _ui_input_clear(void)
 {
@@ -203,7 +250,7 @@ _ui_input_nonblocking(void)
 }
 
 static void
-_ui_resize(const int ch, const char * const input, const int size)
+_ui_resize(const int ch)
 {
     log_info("Resizing UI");
     erase();
@@ -211,9 +258,8 @@ _ui_resize(const int ch, const char * const input, const int size)
     title_bar_resize();
     wins_resize_all();
     status_bar_resize();
-    inp_win_resize(input, size);
-    ProfWin *window = wins_get_current();
-    win_update_virtual(window);
+    inp_win_resize();
+    drawn_win = NULL;
 }
 
 static void
@@ -311,6 +357,12 @@ _ui_get_recipients(void)
     return recipients;
 }
 
+static gboolean
+_ui_has_recipients(void)
+{
+    return wins_has_chat_recipients();
+}
+
 static void
 _ui_incoming_msg(const char * const from, const char * const message,
     GTimeVal *tv_stamp, gboolean priv)
@@ -484,7 +536,6 @@ _ui_handle_login_account_success(ProfAccount *account)
     cons_show_login_success(account);
     title_bar_set_presence(contact_presence);
     status_bar_print_message(account->jid);
-    status_bar_update_virtual();
 }
 
 static void
@@ -581,17 +632,15 @@ _ui_disconnected(void)
     wins_lost_connection();
     title_bar_set_presence(CONTACT_OFFLINE);
     status_bar_clear_message();
-    status_bar_update_virtual();
 }
 
 static void
-_ui_handle_special_keys(const wint_t * const ch, const char * const inp,
-    const int size)
+_ui_handle_special_keys(const wint_t * const ch)
 {
     _win_handle_switch(ch);
     _win_handle_page(ch);
     if (*ch == KEY_RESIZE) {
-        ui_resize(*ch, inp, size);
+        ui_resize(*ch);
     }
 }
 
@@ -1312,6 +1361,34 @@ _ui_duck_result(const char * const result)
     }
 }
 
+static void
+_ui_search_results(const char * const query, GSList *results)
+{
+    ProfWin *window = wins_get_by_recipient("Log search");
+    if (window == NULL) {
+        window = wins_new("Log search", WIN_SEARCH);
+        win_save_println(window, "Type a query to search again.");
+    }
+    ui_switch_win(wins_get_num(window));
+
+    win_save_println(window, "");
+    win_save_print(window, '-', NULL, NO_EOL, COLOUR_ME, "", "Query  : ");
+    win_save_print(window, '-', NULL, NO_DATE, 0, "", query);
+
+    GSList *curr = results;
+    while (curr != NULL) {
+        win_save_print(window, '-', NULL, NO_DATE, 0, "", curr->data);
+        curr = g_slist_next(curr);
+    }
+
+    if (results == NULL) {
+        win_save_println(window, "No results found.");
+    } else {
+        win_save_vprint(window, '-', NULL, 0, 0, "", "%d results.",
+            g_slist_length(results));
+    }
+}
+
 static void
 _ui_outgoing_msg(const char * const from, const char * const to,
     const char * const message)
@@ -1368,6 +1445,9 @@ _ui_room_join(const char * const room, gboolean focus)
     // create new window
     if (window == NULL) {
         window = wins_new(room, WIN_MUC);
+        Jid *jid = jid_create(jabber_get_fulljid());
+        window->log_start = chat_log_get_end(jid->barejid, room, TRUE);
+        jid_destroy(jid);
     }
 
     num = wins_get_num(window);
@@ -1572,7 +1652,7 @@ _ui_room_message(const char * const room_jid, const char * const nick,
             }
 
             gboolean notify = FALSE;
-            char *room_setting = prefs_get_string(PREF_NOTIFY_ROOM);
+            const char *room_setting = prefs_get_string_value(PREF_NOTIFY_ROOM);
             if (g_strcmp0(room_setting, "on") == 0) {
                 notify = TRUE;
             }
@@ -1585,7 +1665,6 @@ _ui_room_message(const char * const room_jid, const char * const nick,
                 g_free(message_lower);
                 g_free(nick_lower);
             }
-            prefs_free_string(room_setting);
 
             if (notify) {
                 gboolean is_current = wins_is_current(window);
@@ -1807,7 +1886,7 @@ _ui_ask_password(void)
 {
   char *passwd = malloc(sizeof(char) * (MAX_PASSWORD_SIZE + 1));
   status_bar_get_password();
-  status_bar_update_virtual();
+  _ui_update();
   inp_block();
   inp_get_password(passwd);
   inp_non_block();
@@ -2303,10 +2382,11 @@ static void
 _win_handle_page(const wint_t * const ch)
 {
     ProfWin *current = wins_get_current();
+    win_print_pending(current);
     int rows = getmaxy(stdscr);
     int y = getcury(current->win);
 
-    int page_space = rows - 4;
+    int page_space = rows - 3 - inp_win_height();
     int *page_start = &(current->y_pos);
 
     if (prefs_get_boolean(PREF_MOUSE)) {
@@ -2331,7 +2411,6 @@ _win_handle_page(const wint_t * const ch)
                         *page_start = y - page_space;
 
                     current->paged = 1;
-                    win_update_virtual(current);
                 } else if (mouse_event.bstate & BUTTON4_PRESSED) { // mouse wheel up
                     *page_start -= 4;
 
@@ -2340,7 +2419,6 @@ _win_handle_page(const wint_t * const ch)
                         *page_start = 0;
 
                     current->paged = 1;
-                    win_update_virtual(current);
                 }
             }
         }
@@ -2348,14 +2426,34 @@ _win_handle_page(const wint_t * const ch)
 
     // page up
     if (*ch == KEY_PPAGE) {
-        *page_start -= page_space;
+        GSList *lines = NULL;
+
+        // at the top, show the end of the next older page from the logs
+        if ((*page_start == 0) && ((lines = _win_scrollback_older(current)) != NULL)) {
+            win_show_scrollback(current, lines);
+            *page_start = getcury(current->win) - page_space;
+        } else {
+            *page_start -= page_space;
+        }
 
         // went past beginning, show first page
         if (*page_start < 0)
             *page_start = 0;
 
         current->paged = 1;
-        win_update_virtual(current);
+
+    // page down past the end of a page from the logs, show the next newer
+    } else if ((*ch == KEY_NPAGE) && scrollback_showing(current->scrollback) &&
+            (*page_start >= y - page_space)) {
+        GSList *lines = scrollback_newer(current->scrollback);
+        if (scrollback_showing(current->scrollback)) {
+            win_show_scrollback(current, lines);
+        } else {
+            win_redraw(current);
+        }
+        *page_start = 0;
+        current->paged = 1;
+        return;
 
     // page down
     } else if (*ch == KEY_NPAGE) {
@@ -2370,11 +2468,10 @@ _win_handle_page(const wint_t * const ch)
             *page_start = y - page_space - 1;
 
         current->paged = 1;
-        win_update_virtual(current);
     }
 
     // switch off page if last line and space line visible
-    if ((y) - *page_start == page_space) {
+    if (!scrollback_showing(current->scrollback) && ((y) - *page_start == page_space)) {
         current->paged = 0;
     }
 }
@@ -2385,7 +2482,8 @@ _win_show_history(WINDOW *win, int win_index, const char * const contact)
     ProfWin *window = wins_get_by_num(win_index);
     if (!window->history_shown) {
         Jid *jid = jid_create(jabber_get_fulljid());
-        GSList *history = chat_log_get_previous(jid->barejid, contact);
+        GSList *history = chat_log_get_previous(jid->barejid, contact,
+            prefs_get_buffer_chat(), &window->log_start);
         jid_destroy(jid);
         GSList *curr = history;
         while (curr != NULL) {
@@ -2398,6 +2496,39 @@ _win_show_history(WINDOW *win, int win_index, const char * const contact)
     }
 }
 
+/*
+ * Move the scrollback to the next older page, starting from the oldest line
+ * in the window. When lines have scrolled off the top of the pad, start at
+ * the end of the log instead, showing some lines twice rather than skipping
+ * them.
+ */
+static GSList *
+_win_scrollback_older(ProfWin *window)
+{
+    if ((window->type != WIN_CHAT) && (window->type != WIN_MUC)) {
+        return NULL;
+    }
+    if (jabber_get_connection_status() != JABBER_CONNECTED) {
+        return NULL;
+    }
+
+    if (!scrollback_showing(window->scrollback) &&
+            ((window->scrollback == NULL) || window->trimmed)) {
+        Jid *jid = jid_create(jabber_get_fulljid());
+        gboolean room = (window->type == WIN_MUC);
+        ChatLogPos anchor = window->log_start;
+        if ((anchor.date == 0) || window->trimmed) {
+            anchor = chat_log_get_end(jid->barejid, window->from, room);
+        }
+        scrollback_free(window->scrollback);
+        window->scrollback = scrollback_create(jid->barejid, window->from,
+            room, anchor);
+        jid_destroy(jid);
+    }
+
+    return scrollback_older(window->scrollback);
+}
+
 void
 ui_init_module(void)
 {
@@ -2411,6 +2542,7 @@ ui_init_module(void)
     ui_duck_exists = _ui_duck_exists;
     ui_contact_typing = _ui_contact_typing;
     ui_get_recipients = _ui_get_recipients;
+    ui_has_recipients = _ui_has_recipients;
     ui_incoming_msg = _ui_incoming_msg;
     ui_roster_add = _ui_roster_add;
     ui_roster_remove = _ui_roster_remove;
@@ -2446,6 +2578,7 @@ ui_init_module(void)
     ui_open_duck_win = _ui_open_duck_win;
     ui_duck = _ui_duck;
     ui_duck_result = _ui_duck_result;
+    ui_search_results = _ui_search_results;
     ui_outgoing_msg = _ui_outgoing_msg;
     ui_room_join = _ui_room_join;
     ui_room_roster = _ui_room_roster;
@@ -2497,6 +2630,7 @@ ui_init_module(void)
     ui_about = _ui_about;
     ui_statusbar_new = _ui_statusbar_new;
     ui_get_char = _ui_get_char;
+    ui_get_line = _ui_get_line;
     ui_input_clear = _ui_input_clear;
     ui_input_nonblocking = _ui_input_nonblocking;
     ui_replace_input = _ui_replace_input;
@@ -35,6 +35,7 @@
 #define _XOPEN_SOURCE_EXTENDED
 #include "config.h"
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <wchar.h>
@@ -54,24 +55,54 @@
 #include "muc.h"
 #include "profanity.h"
 #include "roster_list.h"
+#include "tools/gapbuffer.h"
 #include "ui/ui.h"
 #include "ui/statusbar.h"
 #include "ui/inputwin.h"
 #include "ui/windows.h"
 #include "xmpp/xmpp.h"
 
-#define _inp_win_update_virtual() pnoutrefresh(inp_win, 0, pad_start, rows-1, 0, rows-1, cols-1)
+#define _inp_win_update_virtual() pnoutrefresh(inp_win, 0, 0, rows-height, 0, rows-1, cols-1)
+
+// key codes for the sequences around a bracketed paste
+#define KEY_PASTE_START (KEY_MAX + 1)
+#define KEY_PASTE_END (KEY_MAX + 2)
 
 static WINDOW *inp_win;
-static int pad_start = 0;
 static int rows, cols;
 
-static int _handle_edit(int result, const wint_t ch, char *input, int *size);
-static int _handle_alt_key(char *input, int *size, int key);
-static void _handle_backspace(int display_size, int inp_x, int *size, char *input);
+// text being composed, the pad only holds the rows currently shown
+static GapBuffer line;
+static int height = 1;
+static int top = 0;
+
+// input has been edited since it was last drawn
+static gboolean dirty;
+
+// the end of a bracketed paste has not been read yet
+static gboolean in_paste;
+
+// the terminal has been asked to bracket pastes
+static gboolean paste_enabled;
+
+// byte offset of the start of each wrapped row of the input. Rows are only
+// laid out as far as the cursor and the view need, and kept between draws
+// so an edit only drops those from the row before it.
+static GArray *row_starts;
+static gboolean layout_done;
+static int layout_cols;
+
+static int _handle_edit(int result, const wint_t ch);
+static int _handle_alt_key(int key);
+static void _handle_backspace(void);
 static int _printable(const wint_t ch);
 static void _clear_input(void);
-static void _go_to_end(int display_size);
+static void _inp_draw(void);
+static void _inp_layout_changed(void);
+static void _inp_layout_to(gsize pos, guint wanted);
+static guint _row_at(gsize pos);
+static wint_t _handle_paste(void);
+static void _paste_mode(const char * const sequence);
 
 void
 create_input_window(void)
@@ -82,35 +113,82 @@ create_input_window(void)
     ESCDELAY = 25;
 #endif
     getmaxyx(stdscr, rows, cols);
-    inp_win = newpad(1, INP_WIN_MAX);
+    line = gap_buffer_new();
+    row_starts = g_array_new(FALSE, FALSE, sizeof(gsize));
+    gsize first_row = 0;
+    g_array_append_val(row_starts, first_row);
+    layout_done = FALSE;
+    layout_cols = cols;
+    height = 1;
+    top = 0;
+    inp_win = newpad(height, cols);
     wbkgd(inp_win, COLOUR_INPUT_TEXT);
     keypad(inp_win, TRUE);
     wmove(inp_win, 0, 0);
     _inp_win_update_virtual();
+    dirty = TRUE;
+
+#ifdef NCURSES_EXT_FUNCS
+    // ask the terminal to mark the start and end of pasted text
+    define_key("\033[200~", KEY_PASTE_START);
+    define_key("\033[201~", KEY_PASTE_END);
+#endif
+    in_paste = FALSE;
+    paste_enabled = FALSE;
 }
 
+/*
+ * Turn on bracketed paste, must follow the first doupdate or the sequence
+ * can reach the terminal before curses has set it up
+ */
 void
-inp_win_resize(const char * const input, const int size)
+inp_enable_paste(void)
 {
-    int inp_x;
-    getmaxyx(stdscr, rows, cols);
-    inp_x = getcurx(inp_win);
+#ifdef NCURSES_EXT_FUNCS
+    if (!paste_enabled) {
+        _paste_mode("\033[?2004h");
+        paste_enabled = TRUE;
+    }
+#endif
+}
 
-    // if lost cursor off screen, move contents to show it
-    if (inp_x >= pad_start + cols) {
-        pad_start = inp_x - (cols / 2);
-        if (pad_start < 0) {
-            pad_start = 0;
-        }
+void
+inp_close(void)
+{
+    if (paste_enabled) {
+        _paste_mode("\033[?2004l");
+        paste_enabled = FALSE;
     }
+    gap_buffer_free(line);
+    line = NULL;
+    g_array_free(row_starts, TRUE);
+    row_starts = NULL;
+}
 
+void
+inp_win_resize(void)
+{
+    getmaxyx(stdscr, rows, cols);
+    wresize(inp_win, height, cols);
+    _inp_draw();
     _inp_win_update_virtual();
+    dirty = TRUE;
+}
+
+/*
+ * Rows taken by the input at the bottom of the screen, grows with the text
+ * up to a third of the screen
+ */
+int
+inp_win_height(void)
+{
+    return height;
 }
 
 void
 inp_non_block(void)
 {
-    wtimeout(inp_win, 20);
+    wtimeout(inp_win, 0);
 }
 
 void
@@ -120,31 +198,41 @@ inp_block(void)
 }
 
 wint_t
-inp_get_char(char *input, int *size)
+inp_get_char(void)
 {
     wint_t ch;
-    int display_size = 0;
-
-    if (*size != 0) {
-        display_size = g_utf8_strlen(input, *size);
-    }
 
     // echo off, and get some more input
     noecho();
+    if (in_paste) {
+        ch = _handle_paste();
+        echo();
+        return ch;
+    }
     int result = wget_wch(inp_win, &ch);
 
+    // nothing waiting to be read
+    if (result == ERR) {
+        echo();
+        return ERR;
+    }
+    dirty = TRUE;
+
+    if ((result == KEY_CODE_YES) && (ch == KEY_PASTE_START)) {
+        in_paste = TRUE;
+        ch = _handle_paste();
+        echo();
+        return ch;
+    }
+
     gboolean in_command = FALSE;
-    if ((display_size > 0 && input[0] == '/') ||
-            (display_size == 0 && ch == '/')) {
+    if ((gap_buffer_length(line) > 0 && gap_buffer_starts_with(line, "/")) ||
+            (gap_buffer_length(line) == 0 && ch == '/')) {
         in_command = TRUE;
     }
 
     if (prefs_get_boolean(PREF_STATES)) {
-        if (result == ERR) {
-            prof_handle_idle();
-        }
         if (prefs_get_boolean(PREF_OUTTYPE)
-                && (result != ERR)
                 && (result != KEY_CODE_YES)
                 && !in_command
                 && _printable(ch)) {
@@ -153,64 +241,14 @@ inp_get_char(char *input, int *size)
     }
 
     // if it wasn't an arrow key etc
-    if (!_handle_edit(result, ch, input, size)) {
+    if (!_handle_edit(result, ch)) {
         if (_printable(ch) && result != KEY_CODE_YES) {
-            if (*size >= INP_WIN_MAX) {
-                return ERR;
-            }
-
-            int inp_x = getcurx(inp_win);
+            char bytes[MB_CUR_MAX+1];
+            size_t utf_len = wcrtomb(bytes, ch, NULL);
 
-            // handle insert if not at end of input
-            if (inp_x < display_size) {
-                char bytes[MB_CUR_MAX];
-                size_t utf_len = wcrtomb(bytes, ch, NULL);
-
-                char *next_ch = g_utf8_offset_to_pointer(input, inp_x);
-                char *offset;
-                for (offset = &input[*size - 1]; offset >= next_ch; offset--) {
-                    *(offset + utf_len) = *offset;
-                }
-                int i;
-                for (i = 0; i < utf_len; i++) {
-                     *(next_ch + i) = bytes[i];
-                }
-
-                *size += utf_len;
-                input[*size] = '\0';
-                waddstr(inp_win, next_ch);
-                wmove(inp_win, 0, inp_x + 1);
-
-                if (inp_x - pad_start > cols-3) {
-                    pad_start++;
-                    _inp_win_update_virtual();
-                }
-
-            // otherwise just append
-            } else {
-                char bytes[MB_CUR_MAX+1];
-                size_t utf_len = wcrtomb(bytes, ch, NULL);
-
-                // wcrtomb can return (size_t) -1
-                if (utf_len < MB_CUR_MAX) {
-                    int i;
-                    for (i = 0 ; i < utf_len; i++) {
-                        input[(*size)++] = bytes[i];
-                    }
-                    input[*size] = '\0';
-
-                    bytes[utf_len] = '\0';
-                    waddstr(inp_win, bytes);
-                    display_size++;
-
-                    // if gone over screen size follow input
-                    int rows, cols;
-                    getmaxyx(stdscr, rows, cols);
-                    if (display_size - pad_start > cols-2) {
-                        pad_start++;
-                        _inp_win_update_virtual();
-                    }
-                }
+            // wcrtomb can return (size_t) -1
+            if (utf_len != (size_t) -1) {
+                gap_buffer_insert(line, bytes, utf_len);
             }
 
             cmd_reset_autocomplete();
@@ -222,6 +260,15 @@ inp_get_char(char *input, int *size)
     return ch;
 }
 
+/*
+ * Returns a copy of the text entered, to be freed by the caller
+ */
+char *
+inp_get_line(void)
+{
+    return strdup(gap_buffer_text(line));
+}
+
 void
 inp_get_password(char *passwd)
 {
@@ -241,25 +288,42 @@ inp_put_back(void)
     _inp_win_update_virtual();
 }
 
+/*
+ * Draws the input and returns TRUE if it has changed since this was last
+ * called
+ */
+gboolean
+inp_changed(void)
+{
+    gboolean result = dirty;
+    if (dirty) {
+        _inp_draw();
+        dirty = FALSE;
+    }
+
+    return result;
+}
+
+/*
+ * Replace the text being composed, input is the text previously taken from
+ * the input window and is not written to
+ */
 void
 inp_replace_input(char *input, const char * const new_input, int *size)
 {
-    int display_size;
-    strncpy(input, new_input, INP_WIN_MAX);
-    *size = strlen(input);
-    display_size = g_utf8_strlen(input, *size);
-    inp_win_reset();
-    input[*size] = '\0';
-    waddstr(inp_win, input);
-    _go_to_end(display_size);
+    gap_buffer_set(line, new_input);
+    *size = gap_buffer_bytes(line);
+    dirty = TRUE;
 }
 
 void
 inp_win_reset(void)
 {
+    gap_buffer_clear(line);
     _clear_input();
-    pad_start = 0;
+    top = 0;
     _inp_win_update_virtual();
+    dirty = TRUE;
 }
 
 static void
@@ -275,111 +339,34 @@ _clear_input(void)
  * return 0 if it wasn't
  */
 static int
-_handle_edit(int result, const wint_t ch, char *input, int *size)
+_handle_edit(int result, const wint_t ch)
 {
     char *prev = NULL;
     char *next = NULL;
-    int inp_x = 0;
     int next_ch;
-    int display_size = 0;
-
-    if (*size != 0) {
-        display_size = g_utf8_strlen(input, *size);
-    }
-
-    inp_x = getcurx(inp_win);
 
     // CTRL-LEFT
-    if ((result == KEY_CODE_YES) && (ch == 547 || ch == 545 || ch == 540 || ch == 539) && (inp_x > 0)) {
-        input[*size] = '\0';
-        gchar *curr_ch = g_utf8_offset_to_pointer(input, inp_x);
-        curr_ch = g_utf8_find_prev_char(input, curr_ch);
-        gchar *prev_ch;
-        gunichar curr_uni;
-        gunichar prev_uni;
-
-        while (curr_ch != NULL) {
-            curr_uni = g_utf8_get_char(curr_ch);
-
-            if (g_unichar_isspace(curr_uni)) {
-                curr_ch = g_utf8_find_prev_char(input, curr_ch);
-            } else {
-                prev_ch = g_utf8_find_prev_char(input, curr_ch);
-                if (prev_ch == NULL) {
-                    curr_ch = NULL;
-                    break;
-                } else {
-                    prev_uni = g_utf8_get_char(prev_ch);
-                    if (g_unichar_isspace(prev_uni)) {
-                        break;
-                    } else {
-                        curr_ch = prev_ch;
-                    }
-                }
-            }
-        }
-
-        if (curr_ch == NULL) {
-            inp_x = 0;
-            wmove(inp_win, 0, inp_x);
-        } else {
-            glong offset = g_utf8_pointer_to_offset(input, curr_ch);
-            inp_x = offset;
-            wmove(inp_win, 0, inp_x);
+    if ((result == KEY_CODE_YES) && (ch == 547 || ch == 545 || ch == 540 || ch == 539)) {
+        while (g_unichar_isspace(gap_buffer_before(line))) {
+            gap_buffer_left(line);
         }
-
-        // if gone off screen to left, jump left (half a screen worth)
-        if (inp_x <= pad_start) {
-            pad_start = pad_start - (cols / 2);
-            if (pad_start < 0) {
-                pad_start = 0;
-            }
-
-            _inp_win_update_virtual();
+        gunichar curr_uni = gap_buffer_before(line);
+        while ((curr_uni != 0) && !g_unichar_isspace(curr_uni)) {
+            gap_buffer_left(line);
+            curr_uni = gap_buffer_before(line);
         }
         return 1;
 
     // CTRL-RIGHT
-    } else if ((result == KEY_CODE_YES) && (ch == 562 || ch == 560 || ch == 555 || ch == 554) && (inp_x < display_size)) {
-        input[*size] = '\0';
-        gchar *curr_ch = g_utf8_offset_to_pointer(input, inp_x);
-        gchar *next_ch = g_utf8_find_next_char(curr_ch, NULL);
-        gunichar curr_uni;
-        gunichar next_uni;
-        gboolean moved = FALSE;
-
-        while (g_utf8_pointer_to_offset(input, next_ch) < display_size) {
-            curr_uni = g_utf8_get_char(curr_ch);
-            next_uni = g_utf8_get_char(next_ch);
-            curr_ch = next_ch;
-            next_ch = g_utf8_find_next_char(next_ch, NULL);
-
-            if (!g_unichar_isspace(curr_uni) && g_unichar_isspace(next_uni) && moved) {
-                break;
-            } else {
-                moved = TRUE;
-            }
+    } else if ((result == KEY_CODE_YES) && (ch == 562 || ch == 560 || ch == 555 || ch == 554)) {
+        while (g_unichar_isspace(gap_buffer_after(line))) {
+            gap_buffer_right(line);
         }
-
-        if (next_ch == NULL) {
-            inp_x = display_size;
-            wmove(inp_win, 0, inp_x);
-        } else {
-            glong offset = g_utf8_pointer_to_offset(input, curr_ch);
-            if (offset == display_size - 1) {
-                inp_x = offset + 1;
-            } else {
-                inp_x = offset;
-            }
-            wmove(inp_win, 0, inp_x);
-        }
-
-        // if gone off screen to right, jump right (half a screen worth)
-        if (inp_x > pad_start + cols) {
-            pad_start = pad_start + (cols / 2);
-            _inp_win_update_virtual();
+        gunichar curr_uni = gap_buffer_after(line);
+        while ((curr_uni != 0) && !g_unichar_isspace(curr_uni)) {
+            gap_buffer_right(line);
+            curr_uni = gap_buffer_after(line);
         }
-
         return 1;
 
     // ALT-LEFT
@@ -400,96 +387,56 @@ _handle_edit(int result, const wint_t ch, char *input, int *size)
             // check for ALT-key
             next_ch = wgetch(inp_win);
             if (next_ch != ERR) {
-                return _handle_alt_key(input, size, next_ch);
+                return _handle_alt_key(next_ch);
             } else {
-                *size = 0;
                 inp_win_reset();
                 return 1;
             }
 
         case 127:
-            _handle_backspace(display_size, inp_x, size, input);
+            _handle_backspace();
             return 1;
         case KEY_BACKSPACE:
             if (result != KEY_CODE_YES) {
                 return 0;
             }
-            _handle_backspace(display_size, inp_x, size, input);
+            _handle_backspace();
             return 1;
 
         case KEY_DC: // DEL
             if (result != KEY_CODE_YES) {
                 return 0;
             }
-            if (inp_x == display_size-1) {
-                gchar *start = g_utf8_substring(input, 0, inp_x);
-                for (*size = 0; *size < strlen(start); (*size)++) {
-                    input[*size] = start[*size];
-                }
-                input[*size] = '\0';
-
-                g_free(start);
-
-                _clear_input();
-                waddstr(inp_win, input);
-            } else if (inp_x < display_size-1) {
-                gchar *start = g_utf8_substring(input, 0, inp_x);
-                gchar *end = g_utf8_substring(input, inp_x+1, *size);
-                GString *new = g_string_new(start);
-                g_string_append(new, end);
-
-                for (*size = 0; *size < strlen(new->str); (*size)++) {
-                    input[*size] = new->str[*size];
-                }
-                input[*size] = '\0';
-
-                g_free(start);
-                g_free(end);
-                g_string_free(new, FALSE);
-
-                _clear_input();
-                waddstr(inp_win, input);
-                wmove(inp_win, 0, inp_x);
-            }
+            gap_buffer_delete_after(line);
             return 1;
 
         case KEY_LEFT:
             if (result != KEY_CODE_YES) {
                 return 0;
             }
-            if (inp_x > 0) {
-                wmove(inp_win, 0, inp_x-1);
-
-                // current position off screen to left
-                if (inp_x - 1 < pad_start) {
-                    pad_start--;
-                    _inp_win_update_virtual();
-                }
-            }
+            gap_buffer_left(line);
             return 1;
 
         case KEY_RIGHT:
             if (result != KEY_CODE_YES) {
                 return 0;
             }
-            if (inp_x < display_size) {
-                wmove(inp_win, 0, inp_x+1);
-
-                // current position off screen to right
-                if ((inp_x + 1 - pad_start) >= cols) {
-                    pad_start++;
-                    _inp_win_update_virtual();
-                }
-            }
+            gap_buffer_right(line);
             return 1;
 
         case KEY_UP:
             if (result != KEY_CODE_YES) {
                 return 0;
             }
-            prev = cmd_history_previous(input, size);
-            if (prev) {
-                inp_replace_input(input, prev, size);
+
+            // move between lines before going through the history
+            if (!gap_buffer_up(line)) {
+                char *input = (char *)gap_buffer_text(line);
+                int size = gap_buffer_bytes(line);
+                prev = cmd_history_previous(input, &size);
+                if (prev) {
+                    inp_replace_input(input, prev, &size);
+                }
             }
             return 1;
 
@@ -497,13 +444,16 @@ _handle_edit(int result, const wint_t ch, char *input, int *size)
             if (result != KEY_CODE_YES) {
                 return 0;
             }
-            next = cmd_history_next(input, size);
-            if (next) {
-                inp_replace_input(input, next, size);
-            } else if (*size != 0) {
-                input[*size] = '\0';
-                cmd_history_append(input);
-                inp_replace_input(input, "", size);
+            if (!gap_buffer_down(line)) {
+                char *input = (char *)gap_buffer_text(line);
+                int size = gap_buffer_bytes(line);
+                next = cmd_history_next(input, &size);
+                if (next) {
+                    inp_replace_input(input, next, &size);
+                } else if (size != 0) {
+                    cmd_history_append(input);
+                    inp_replace_input(input, "", &size);
+                }
             }
             return 1;
 
@@ -511,24 +461,24 @@ _handle_edit(int result, const wint_t ch, char *input, int *size)
             if (result != KEY_CODE_YES) {
                 return 0;
             }
-            wmove(inp_win, 0, 0);
-            pad_start = 0;
-            _inp_win_update_virtual();
+            gap_buffer_home(line);
             return 1;
 
         case KEY_END:
             if (result != KEY_CODE_YES) {
                 return 0;
             }
-            _go_to_end(display_size);
+            gap_buffer_end(line);
             return 1;
 
         case 9: // tab
-            if (*size != 0) {
+            if (gap_buffer_length(line) != 0) {
+                char *input = (char *)gap_buffer_text(line);
+                int size = gap_buffer_bytes(line);
                 if ((strncmp(input, "/", 1) != 0) && (ui_current_win_type() == WIN_MUC)) {
-                    muc_autocomplete(input, size);
+                    muc_autocomplete(input, &size);
                 } else if (strncmp(input, "/", 1) == 0) {
-                    cmd_autocomplete(input, size);
+                    cmd_autocomplete(input, &size);
                 }
             }
             return 1;
@@ -540,64 +490,16 @@ _handle_edit(int result, const wint_t ch, char *input, int *size)
 }
 
 static void
-_handle_backspace(int display_size, int inp_x, int *size, char *input)
+_handle_backspace(void)
 {
     roster_reset_search_attempts();
-    if (display_size > 0) {
-
-        // if at end, delete last char
-        if (inp_x >= display_size) {
-            gchar *start = g_utf8_substring(input, 0, inp_x-1);
-            for (*size = 0; *size < strlen(start); (*size)++) {
-                input[*size] = start[*size];
-            }
-            input[*size] = '\0';
-
-            g_free(start);
-
-            _clear_input();
-            waddstr(inp_win, input);
-            wmove(inp_win, 0, inp_x -1);
-
-        // if in middle, delete and shift chars left
-        } else if (inp_x > 0 && inp_x < display_size) {
-            gchar *start = g_utf8_substring(input, 0, inp_x - 1);
-            gchar *end = g_utf8_substring(input, inp_x, *size);
-            GString *new = g_string_new(start);
-            g_string_append(new, end);
-
-            for (*size = 0; *size < strlen(new->str); (*size)++) {
-                input[*size] = new->str[*size];
-            }
-            input[*size] = '\0';
-
-            g_free(start);
-            g_free(end);
-            g_string_free(new, FALSE);
-
-            _clear_input();
-            waddstr(inp_win, input);
-            wmove(inp_win, 0, inp_x -1);
-        }
-
-        // if gone off screen to left, jump left (half a screen worth)
-        if (inp_x <= pad_start) {
-            pad_start = pad_start - (cols / 2);
-            if (pad_start < 0) {
-                pad_start = 0;
-            }
-
-            _inp_win_update_virtual();
-        }
-    }
-
+    gap_buffer_delete_before(line);
 }
 
 static int
-_handle_alt_key(char *input, int *size, int key)
+_handle_alt_key(int key)
 {
-    int end_del = getcurx(inp_win);
-    int start_del = end_del;
+    gunichar curr_uni;
 
     switch (key)
     {
@@ -637,86 +539,264 @@ _handle_alt_key(char *input, int *size, int key)
         case KEY_RIGHT:
             ui_next_win();
             break;
+
+        // ALT-ENTER starts a new line in the message
+        case '\n':
+        case '\r':
+        case KEY_ENTER:
+            gap_buffer_insert(line, "\n", 1);
+            cmd_reset_autocomplete();
+            break;
+
         case 263:
         case 127:
-            input[*size] = '\0';
-            gchar *curr_ch = g_utf8_offset_to_pointer(input, end_del);
-            curr_ch = g_utf8_find_prev_char(input, curr_ch);
-            gchar *prev_ch;
-            gunichar curr_uni;
-            gunichar prev_uni;
-
-            while (curr_ch != NULL) {
-                curr_uni = g_utf8_get_char(curr_ch);
-
-                if (g_unichar_isspace(curr_uni)) {
-                    curr_ch = g_utf8_find_prev_char(input, curr_ch);
-                } else {
-                    prev_ch = g_utf8_find_prev_char(input, curr_ch);
-                    if (prev_ch == NULL) {
-                        curr_ch = NULL;
-                        break;
-                    } else {
-                        prev_uni = g_utf8_get_char(prev_ch);
-                        if (g_unichar_isspace(prev_uni)) {
-                            break;
-                        } else {
-                            curr_ch = prev_ch;
-                        }
-                    }
-                }
+            while (g_unichar_isspace(gap_buffer_before(line))) {
+                gap_buffer_delete_before(line);
             }
-
-            if (curr_ch == NULL) {
-                start_del = 0;
-            } else {
-                start_del = g_utf8_pointer_to_offset(input, curr_ch);
+            curr_uni = gap_buffer_before(line);
+            while ((curr_uni != 0) && !g_unichar_isspace(curr_uni)) {
+                gap_buffer_delete_before(line);
+                curr_uni = gap_buffer_before(line);
             }
+            break;
+        default:
+            break;
+    }
+    return 1;
+}
 
-            gint len = g_utf8_strlen(input, -1);
-            gchar *start_string = g_utf8_substring(input, 0, start_del);
-            gchar *end_string = g_utf8_substring(input, end_del, len);
+/*
+ * Draw the rows of the input around the cursor, growing or shrinking the
+ * input area to fit the text
+ */
+static void
+_inp_draw(void)
+{
+    _inp_layout_changed();
 
-            int i;
-            for (i = 0; i < strlen(start_string); i++) {
-                input[i] = start_string[i];
-            }
-            for (i = 0; i < strlen(end_string); i++) {
-                input[strlen(start_string)+i] = end_string[i];
+    int max_height = rows / 3;
+    if (max_height < 1) {
+        max_height = 1;
+    }
+
+    // find the cursor from the start of its row
+    gsize bytes = gap_buffer_bytes(line);
+    gsize point = gap_buffer_point(line);
+    _inp_layout_to(point, 0);
+    guint cursor_row = _row_at(point);
+    int cursor_col = 0;
+    gsize pos = g_array_index(row_starts, gsize, cursor_row);
+    while (pos < point) {
+        const char *curr = gap_buffer_at(line, pos);
+        cursor_col += gap_buffer_char_width(g_utf8_get_char(curr));
+        pos += g_utf8_next_char(curr) - curr;
+    }
+    if (cursor_col >= cols) {
+        cursor_row++;
+        cursor_col = 0;
+    }
+
+    // enough rows to fill the view from the cursor, rows further on do not
+    // change the height or what is shown
+    _inp_layout_to(point, cursor_row + max_height + 1);
+    int total = MAX(row_starts->len, cursor_row + 1);
+
+    int new_height = MIN(total, max_height);
+    if (new_height != height) {
+        height = new_height;
+        wresize(inp_win, height, cols);
+    }
+
+    // keep the cursor row in view
+    if ((int)cursor_row < top) {
+        top = cursor_row;
+    } else if ((int)cursor_row >= top + height) {
+        top = cursor_row - height + 1;
+    }
+    if (top > total - height) {
+        top = total - height;
+    }
+
+    werase(inp_win);
+    guint row;
+    for (row = top; (row < row_starts->len) && ((int)row < top + height); row++) {
+        gsize end = bytes;
+        if (row + 1 < row_starts->len) {
+            end = g_array_index(row_starts, gsize, row + 1);
+        }
+
+        int col = 0;
+        pos = g_array_index(row_starts, gsize, row);
+        while (pos < end) {
+            const char *curr = gap_buffer_at(line, pos);
+            gunichar ch = g_utf8_get_char(curr);
+            int len = g_utf8_next_char(curr) - curr;
+            if (ch != '\n') {
+                mvwaddnstr(inp_win, row - top, col, curr, len);
+                col += gap_buffer_char_width(ch);
             }
+            pos += len;
+        }
+    }
+    wmove(inp_win, cursor_row - top, cursor_col);
+}
+
+/*
+ * Drop the rows changed by edits since the last draw, everything when the
+ * width has changed
+ */
+static void
+_inp_layout_changed(void)
+{
+    gsize from = 0;
+    gboolean changed = gap_buffer_take_changed(line, &from);
+    if (layout_cols != cols) {
+        layout_cols = cols;
+        from = 0;
+        changed = TRUE;
+    }
+    if (!changed) {
+        return;
+    }
 
-            *size = strlen(start_string)+i;
-            input[*size] = '\0';
+    // the row before the edit can take characters from the edited row
+    guint row = _row_at(from);
+    if (row > 0) {
+        row--;
+    }
+    g_array_set_size(row_starts, row + 1);
+    layout_done = FALSE;
+}
 
-            _clear_input();
-            waddstr(inp_win, input);
-            wmove(inp_win, 0, start_del);
+/*
+ * Lay out rows until the one after byte pos has started and there are at
+ * least wanted rows, or the text ends. Rows wrap at the edge of the screen
+ * and after each newline.
+ */
+static void
+_inp_layout_to(gsize pos, guint wanted)
+{
+    if (layout_done) {
+        return;
+    }
 
-            // if gone off screen to left, jump left (half a screen worth)
-            if (start_del <= pad_start) {
-                pad_start = pad_start - (cols / 2);
-                if (pad_start < 0) {
-                    pad_start = 0;
-                }
+    gsize bytes = gap_buffer_bytes(line);
+    gsize curr_pos = g_array_index(row_starts, gsize, row_starts->len - 1);
+    int col = 0;
+    while ((curr_pos <= pos) || (row_starts->len < wanted)) {
+        if (curr_pos >= bytes) {
+            layout_done = TRUE;
+            return;
+        }
+
+        const char *curr = gap_buffer_at(line, curr_pos);
+        gunichar ch = g_utf8_get_char(curr);
+        gsize next = curr_pos + (g_utf8_next_char(curr) - curr);
 
-                _inp_win_update_virtual();
+        if (ch == '\n') {
+            g_array_append_val(row_starts, next);
+            col = 0;
+        } else {
+            int width = gap_buffer_char_width(ch);
+            if (col + width > cols) {
+                g_array_append_val(row_starts, curr_pos);
+                col = 0;
             }
+            col += width;
+        }
+        curr_pos = next;
+    }
+}
 
-            return 1;
-            break;
-        default:
-            break;
+// the row holding the character at byte pos, of those laid out
+static guint
+_row_at(gsize pos)
+{
+    guint low = 0;
+    guint high = row_starts->len - 1;
+    while (low < high) {
+        guint mid = (low + high + 1) / 2;
+        if (g_array_index(row_starts, gsize, mid) <= pos) {
+            low = mid;
+        } else {
+            high = mid - 1;
+        }
     }
-    return 1;
+
+    return low;
 }
 
+// curses writes through its own buffer, send the sequence straight away so
+// it is not held in stdio's until exit
 static void
-_go_to_end(int display_size)
+_paste_mode(const char * const sequence)
 {
-    wmove(inp_win, 0, display_size);
-    if (display_size > cols-2) {
-        pad_start = display_size - cols + 1;
-        _inp_win_update_virtual();
+    putp(sequence);
+    fflush(stdout);
+}
+
+/*
+ * Read pasted text into the input in one go, drawing the input and sending
+ * a typing notification once rather than for each character. Returns ERR
+ * when the end of the paste has not arrived yet.
+ */
+static wint_t
+_handle_paste(void)
+{
+    GString *pasted = g_string_new(NULL);
+    wint_t ch;
+    wint_t last = 0;
+    int result;
+
+    while ((result = wget_wch(inp_win, &ch)) != ERR) {
+        if (result == KEY_CODE_YES) {
+            if (ch == KEY_PASTE_END) {
+                in_paste = FALSE;
+                break;
+            }
+            continue;
+        }
+
+        // keep line breaks, the input grows to show them
+        if (ch == '\r') {
+            last = ch;
+            ch = '\n';
+        } else if ((ch == '\n') && (last == '\r')) {
+            last = ch;
+            continue;
+        } else {
+            last = ch;
+        }
+        if (ch == '\t') {
+            ch = ' ';
+        }
+        if ((ch != '\n') && !_printable(ch)) {
+            continue;
+        }
+
+        char bytes[MB_CUR_MAX+1];
+        size_t utf_len = wcrtomb(bytes, ch, NULL);
+        if (utf_len != (size_t) -1) {
+            g_string_append_len(pasted, bytes, utf_len);
+        }
+    }
+
+    if (pasted->len > 0) {
+        gap_buffer_insert(line, pasted->str, pasted->len);
+        dirty = TRUE;
+
+        if (prefs_get_boolean(PREF_STATES) && prefs_get_boolean(PREF_OUTTYPE)
+                && !gap_buffer_starts_with(line, "/")) {
+            prof_handle_activity();
+        }
+        cmd_reset_autocomplete();
+    }
+    g_string_free(pasted, TRUE);
+
+    if (in_paste) {
+        return ERR;
+    } else {
+        return KEY_PASTE_END;
     }
 }
 
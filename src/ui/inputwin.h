@@ -36,10 +36,15 @@
 #define UI_INPUTWIN_H
 
 void create_input_window(void);
-wint_t inp_get_char(char *input, int *size);
+void inp_close(void);
+void inp_enable_paste(void);
+wint_t inp_get_char(void);
+char * inp_get_line(void);
 void inp_win_reset(void);
-void inp_win_resize(const char * input, const int size);
+void inp_win_resize(void);
+int inp_win_height(void);
 void inp_put_back(void);
+gboolean inp_changed(void);
 void inp_non_block(void);
 void inp_block(void);
 void inp_get_password(char *passwd);
@@ -0,0 +1,200 @@
+/*
+ * scrollback.c
+ *
+ * Copyright (C) 2012 - 2014 James Booth <boothj5@gmail.com>
+ *
+ * This file is part of Profanity.
+ *
+ * Profanity is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Profanity is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Profanity.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give permission to
+ * link the code of portions of this program with the OpenSSL library under
+ * certain conditions as described in each individual source file, and
+ * distribute linked combinations including the two.
+ *
+ * You must obey the GNU General Public License in all respects for all of the
+ * code used other than OpenSSL. If you modify file(s) with this exception, you
+ * may extend this exception to your version of the file(s), but you are not
+ * obligated to do so. If you do not wish to do so, delete this exception
+ * statement from your version. If you delete this exception statement from all
+ * source files in the program, then also delete it here.
+ *
+ */
+
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "log.h"
+#include "ui/scrollback.h"
+
+// a page of lines from one day file, lines is NULL when not cached
+struct scrollback_page_t {
+    ChatLogPos start;
+    long end;
+    GSList *lines;
+};
+
+// pages are read backwards from the anchor, the position of the oldest line
+// the window already shows. Page positions are kept so evicted pages can be
+// read again directly.
+struct prof_scrollback_t {
+    gchar *login;
+    gchar *recipient;
+    gboolean room;
+    ChatLogPos oldest;
+    GPtrArray *pages;
+    GQueue *cached;
+    int current;
+};
+
+static GSList * _page_lines(ProfScrollback scrollback,
+    struct scrollback_page_t *page);
+static void _cache_page(ProfScrollback scrollback,
+    struct scrollback_page_t *page);
+static void _free_page(struct scrollback_page_t *page);
+
+ProfScrollback
+scrollback_create(const char * const login, const char * const recipient,
+    gboolean room, ChatLogPos anchor)
+{
+    ProfScrollback new_scrollback = malloc(sizeof(struct prof_scrollback_t));
+    new_scrollback->login = g_strdup(login);
+    new_scrollback->recipient = g_strdup(recipient);
+    new_scrollback->room = room;
+    new_scrollback->oldest = anchor;
+    new_scrollback->pages = g_ptr_array_new_with_free_func((GDestroyNotify)_free_page);
+    new_scrollback->cached = g_queue_new();
+    new_scrollback->current = -1;
+
+    return new_scrollback;
+}
+
+void
+scrollback_free(ProfScrollback scrollback)
+{
+    if (scrollback != NULL) {
+        g_queue_free(scrollback->cached);
+        g_ptr_array_free(scrollback->pages, TRUE);
+        g_free(scrollback->login);
+        g_free(scrollback->recipient);
+        free(scrollback);
+    }
+}
+
+/*
+ * Move to the next older page and return its lines, reading them from the
+ * logs if needed. Returns NULL when there are no older lines.
+ */
+GSList *
+scrollback_older(ProfScrollback scrollback)
+{
+    if (scrollback->current + 1 < scrollback->pages->len) {
+        scrollback->current++;
+        struct scrollback_page_t *page =
+            g_ptr_array_index(scrollback->pages, scrollback->current);
+        return _page_lines(scrollback, page);
+    }
+
+    long end = 0;
+    ChatLogPos start = scrollback->oldest;
+    GSList *lines = chat_log_get_before(scrollback->login,
+        scrollback->recipient, scrollback->room, &start, &end,
+        SCROLLBACK_PAGE_LINES);
+    if (lines == NULL) {
+        return NULL;
+    }
+
+    struct scrollback_page_t *page = malloc(sizeof(struct scrollback_page_t));
+    page->start = start;
+    page->end = end;
+    page->lines = lines;
+    g_ptr_array_add(scrollback->pages, page);
+    _cache_page(scrollback, page);
+    scrollback->oldest = start;
+    scrollback->current++;
+
+    return lines;
+}
+
+/*
+ * Move to the next newer page and return its lines. Returns NULL when
+ * moving past the newest page, back to the window contents.
+ */
+GSList *
+scrollback_newer(ProfScrollback scrollback)
+{
+    if (scrollback->current <= 0) {
+        scrollback->current = -1;
+        return NULL;
+    }
+
+    scrollback->current--;
+    struct scrollback_page_t *page =
+        g_ptr_array_index(scrollback->pages, scrollback->current);
+
+    return _page_lines(scrollback, page);
+}
+
+void
+scrollback_reset(ProfScrollback scrollback)
+{
+    scrollback->current = -1;
+}
+
+gboolean
+scrollback_showing(ProfScrollback scrollback)
+{
+    return (scrollback != NULL) && (scrollback->current >= 0);
+}
+
+// most recently used pages are at the head of the cache
+static GSList *
+_page_lines(ProfScrollback scrollback, struct scrollback_page_t *page)
+{
+    if (page->lines != NULL) {
+        g_queue_remove(scrollback->cached, page);
+        g_queue_push_head(scrollback->cached, page);
+        return page->lines;
+    }
+
+    page->lines = chat_log_get_range(scrollback->login, scrollback->recipient,
+        scrollback->room, page->start, page->end);
+    _cache_page(scrollback, page);
+
+    return page->lines;
+}
+
+static void
+_cache_page(ProfScrollback scrollback, struct scrollback_page_t *page)
+{
+    g_queue_push_head(scrollback->cached, page);
+
+    if (g_queue_get_length(scrollback->cached) > SCROLLBACK_CACHED_PAGES) {
+        struct scrollback_page_t *evicted = g_queue_pop_tail(scrollback->cached);
+        g_slist_free_full(evicted->lines, free);
+        evicted->lines = NULL;
+    }
+}
+
+static void
+_free_page(struct scrollback_page_t *page)
+{
+    g_slist_free_full(page->lines, free);
+    free(page);
+}
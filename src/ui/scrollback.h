@@ -0,0 +1,58 @@
+/*
+ * scrollback.h
+ *
+ * Copyright (C) 2012 - 2014 James Booth <boothj5@gmail.com>
+ *
+ * This file is part of Profanity.
+ *
+ * Profanity is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Profanity is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Profanity.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give permission to
+ * link the code of portions of this program with the OpenSSL library under
+ * certain conditions as described in each individual source file, and
+ * distribute linked combinations including the two.
+ *
+ * You must obey the GNU General Public License in all respects for all of the
+ * code used other than OpenSSL. If you modify file(s) with this exception, you
+ * may extend this exception to your version of the file(s), but you are not
+ * obligated to do so. If you do not wish to do so, delete this exception
+ * statement from your version. If you delete this exception statement from all
+ * source files in the program, then also delete it here.
+ *
+ */
+
+
+#ifndef UI_SCROLLBACK_H
+#define UI_SCROLLBACK_H
+
+#include <glib.h>
+
+#include "log.h"
+
+// lines read from the logs for each page
+#define SCROLLBACK_PAGE_LINES 200
+
+// pages kept in memory, older pages are read again when shown
+#define SCROLLBACK_CACHED_PAGES 4
+
+typedef struct prof_scrollback_t *ProfScrollback;
+
+ProfScrollback scrollback_create(const char * const login,
+    const char * const recipient, gboolean room, ChatLogPos anchor);
+void scrollback_free(ProfScrollback scrollback);
+GSList * scrollback_older(ProfScrollback scrollback);
+GSList * scrollback_newer(ProfScrollback scrollback);
+void scrollback_reset(ProfScrollback scrollback);
+gboolean scrollback_showing(ProfScrollback scrollback);
+#endif
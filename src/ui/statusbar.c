@@ -37,6 +37,7 @@
 #include <assert.h>
 #include <string.h>
 #include <stdlib.h>
+#include <time.h>
 
 #ifdef HAVE_NCURSESW_NCURSES_H
 #include <ncursesw/ncurses.h>
@@ -63,6 +64,10 @@ static GHashTable *remaining_new;
 static GDateTime *last_time;
 static int current;
 
+// redraw needed, and the minute last drawn
+static gboolean dirty;
+static time_t drawn_minute;
+
 static void _update_win_statuses(void);
 static void _mark_new(int num);
 static void _mark_active(int num);
@@ -85,7 +90,7 @@ create_status_bar(void)
     remaining_new = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, NULL);
     current = 1;
 
-    status_bar = newwin(1, cols, rows-2, 0);
+    status_bar = newwin(1, cols, rows-1-inp_win_height(), 0);
     wbkgd(status_bar, COLOUR_STATUS_TEXT);
     wattron(status_bar, COLOUR_STATUS_BRACKET);
     mvwprintw(status_bar, 0, cols - 34, _active);
@@ -97,13 +102,26 @@ create_status_bar(void)
     }
     last_time = g_date_time_new_now_local();
 
-    _status_bar_draw();
+    dirty = TRUE;
 }
 
-void
+/*
+ * Draw the status bar if it or the time has changed, returns TRUE if it was
+ * drawn
+ */
+gboolean
 status_bar_update_virtual(void)
 {
+    if (time(NULL) / 60 != drawn_minute) {
+        dirty = TRUE;
+    }
+
+    if (!dirty) {
+        return FALSE;
+    }
+
     _status_bar_draw();
+    return TRUE;
 }
 
 void
@@ -114,7 +132,7 @@ status_bar_resize(void)
 
     werase(status_bar);
 
-    mvwin(status_bar, rows-2, 0);
+    mvwin(status_bar, rows-1-inp_win_height(), 0);
     wresize(status_bar, 1, cols);
     wbkgd(status_bar, COLOUR_STATUS_TEXT);
     wattron(status_bar, COLOUR_STATUS_BRACKET);
@@ -130,7 +148,7 @@ status_bar_resize(void)
     }
     last_time = g_date_time_new_now_local();
 
-    _status_bar_draw();
+    dirty = TRUE;
 }
 
 void
@@ -146,7 +164,7 @@ status_bar_set_all_inactive(void)
     g_hash_table_remove_all(remaining_active);
     g_hash_table_remove_all(remaining_new);
 
-    _status_bar_draw();
+    dirty = TRUE;
 }
 
 void
@@ -165,7 +183,7 @@ status_bar_current(int i)
     mvwprintw(status_bar, 0, cols - 34 + ((current - 1) * 3), bracket);
     wattroff(status_bar, COLOUR_STATUS_BRACKET);
 
-    _status_bar_draw();
+    dirty = TRUE;
 }
 
 void
@@ -207,7 +225,7 @@ status_bar_inactive(const int win)
         _mark_inactive(true_win);
     }
 
-    _status_bar_draw();
+    dirty = TRUE;
 }
 
 void
@@ -243,7 +261,7 @@ status_bar_active(const int win)
         _mark_active(true_win);
     }
 
-    _status_bar_draw();
+    dirty = TRUE;
 }
 
 void
@@ -268,7 +286,7 @@ status_bar_new(const int win)
         _mark_new(true_win);
     }
 
-    _status_bar_draw();
+    dirty = TRUE;
 }
 
 void
@@ -297,7 +315,7 @@ status_bar_print_message(const char * const msg)
     mvwprintw(status_bar, 0, cols - 34 + ((current - 1) * 3), bracket);
     wattroff(status_bar, COLOUR_STATUS_BRACKET);
 
-    _status_bar_draw();
+    dirty = TRUE;
 }
 
 void
@@ -317,7 +335,7 @@ status_bar_clear(void)
     mvwprintw(status_bar, 0, cols - 34 + ((current - 1) * 3), bracket);
     wattroff(status_bar, COLOUR_STATUS_BRACKET);
 
-    _status_bar_draw();
+    dirty = TRUE;
 }
 
 void
@@ -337,7 +355,7 @@ status_bar_clear_message(void)
     mvwprintw(status_bar, 0, cols - 34 + ((current - 1) * 3), bracket);
     wattroff(status_bar, COLOUR_STATUS_BRACKET);
 
-    _status_bar_draw();
+    dirty = TRUE;
 }
 
 static void
@@ -420,5 +438,6 @@ _status_bar_draw(void)
 
     _update_win_statuses();
     wnoutrefresh(status_bar);
-    inp_put_back();
+    drawn_minute = time(NULL) / 60;
+    dirty = FALSE;
 }
@@ -36,7 +36,7 @@
 #define UI_STATUSBAR_H
 
 void create_status_bar(void);
-void status_bar_update_virtual(void);
+gboolean status_bar_update_virtual(void);
 void status_bar_resize(void);
 void status_bar_clear(void);
 void status_bar_clear_message(void);
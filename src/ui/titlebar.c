@@ -48,6 +48,7 @@
 #include "roster_list.h"
 
 #define CONSOLE_TITLE "Profanity. Type /help for help information."
+#define TYPING_TIMEOUT 10
 
 static WINDOW *win;
 static char *current_title = NULL;
@@ -55,9 +56,16 @@ static char *current_recipient = NULL;
 static contact_presence_t current_presence;
 
 static gboolean typing;
-static GTimer *typing_elapsed;
+static guint typing_timer = 0;
+
+// redraw needed, and the unsaved form state last drawn
+static gboolean dirty;
+static gboolean form_modified;
 
 static void _title_bar_draw(void);
+static gboolean _current_form_modified(void);
+static gboolean _typing_timeout(gpointer data);
+static void _typing_timer_stop(void);
 
 void
 create_title_bar(void)
@@ -68,28 +76,24 @@ create_title_bar(void)
     wbkgd(win, COLOUR_TITLE_TEXT);
     title_bar_console();
     title_bar_set_presence(CONTACT_OFFLINE);
-    wnoutrefresh(win);
-    inp_put_back();
 }
 
-void
+/*
+ * Draw the title bar if it has changed, returns TRUE if it was drawn
+ */
+gboolean
 title_bar_update_virtual(void)
 {
-    if (current_recipient != NULL) {
-
-        if (typing_elapsed != NULL) {
-            gdouble seconds = g_timer_elapsed(typing_elapsed, NULL);
-
-            if (seconds >= 10) {
-                typing = FALSE;
-
-                g_timer_destroy(typing_elapsed);
-                typing_elapsed = NULL;
+    if (_current_form_modified() != form_modified) {
+        dirty = TRUE;
+    }
 
-            }
-        }
+    if (!dirty) {
+        return FALSE;
     }
+
     _title_bar_draw();
+    return TRUE;
 }
 
 void
@@ -100,7 +104,7 @@ title_bar_resize(void)
     wresize(win, 1, cols);
     wbkgd(win, COLOUR_TITLE_TEXT);
 
-    _title_bar_draw();
+    dirty = TRUE;
 }
 
 void
@@ -112,29 +116,26 @@ title_bar_console(void)
     }
     current_recipient = NULL;
     typing = FALSE;
-    typing_elapsed = NULL;
+    _typing_timer_stop();
 
     free(current_title);
     current_title = strdup(CONSOLE_TITLE);
 
-    _title_bar_draw();
+    dirty = TRUE;
 }
 
 void
 title_bar_set_presence(contact_presence_t presence)
 {
     current_presence = presence;
-    _title_bar_draw();
+    dirty = TRUE;
 }
 
 void
 title_bar_set_recipient(const char * const recipient)
 {
-    if (typing_elapsed != NULL) {
-        g_timer_destroy(typing_elapsed);
-        typing_elapsed = NULL;
-        typing = FALSE;
-    }
+    _typing_timer_stop();
+    typing = FALSE;
 
     free(current_recipient);
     current_recipient = strdup(recipient);
@@ -142,24 +143,41 @@ title_bar_set_recipient(const char * const recipient)
     free(current_title);
     current_title = strdup(recipient);
 
-    _title_bar_draw();
+    dirty = TRUE;
 }
 
 void
 title_bar_set_typing(gboolean is_typing)
 {
     if (is_typing) {
-        if (typing_elapsed != NULL) {
-            g_timer_start(typing_elapsed);
-        } else {
-            typing_elapsed = g_timer_new();
-        }
+        _typing_timer_stop();
+        typing_timer = g_timeout_add_seconds(TYPING_TIMEOUT, _typing_timeout, NULL);
     }
 
     typing = is_typing;
 
+    dirty = TRUE;
+}
 
-    _title_bar_draw();
+static gboolean
+_typing_timeout(gpointer data)
+{
+    typing_timer = 0;
+    if (current_recipient != NULL) {
+        typing = FALSE;
+        dirty = TRUE;
+    }
+
+    return FALSE;
+}
+
+static void
+_typing_timer_stop(void)
+{
+    if (typing_timer != 0) {
+        g_source_remove(typing_timer);
+        typing_timer = 0;
+    }
 }
 
 static void
@@ -242,11 +260,9 @@ _title_bar_draw(void)
 #endif
 
     // show indicator for unsaved forms
-    ProfWin *current = wins_get_current();
-    if ((current != NULL ) && (current->type == WIN_MUC_CONFIG)) {
-        if ((current->form != NULL) && (current->form->modified)) {
-            wprintw(win, " *");
-        }
+    form_modified = _current_form_modified();
+    if (form_modified) {
+        wprintw(win, " *");
     }
 
     // show contact typing
@@ -288,5 +304,18 @@ _title_bar_draw(void)
     wattroff(win, COLOUR_TITLE_BRACKET);
 
     wnoutrefresh(win);
-    inp_put_back();
+    dirty = FALSE;
+}
+
+static gboolean
+_current_form_modified(void)
+{
+    ProfWin *current = wins_get_current();
+    if ((current != NULL ) && (current->type == WIN_MUC_CONFIG)) {
+        if ((current->form != NULL) && (current->form->modified)) {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
 }
@@ -36,7 +36,7 @@
 #define UI_TITLEBAR_H
 
 void create_title_bar(void);
-void title_bar_update_virtual(void);
+gboolean title_bar_update_virtual(void);
 void title_bar_resize(void);
 void title_bar_console(void);
 void title_bar_set_presence(contact_presence_t presence);
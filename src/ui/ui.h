@@ -51,8 +51,6 @@
 #include "ui/window.h"
 #include "xmpp/xmpp.h"
 
-#define INP_WIN_MAX 1000
-
 void ui_init_module(void);
 void console_init_module(void);
 void notifier_init_module(void);
@@ -62,11 +60,10 @@ void (*ui_init)(void);
 void (*ui_load_colours)(void);
 void (*ui_update)(void);
 void (*ui_close)(void);
-void (*ui_resize)(const int ch, const char * const input,
-    const int size);
+void (*ui_resize)(const int ch);
 GSList* (*ui_get_recipients)(void);
-void (*ui_handle_special_keys)(const wint_t * const ch, const char * const inp,
-    const int size);
+gboolean (*ui_has_recipients)(void);
+void (*ui_handle_special_keys)(const wint_t * const ch);
 gboolean (*ui_switch_win)(const int i);
 void (*ui_next_win)(void);
 void (*ui_previous_win)(void);
@@ -183,6 +180,7 @@ void (*ui_open_duck_win)(void);
 void (*ui_duck)(const char * const query);
 void (*ui_duck_result)(const char * const result);
 gboolean (*ui_duck_exists)(void);
+void (*ui_search_results)(const char * const query, GSList *results);
 
 void (*ui_tidy_wins)(void);
 void (*ui_prune_wins)(void);
@@ -197,7 +195,8 @@ void (*ui_update_presence)(const resource_presence_t resource_presence,
 void (*ui_about)(void);
 void (*ui_statusbar_new)(const int win);
 
-wint_t (*ui_get_char)(char *input, int *size);
+wint_t (*ui_get_char)(void);
+char * (*ui_get_line)(void);
 void (*ui_input_clear)(void);
 void (*ui_input_nonblocking)(void);
 void (*ui_replace_input)(char *input, const char * const new_input, int *size);
@@ -263,6 +262,7 @@ void (*cons_vercheck_setting)(void);
 void (*cons_mouse_setting)(void);
 void (*cons_statuses_setting)(void);
 void (*cons_titlebar_setting)(void);
+void (*cons_fps_setting)(void);
 void (*cons_notify_setting)(void);
 void (*cons_show_desktop_prefs)(void);
 void (*cons_states_setting)(void);
@@ -37,6 +37,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <wchar.h>
 
 #include <glib.h>
 #ifdef HAVE_NCURSESW_NCURSES_H
@@ -45,31 +46,40 @@
 #include <ncurses.h>
 #endif
 
+#include "config/preferences.h"
 #include "config/theme.h"
+#include "ui/inputwin.h"
 #include "ui/window.h"
 #include "xmpp/xmpp.h"
 
 static void _win_print(ProfWin *window, const char show_char, const char * const date_fmt,
     int flags, int attrs, const char * const from, const char * const message);
+static int _buffer_size(win_type_t type);
+static void _layout_text(const char * const text, int width, int *row,
+    int *col);
 
 
 ProfWin*
-win_create(const char * const title, int cols, win_type_t type)
+win_create(const char * const title, win_type_t type)
 {
     ProfWin *new_win = malloc(sizeof(struct prof_win_t));
     new_win->from = strdup(title);
-    new_win->win = newpad(PAD_SIZE, cols);
-    wbkgd(new_win->win, COLOUR_TEXT);
-    new_win->buffer = buffer_create();
+    new_win->win = NULL;
+    new_win->buffer = buffer_create(_buffer_size(type));
     new_win->y_pos = 0;
     new_win->paged = 0;
     new_win->unread = 0;
     new_win->history_shown = 0;
+    new_win->unprinted = 0;
+    new_win->trimmed = FALSE;
+    new_win->cleared = 0;
+    new_win->log_start.date = 0;
+    new_win->log_start.offset = 0;
+    new_win->scrollback = NULL;
     new_win->type = type;
     new_win->is_otr = FALSE;
     new_win->is_trusted = FALSE;
     new_win->form = NULL;
-    scrollok(new_win->win, TRUE);
 
     return new_win;
 }
@@ -78,28 +88,78 @@ void
 win_free(ProfWin* window)
 {
     buffer_free(window->buffer);
-    delwin(window->win);
+    scrollback_free(window->scrollback);
+    if (window->win != NULL) {
+        delwin(window->win);
+    }
     free(window->from);
     form_destroy(window->form);
     free(window);
 }
 
+/*
+ * Create the pad for a window about to be displayed, or resize it to the
+ * terminal width, and draw its buffer into it
+ */
+void
+win_show(ProfWin *window)
+{
+    int cols = getmaxx(stdscr);
+
+    if (window->win == NULL) {
+        window->win = newpad(PAD_SIZE, cols);
+        wbkgd(window->win, COLOUR_TEXT);
+        scrollok(window->win, TRUE);
+    } else if (getmaxx(window->win) != cols) {
+        wresize(window->win, PAD_SIZE, cols);
+    } else {
+        return;
+    }
+
+    win_redraw(window);
+}
+
+/*
+ * Free the pad of a window no longer displayed, output is kept in the
+ * buffer until the window is shown again
+ */
+void
+win_hide(ProfWin *window)
+{
+    if (window->win != NULL) {
+        delwin(window->win);
+        window->win = NULL;
+    }
+    if (window->scrollback != NULL) {
+        scrollback_reset(window->scrollback);
+    }
+    window->unprinted = 0;
+    window->paged = 0;
+    window->y_pos = 0;
+}
+
 void
 win_update_virtual(ProfWin *window)
 {
     int rows, cols;
     getmaxyx(stdscr, rows, cols);
-    pnoutrefresh(window->win, window->y_pos, 0, 1, 0, rows-3, cols-1);
+    pnoutrefresh(window->win, window->y_pos, 0, 1, 0, rows-2-inp_win_height(), cols-1);
+
+    // lines outside the visible area stay touched, only track new changes
+    untouchwin(window->win);
 }
 
 void
 win_move_to_end(ProfWin *window)
 {
     window->paged = 0;
+    if (window->win == NULL) {
+        return;
+    }
 
     int rows = getmaxy(stdscr);
     int y = getcury(window->win);
-    int size = rows - 3;
+    int size = rows - 2 - inp_win_height();
 
     window->y_pos = y - (size - 1);
     if (window->y_pos < 0) {
@@ -277,7 +337,7 @@ win_show_info(ProfWin *window, PContact contact)
             if ((caps->os != NULL) || (caps->os_version != NULL)) {
                 win_save_newline(window);
             }
-            caps_destroy(caps);
+            caps_unref(caps);
         }
 
         ordered_resources = g_list_next(ordered_resources);
@@ -379,8 +439,10 @@ win_save_print(ProfWin *window, const char show_char, GTimeVal *tstamp,
 
     g_date_time_unref(time);
     buffer_push(window->buffer, show_char, date_fmt, flags, attrs, from, message);
-    _win_print(window, show_char, date_fmt, flags, attrs, from, message);
     g_free(date_fmt);
+
+    // printed to the pad when next rendered
+    window->unprinted++;
 }
 
 void
@@ -446,17 +508,237 @@ _win_print(ProfWin *window, const char show_char, const char * const date_fmt,
     if (unattr_me) {
         wattroff(window->win, colour);
     }
+
+    if (getcury(window->win) == PAD_SIZE - 1) {
+        window->trimmed = TRUE;
+    }
+}
+
+/*
+ * Work out the rows an entry takes when printed from start_col in a pad of
+ * the given width, as ncurses would wrap it. Kept until the width changes.
+ */
+void
+win_layout_entry(ProfBuffEntry *e, int width, int start_col)
+{
+    if ((e->layout_width == width) && (e->layout_col == start_col)) {
+        return;
+    }
+
+    int row = 0;
+    int col = start_col;
+    int offset = 0;
+
+    if ((e->flags & NO_DATE) == 0) {
+        char date_prefix[32];
+        snprintf(date_prefix, sizeof(date_prefix), "%s %c ", e->date_fmt,
+            e->show_char);
+        _layout_text(date_prefix, width, &row, &col);
+    }
+
+    if (strlen(e->from) > 0) {
+        if (strncmp(e->message, "/me ", 4) == 0) {
+            _layout_text("*", width, &row, &col);
+            _layout_text(e->from, width, &row, &col);
+            _layout_text(" ", width, &row, &col);
+            offset = 4;
+        } else {
+            _layout_text(e->from, width, &row, &col);
+            _layout_text(": ", width, &row, &col);
+        }
+    }
+
+    _layout_text(e->message + offset, width, &row, &col);
+    if ((e->flags & NO_EOL) == 0) {
+        row++;
+        col = 0;
+    }
+
+    e->layout_width = width;
+    e->layout_col = start_col;
+    e->rows = row;
+    e->end_col = col;
+}
+
+// move the row and column past text as printed by ncurses
+static void
+_layout_text(const char * const text, int width, int *row, int *col)
+{
+    const char *curr = text;
+    while (*curr != '\0') {
+        gunichar ch = g_utf8_get_char_validated(curr, -1);
+        if ((ch == (gunichar)-1) || (ch == (gunichar)-2)) {
+            ch = (guchar)*curr;
+            curr++;
+        } else {
+            curr = g_utf8_next_char(curr);
+        }
+
+        // ncurses moves the cursor for these rather than printing them
+        int cells = 1;
+        if (ch == '\n') {
+            (*row)++;
+            *col = 0;
+            continue;
+        } else if (ch == '\r') {
+            *col = 0;
+            continue;
+        } else if (ch == '\b') {
+            if (*col > 0) {
+                (*col)--;
+            }
+            continue;
+        } else if (ch == '\t') {
+            cells = 8 - (*col % 8);
+
+            // a tab past the edge clears the row and goes to the next
+            if (*col + cells > width) {
+                (*row)++;
+                *col = 0;
+                continue;
+            }
+        } else if ((ch < 32) || (ch == 127)) {
+            cells = 2;
+        } else if (g_unichar_iszerowidth(ch)) {
+            cells = 0;
+        } else if (g_unichar_iswide(ch)) {
+            cells = 2;
+        }
+
+        // wide characters are not split across rows
+        if ((cells == 2) && (*col == width - 1)) {
+            (*row)++;
+            *col = 0;
+        }
+
+        *col += cells;
+        while (*col >= width) {
+            (*row)++;
+            *col -= width;
+        }
+    }
 }
 
 void
 win_redraw(ProfWin *window)
 {
     int i, size;
+    window->unprinted = 0;
+    if (window->win == NULL) {
+        return;
+    }
+    if (window->scrollback != NULL) {
+        scrollback_reset(window->scrollback);
+    }
+
     werase(window->win);
     size = buffer_size(window->buffer);
 
-    for (i = 0; i < size; i++) {
+    // entries from before the last /clear stay hidden
+    int cleared = window->cleared - (buffer_pushed(window->buffer) - size);
+    if (cleared < 0) {
+        cleared = 0;
+    }
+
+    // entries that would scroll off the top of the pad are not printed,
+    // start at the first whole line that fits
+    int width = getmaxx(window->win);
+    int total = 0;
+    int col = 0;
+    for (i = cleared; i < size; i++) {
+        ProfBuffEntry *e = buffer_yield_entry(window->buffer, i);
+        win_layout_entry(e, width, col);
+        total += e->rows;
+        col = e->end_col;
+    }
+
+    int first = cleared;
+    int row = 0;
+    col = 0;
+    while ((first < size) && ((col != 0) || (total - row > PAD_SIZE - 1))) {
+        ProfBuffEntry *e = buffer_yield_entry(window->buffer, first);
+        row += e->rows;
+        col = e->end_col;
+        first++;
+    }
+    window->trimmed = (first > 0) || (window->cleared > 0);
+
+    for (i = first; i < size; i++) {
+        ProfBuffEntry *e = buffer_yield_entry(window->buffer, i);
+        _win_print(window, e->show_char, e->date_fmt, e->flags, e->attrs, e->from, e->message);
+    }
+}
+
+/*
+ * Print entries added to the buffer since the window was last printed,
+ * entries already dropped from the buffer are skipped
+ */
+void
+win_print_pending(ProfWin *window)
+{
+    // redrawn from the buffer when leaving the scrollback
+    if ((window->win == NULL) || scrollback_showing(window->scrollback)) {
+        window->unprinted = 0;
+        return;
+    }
+
+    int size = buffer_size(window->buffer);
+    int i = window->unprinted > size ? 0 : size - window->unprinted;
+
+    for (; i < size; i++) {
         ProfBuffEntry *e = buffer_yield_entry(window->buffer, i);
         _win_print(window, e->show_char, e->date_fmt, e->flags, e->attrs, e->from, e->message);
     }
+    window->unprinted = 0;
+}
+
+/*
+ * Show lines read from the logs in place of the window contents
+ */
+void
+win_show_scrollback(ProfWin *window, GSList *lines)
+{
+    werase(window->win);
+
+    GSList *curr = lines;
+    while (curr != NULL) {
+        _win_print(window, '-', "", NO_DATE, 0, "", curr->data);
+        curr = g_slist_next(curr);
+    }
+    window->unprinted = 0;
+}
+
+/*
+ * Empty the window, what is in the buffer so far is not shown again
+ */
+void
+win_clear(ProfWin *window)
+{
+    if (window->win != NULL) {
+        werase(window->win);
+    }
+    window->unprinted = 0;
+    window->paged = 0;
+    window->y_pos = 0;
+    window->cleared = buffer_pushed(window->buffer);
+
+    // cleared lines are only in the logs now
+    window->trimmed = TRUE;
+}
+
+static int
+_buffer_size(win_type_t type)
+{
+    switch (type)
+    {
+        case WIN_CONSOLE:
+            return prefs_get_buffer_console();
+        case WIN_CHAT:
+        case WIN_PRIVATE:
+            return prefs_get_buffer_chat();
+        case WIN_MUC:
+            return prefs_get_buffer_muc();
+        default:
+            return BUFF_SIZE_DEFAULT;
+    }
 }
@@ -45,6 +45,7 @@
 
 #include "contact.h"
 #include "ui/buffer.h"
+#include "ui/scrollback.h"
 #include "xmpp/xmpp.h"
 
 #define NO_ME   1
@@ -62,12 +63,13 @@ typedef enum {
     WIN_MUC_CONFIG,
     WIN_PRIVATE,
     WIN_DUCK,
-    WIN_XML
+    WIN_XML,
+    WIN_SEARCH
 } win_type_t;
 
 typedef struct prof_win_t {
     char *from;
-    WINDOW *win;
+    WINDOW *win;        // NULL unless the window is current
     ProfBuff buffer;
     win_type_t type;
     gboolean is_otr;
@@ -76,11 +78,18 @@ typedef struct prof_win_t {
     int paged;
     int unread;
     int history_shown;
+    int unprinted;
+    gboolean trimmed;           // lines lost off the top of the pad
+    int cleared;                // buffer_pushed when last cleared
+    ChatLogPos log_start;       // log position of the first line shown
+    ProfScrollback scrollback;  // NULL until scrolled past the pad
     DataForm *form;
 } ProfWin;
 
-ProfWin* win_create(const char * const title, int cols, win_type_t type);
+ProfWin* win_create(const char * const title, win_type_t type);
 void win_free(ProfWin *window);
+void win_show(ProfWin *window);
+void win_hide(ProfWin *window);
 void win_update_virtual(ProfWin *window);
 void win_move_to_end(ProfWin *window);
 int  win_presence_colour(const char * const presence);
@@ -97,5 +106,9 @@ void win_save_print(ProfWin *window, const char show_char, GTimeVal *tstamp, int
 void win_save_println(ProfWin *window, const char * const message);
 void win_save_newline(ProfWin *window);
 void win_redraw(ProfWin *window);
+void win_layout_entry(ProfBuffEntry *e, int width, int start_col);
+void win_print_pending(ProfWin *window);
+void win_show_scrollback(ProfWin *window, GSList *lines);
+void win_clear(ProfWin *window);
 
 #endif
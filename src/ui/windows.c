@@ -58,18 +58,32 @@ static GHashTable *windows;
 static int current;
 static int max_cols;
 
+// the only window with a pad, NULL when none shown
+static ProfWin *shown;
+
+// indexes kept in sync with windows, recipient to window, window to num
+static GHashTable *recipient_index;
+static GHashTable *num_index;
+
+static void _index_add(int num, ProfWin *window);
+static void _index_remove(ProfWin *window);
+static void _set_current(int num);
+
 void
 wins_init(void)
 {
     windows = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
         (GDestroyNotify)win_free);
+    recipient_index = g_hash_table_new(g_str_hash, g_str_equal);
+    num_index = g_hash_table_new(g_direct_hash, g_direct_equal);
 
     max_cols = getmaxx(stdscr);
-    int cols = getmaxx(stdscr);
-    ProfWin *console = win_create(CONS_WIN_TITLE, cols, WIN_CONSOLE);
+    ProfWin *console = win_create(CONS_WIN_TITLE, WIN_CONSOLE);
     g_hash_table_insert(windows, GINT_TO_POINTER(1), console);
+    _index_add(1, console);
 
-    current = 1;
+    shown = NULL;
+    _set_current(1);
 }
 
 ProfWin *
@@ -98,7 +112,7 @@ void
 wins_set_current_by_num(int i)
 {
     if (g_hash_table_lookup(windows, GINT_TO_POINTER(i)) != NULL) {
-        current = i;
+        _set_current(i);
     }
 }
 
@@ -170,40 +184,22 @@ wins_get_previous(void)
 ProfWin *
 wins_get_by_recipient(const char * const recipient)
 {
-    GList *values = g_hash_table_get_values(windows);
-    GList *curr = values;
-
-    while (curr != NULL) {
-        ProfWin *window = curr->data;
-        if (g_strcmp0(window->from, recipient) == 0) {
-            g_list_free(values);
-            return window;
-        }
-        curr = g_list_next(curr);
+    if (recipient == NULL) {
+        return NULL;
     }
 
-    g_list_free(values);
-    return NULL;
+    return g_hash_table_lookup(recipient_index, recipient);
 }
 
 int
 wins_get_num(ProfWin *window)
 {
-    GList *keys = g_hash_table_get_keys(windows);
-    GList *curr = keys;
-
-    while (curr != NULL) {
-        gconstpointer num_p = curr->data;
-        ProfWin *curr_win = g_hash_table_lookup(windows, num_p);
-        if (g_strcmp0(curr_win->from, window->from) == 0) {
-            g_list_free(keys);
-            return GPOINTER_TO_INT(num_p);
-        }
-        curr = g_list_next(curr);
+    gpointer num_p;
+    if (g_hash_table_lookup_extended(num_index, window, NULL, &num_p)) {
+        return GPOINTER_TO_INT(num_p);
+    } else {
+        return -1;
     }
-
-    g_list_free(keys);
-    return -1;
 }
 
 int
@@ -226,11 +222,16 @@ wins_close_by_num(int i)
 
         // go to console if closing current window
         if (i == current) {
-            current = 1;
-            ProfWin *window = wins_get_current();
-            win_update_virtual(window);
+            _set_current(1);
         }
 
+        ProfWin *window = g_hash_table_lookup(windows, GINT_TO_POINTER(i));
+        if (window != NULL) {
+            _index_remove(window);
+            if (window == shown) {
+                shown = NULL;
+            }
+        }
         g_hash_table_remove(windows, GINT_TO_POINTER(i));
         status_bar_inactive(i);
     }
@@ -240,8 +241,7 @@ void
 wins_clear_current(void)
 {
     ProfWin *window = wins_get_current();
-    werase(window->win);
-    win_update_virtual(window);
+    win_clear(window);
 }
 
 gboolean
@@ -261,9 +261,9 @@ wins_new(const char * const from, win_type_t type)
 {
     GList *keys = g_hash_table_get_keys(windows);
     int result = get_next_available_win_num(keys);
-    int cols = getmaxx(stdscr);
-    ProfWin *new = win_create(from, cols, type);
+    ProfWin *new = win_create(from, type);
     g_hash_table_insert(windows, GINT_TO_POINTER(result), new);
+    _index_add(result, new);
     g_list_free(keys);
     return new;
 }
@@ -287,22 +287,8 @@ wins_get_total_unread(void)
 void
 wins_resize_all(void)
 {
-    int rows, cols;
-    getmaxyx(stdscr, rows, cols);
-
-    GList *values = g_hash_table_get_values(windows);
-    GList *curr = values;
-    while (curr != NULL) {
-      ProfWin *window = curr->data;
-      wresize(window->win, PAD_SIZE, cols);
-      win_redraw(window);
-      curr = g_list_next(curr);
-    }
-    g_list_free(values);
-
-    ProfWin *current_win = wins_get_current();
-
-    pnoutrefresh(current_win->win, current_win->y_pos, 0, 1, 0, rows-3, cols-1);
+    // only the current window has a pad, others are drawn when shown
+    win_show(wins_get_current());
 }
 
 gboolean
@@ -380,6 +366,22 @@ wins_get_chat_recipients(void)
     return result;
 }
 
+gboolean
+wins_has_chat_recipients(void)
+{
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, windows);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        ProfWin *window = value;
+        if (window->type == WIN_CHAT) {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
 GSList *
 wins_get_prune_recipients(void)
 {
@@ -412,11 +414,6 @@ wins_lost_connection(void)
         ProfWin *window = curr->data;
         if (window->type != WIN_CONSOLE) {
             win_save_print(window, '-', NULL, 0, COLOUR_ERROR, "", "Lost connection.");
-
-            // if current win, set current_win_dirty
-            if (wins_is_current(window)) {
-                win_update_virtual(window);
-            }
         }
         curr = g_list_next(curr);
     }
@@ -436,6 +433,7 @@ wins_swap(int source_win, int target_win)
             g_hash_table_steal(windows, GINT_TO_POINTER(source_win));
             status_bar_inactive(source_win);
             g_hash_table_insert(windows, GINT_TO_POINTER(target_win), source);
+            g_hash_table_insert(num_index, source, GINT_TO_POINTER(target_win));
             if (source->unread > 0) {
                 status_bar_new(target_win);
             } else {
@@ -452,6 +450,8 @@ wins_swap(int source_win, int target_win)
             g_hash_table_steal(windows, GINT_TO_POINTER(target_win));
             g_hash_table_insert(windows, GINT_TO_POINTER(source_win), target);
             g_hash_table_insert(windows, GINT_TO_POINTER(target_win), source);
+            g_hash_table_insert(num_index, target, GINT_TO_POINTER(source_win));
+            g_hash_table_insert(num_index, source, GINT_TO_POINTER(target_win));
             if (source->unread > 0) {
                 status_bar_new(target_win);
             } else {
@@ -503,6 +503,7 @@ wins_tidy(void)
             ProfWin *window = g_hash_table_lookup(windows, curr->data);
             if (num == 10) {
                 g_hash_table_insert(new_windows, GINT_TO_POINTER(0), window);
+                g_hash_table_insert(num_index, window, GINT_TO_POINTER(0));
                 if (window->unread > 0) {
                     status_bar_new(0);
                 } else {
@@ -510,6 +511,7 @@ wins_tidy(void)
                 }
             } else {
                 g_hash_table_insert(new_windows, GINT_TO_POINTER(num), window);
+                g_hash_table_insert(num_index, window, GINT_TO_POINTER(num));
                 if (window->unread > 0) {
                     status_bar_new(num);
                 } else {
@@ -520,6 +522,8 @@ wins_tidy(void)
             curr = g_list_next(curr);
         }
 
+        g_hash_table_steal_all(windows);
+        g_hash_table_destroy(windows);
         windows = new_windows;
         current = 1;
         ui_switch_win(1);
@@ -550,6 +554,7 @@ wins_create_summary(void)
         GString *muc_config_string;
         GString *duck_string;
         GString *xml_string;
+        GString *search_string;
 
         switch (window->type)
         {
@@ -642,6 +647,14 @@ wins_create_summary(void)
 
                 break;
 
+            case WIN_SEARCH:
+                search_string = g_string_new("");
+                g_string_printf(search_string, "%d: Log search", ui_index);
+                result = g_slist_append(result, strdup(search_string->str));
+                g_string_free(search_string, TRUE);
+
+                break;
+
             default:
                 break;
         }
@@ -655,5 +668,39 @@ wins_create_summary(void)
 void
 wins_destroy(void)
 {
+    g_hash_table_destroy(recipient_index);
+    g_hash_table_destroy(num_index);
     g_hash_table_destroy(windows);
+    shown = NULL;
+}
+
+static void
+_set_current(int num)
+{
+    ProfWin *window = g_hash_table_lookup(windows, GINT_TO_POINTER(num));
+    if ((shown != NULL) && (shown != window)) {
+        win_hide(shown);
+    }
+    current = num;
+    shown = window;
+    win_show(window);
+}
+
+static void
+_index_add(int num, ProfWin *window)
+{
+    if (window->from != NULL) {
+        g_hash_table_insert(recipient_index, window->from, window);
+    }
+    g_hash_table_insert(num_index, window, GINT_TO_POINTER(num));
+}
+
+static void
+_index_remove(ProfWin *window)
+{
+    if ((window->from != NULL) &&
+            (g_hash_table_lookup(recipient_index, window->from) == window)) {
+        g_hash_table_remove(recipient_index, window->from);
+    }
+    g_hash_table_remove(num_index, window);
 }
@@ -54,6 +54,7 @@ int wins_get_total_unread(void);
 void wins_resize_all(void);
 gboolean wins_duck_exists(void);
 GSList * wins_get_chat_recipients(void);
+gboolean wins_has_chat_recipients(void);
 GSList * wins_get_prune_recipients(void);
 void wins_lost_connection(void);
 gboolean wins_tidy(void);
@@ -45,78 +45,147 @@
 #include <strophe.h>
 
 #include "common.h"
+#include "contact.h"
+#include "jid.h"
 #include "log.h"
+#include "roster_list.h"
 #include "xmpp/xmpp.h"
 #include "xmpp/stanza.h"
 #include "xmpp/form.h"
 #include "xmpp/capabilities.h"
+#include "xmpp/capscache.h"
+#include "tools/sha1.h"
 
-static gchar *cache_loc;
-static GKeyFile *cache;
+// compact the cache once no more entries have arrived for this long
+#define CACHE_COMPACT_DELAY_MS 2000
 
-static GHashTable *jid_lookup;
+// try the next contact when a disco#info request gets no answer in time
+#define CAPS_REQUEST_TIMEOUT_SECS 10
+
+static CapsCache cache = NULL;
+static guint compact_source = 0;
+
+// a disco#info request for a ver, shared by every jid advertising it
+typedef struct caps_request_t {
+    char *ver;
+    char *node;
+    char *id;
+    GPtrArray *jids;
+    guint tried;
+    guint timeout;
+} CapsRequest;
+
+// requests waiting for an answer by ver
+static GHashTable *requests;
 
-static char *my_sha1;
+static GHashTable *jid_lookup;
 
-static void _caps_destroy(Capabilities *caps);
-static gchar* _get_cache_file(void);
-static void _save_cache(void);
+// parsed entries by ver, each holding a reference
+static GHashTable *caps_table;
+
+// our own ver only changes between builds, so it outlives connections
+static char *my_sha1 = NULL;
+
+// verification strings start out at this size, most responses fit
+#define VER_STR_SIZE 2048
+
+// a data form in a disco#info response, by its FORM_TYPE in ver_scratch
+typedef struct caps_form_t {
+    gsize type;
+    xmpp_stanza_t *stanza;
+} CapsForm;
+
+static GString *ver_str = NULL;
+static GString *ver_scratch = NULL;
+static GPtrArray *ver_identities = NULL;
+static GPtrArray *ver_features = NULL;
+static GPtrArray *ver_fields = NULL;
+static GPtrArray *ver_values = NULL;
+static GArray *ver_forms = NULL;
+
+// dense ids for every feature in a bitset so far, by interned string
+static GHashTable *feature_ids = NULL;
+static guint num_feature_ids = 0;
+
+static Capabilities * _caps_new(void);
+static Capabilities * _caps_ref(Capabilities *caps);
+static void _caps_unref(Capabilities *caps);
+static void _caps_set_features(Capabilities *caps, GPtrArray *features);
+static int _compare_features(const void *a, const void *b);
+static void _sort_strings(GPtrArray *strings);
+static void _append_attr(GString *str, xmpp_stanza_t * const stanza,
+    const char * const attr);
+static gboolean _append_text(GString *str, xmpp_stanza_t * const stanza);
+static gboolean _append_form_type(GString *str, xmpp_stanza_t * const form);
+static void _append_form_fields(GString *str, xmpp_stanza_t * const form);
+static gint _compare_forms(gconstpointer a, gconstpointer b, gpointer scratch);
+static int _compare_field_vars(const void *a, const void *b);
+static void _caps_set_feature_bits(Capabilities *caps);
+static gboolean _caps_test_feature(Capabilities *caps, const gchar *feature);
+static GSList * _jid_entries(const char * const jid);
+static gchar* _get_cache_file(const char * const name);
+static void _import_keyfile(const char * const keyfile_loc);
+static Capabilities * _caps_from_keyfile(GKeyFile *keyfile, const char * const ver);
+static void _compact_cache(void);
+static gboolean _compact_source_fired(gpointer data);
 static Capabilities * _caps_get(const char * const caps_str);
+static void _request_send_next(CapsRequest *request);
+static gboolean _request_timed_out(gpointer data);
+static void _request_free(CapsRequest *request);
 
 void
 caps_init(void)
 {
     log_info("Loading capabilities cache");
-    cache_loc = _get_cache_file();
+    if (cache != NULL) {
+        capscache_close(cache);
+        g_hash_table_destroy(caps_table);
+        g_hash_table_destroy(requests);
+    }
 
-    cache = g_key_file_new();
-    g_key_file_load_from_file(cache, cache_loc, G_KEY_FILE_KEEP_COMMENTS,
-        NULL);
+    gchar *cache_loc = _get_cache_file("capscache.bin");
+    gboolean import = !g_file_test(cache_loc, G_FILE_TEST_EXISTS);
+    cache = capscache_open(cache_loc);
+    g_free(cache_loc);
 
-    jid_lookup = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    // move entries over from the text cache used by earlier versions
+    if (import) {
+        gchar *keyfile_loc = _get_cache_file("capscache");
+        if (g_file_test(keyfile_loc, G_FILE_TEST_EXISTS)) {
+            _import_keyfile(keyfile_loc);
+        }
+        g_free(keyfile_loc);
+    }
+
+    if (capscache_needs_compact(cache)) {
+        _compact_cache();
+    }
 
-    my_sha1 = NULL;
+    jid_lookup = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    caps_table = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+        (GDestroyNotify)_caps_unref);
+    requests = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+        (GDestroyNotify)_request_free);
+
+    // ids stay valid for as long as the process runs, bitsets built from
+    // them may outlive the tables
+    if (feature_ids == NULL) {
+        feature_ids = g_hash_table_new(g_direct_hash, g_direct_equal);
+    }
 }
 
 void
 caps_add(const char * const ver, Capabilities *caps)
 {
-    gboolean cached = g_key_file_has_group(cache, ver);
-    if (!cached) {
-        if (caps->name) {
-            g_key_file_set_string(cache, ver, "name", caps->name);
-        }
-        if (caps->category) {
-            g_key_file_set_string(cache, ver, "category", caps->category);
-        }
-        if (caps->type) {
-            g_key_file_set_string(cache, ver, "type", caps->type);
-        }
-        if (caps->software) {
-            g_key_file_set_string(cache, ver, "software", caps->software);
-        }
-        if (caps->software_version) {
-            g_key_file_set_string(cache, ver, "software_version", caps->software_version);
-        }
-        if (caps->os) {
-            g_key_file_set_string(cache, ver, "os", caps->os);
-        }
-        if (caps->os_version) {
-            g_key_file_set_string(cache, ver, "os_version", caps->os_version);
-        }
-        if (caps->features) {
-            GSList *curr_feature = caps->features;
-            int num = g_slist_length(caps->features);
-            const gchar* features_list[num];
-            int curr = 0;
-            while (curr_feature) {
-                features_list[curr++] = curr_feature->data;
-                curr_feature = g_slist_next(curr_feature);
-            }
-            g_key_file_set_string_list(cache, ver, "features", features_list, num);
+    if (!capscache_contains(cache, ver)) {
+        capscache_add(cache, ver, caps);
+        if (capscache_needs_compact(cache)) {
+            _compact_cache();
         }
+    }
 
-        _save_cache();
+    if (!g_hash_table_contains(caps_table, ver)) {
+        g_hash_table_insert(caps_table, strdup(ver), _caps_ref(caps));
     }
 }
 
@@ -129,83 +198,118 @@ caps_map(const char * const jid, const char * const ver)
 gboolean
 caps_contains(const char * const caps_ver)
 {
-    return (g_key_file_has_group(cache, caps_ver));
+    return (g_hash_table_contains(caps_table, caps_ver) ||
+        capscache_contains(cache, caps_ver));
 }
 
-static Capabilities *
-_caps_get(const char * const caps_str)
+/*
+ * Ask jid for the capabilities behind ver. Only one request per ver is sent
+ * at a time, jids advertising a ver already asked for wait for its answer.
+ */
+void
+caps_request(const char * const jid, const char * const node,
+    const char * const ver)
 {
-    if (g_key_file_has_group(cache, caps_str)) {
-        Capabilities *new_caps = malloc(sizeof(struct capabilities_t));
-
-        char *category = g_key_file_get_string(cache, caps_str, "category", NULL);
-        if (category) {
-            new_caps->category = strdup(category);
-        } else {
-            new_caps->category = NULL;
-        }
+    if (node == NULL) {
+        log_error("Could not create caps request, no node");
+        return;
+    }
 
-        char *type = g_key_file_get_string(cache, caps_str, "type", NULL);
-        if (type) {
-            new_caps->type = strdup(type);
-        } else {
-            new_caps->type = NULL;
+    CapsRequest *request = g_hash_table_lookup(requests, ver);
+    if (request != NULL) {
+        guint i;
+        for (i = 0; i < request->jids->len; i++) {
+            if (g_strcmp0(g_ptr_array_index(request->jids, i), jid) == 0) {
+                return;
+            }
         }
+        log_debug("Capabilities request for %s pending, %s waiting", ver, jid);
+        g_ptr_array_add(request->jids, strdup(jid));
+        return;
+    }
 
-        char *name = g_key_file_get_string(cache, caps_str, "name", NULL);
-        if (name) {
-            new_caps->name = strdup(name);
-        } else {
-            new_caps->name = NULL;
-        }
+    request = malloc(sizeof(CapsRequest));
+    request->ver = strdup(ver);
+    request->node = strdup(node);
+    request->id = NULL;
+    request->jids = g_ptr_array_new_with_free_func(free);
+    g_ptr_array_add(request->jids, strdup(jid));
+    request->tried = 0;
+    request->timeout = 0;
+    g_hash_table_insert(requests, request->ver, request);
+
+    _request_send_next(request);
+}
 
-        char *software = g_key_file_get_string(cache, caps_str, "software", NULL);
-        if (software) {
-            new_caps->software = strdup(software);
-        } else {
-            new_caps->software = NULL;
+/*
+ * A valid answer for ver was stored, map every jid that was waiting for it
+ */
+void
+caps_request_complete(const char * const ver)
+{
+    CapsRequest *request = g_hash_table_lookup(requests, ver);
+    if (request != NULL) {
+        guint i;
+        for (i = 0; i < request->jids->len; i++) {
+            caps_map(g_ptr_array_index(request->jids, i), ver);
         }
+        g_hash_table_remove(requests, ver);
+    }
+}
 
-        char *software_version = g_key_file_get_string(cache, caps_str, "software_version", NULL);
-        if (software_version) {
-            new_caps->software_version = strdup(software_version);
-        } else {
-            new_caps->software_version = NULL;
+/*
+ * The request with id got an error or an invalid answer, ask the next jid
+ */
+void
+caps_request_failed(const char * const id)
+{
+    GHashTableIter iter;
+    gpointer ver, value;
+    g_hash_table_iter_init(&iter, requests);
+    while (g_hash_table_iter_next(&iter, &ver, &value)) {
+        CapsRequest *request = value;
+        if (g_strcmp0(request->id, id) == 0) {
+            _request_send_next(request);
+            return;
         }
+    }
+}
 
-        char *os = g_key_file_get_string(cache, caps_str, "os", NULL);
-        if (os) {
-            new_caps->os = strdup(os);
-        } else {
-            new_caps->os = NULL;
-        }
+/*
+ * Forget every pending request, their ids mean nothing to the next session
+ */
+void
+caps_requests_clear(void)
+{
+    if (requests != NULL) {
+        g_hash_table_remove_all(requests);
+    }
+}
 
-        char *os_version = g_key_file_get_string(cache, caps_str, "os_version", NULL);
-        if (os_version) {
-            new_caps->os_version = strdup(os_version);
-        } else {
-            new_caps->os_version = NULL;
-        }
+/*
+ * Find the entry for a ver, reading it from the cache file the first time it
+ * is needed. The entry is owned by the table.
+ */
+static Capabilities *
+_caps_get(const char * const caps_str)
+{
+    Capabilities *caps = g_hash_table_lookup(caps_table, caps_str);
+    if (caps != NULL) {
+        return caps;
+    }
 
-        gsize features_len = 0;
-        gchar **features = g_key_file_get_string_list(cache, caps_str, "features", &features_len, NULL);
-        if (features != NULL && features_len > 0) {
-            GSList *features_list = NULL;
-            int i;
-            for (i = 0; i < features_len; i++) {
-                features_list = g_slist_append(features_list, strdup(features[i]));
-            }
-            new_caps->features = features_list;
-            g_strfreev(features);
-        } else {
-            new_caps->features = NULL;
-        }
-        return new_caps;
-    } else {
-        return NULL;
+    caps = capscache_get(cache, caps_str);
+    if (caps != NULL) {
+        g_hash_table_insert(caps_table, strdup(caps_str), caps);
     }
+
+    return caps;
 }
 
+/*
+ * Returns a reference to the shared entry for a jid, which must not be
+ * changed and is released with caps_unref
+ */
 static Capabilities *
 _caps_lookup(const char * const jid)
 {
@@ -213,119 +317,178 @@ _caps_lookup(const char * const jid)
     if (ver) {
         Capabilities *caps = _caps_get(ver);
         if (caps) {
-            return caps;
+            return _caps_ref(caps);
         }
     }
 
     return NULL;
 }
 
+static gboolean
+_caps_jid_known(const char * const jid)
+{
+    GSList *entries = _jid_entries(jid);
+    gboolean result = (entries != NULL);
+    g_slist_free(entries);
+
+    return result;
+}
+
+/*
+ * Whether jid advertised feature, a bare jid asks each available resource.
+ * FALSE when nothing is known about jid, see caps_jid_known.
+ */
+static gboolean
+_caps_jid_supports(const char * const jid, const char * const feature)
+{
+    // nobody advertised a string that was never interned
+    GQuark quark = g_quark_try_string(feature);
+    if (quark == 0) {
+        return FALSE;
+    }
+    const gchar *interned = g_quark_to_string(quark);
+
+    gboolean result = FALSE;
+    GSList *entries = _jid_entries(jid);
+    GSList *curr = entries;
+    while (curr != NULL && !result) {
+        result = _caps_test_feature(curr->data, interned);
+        curr = g_slist_next(curr);
+    }
+    g_slist_free(entries);
+
+    return result;
+}
+
+/*
+ * The entries owned by the table for a full jid, or for every available
+ * resource of a bare jid
+ */
+static GSList *
+_jid_entries(const char * const jid)
+{
+    GSList *result = NULL;
+
+    if (strchr(jid, '/') != NULL) {
+        char *ver = g_hash_table_lookup(jid_lookup, jid);
+        Capabilities *caps = ver ? _caps_get(ver) : NULL;
+        if (caps != NULL) {
+            result = g_slist_append(result, caps);
+        }
+        return result;
+    }
+
+    PContact contact = roster_get_contact(jid);
+    if (contact == NULL) {
+        return NULL;
+    }
+
+    GList *resources = p_contact_get_available_resources(contact);
+    GList *curr = resources;
+    while (curr != NULL) {
+        Resource *resource = curr->data;
+        char *fulljid = create_fulljid(jid, resource->name);
+        char *ver = g_hash_table_lookup(jid_lookup, fulljid);
+        Capabilities *caps = ver ? _caps_get(ver) : NULL;
+        if (caps != NULL) {
+            result = g_slist_append(result, caps);
+        }
+        free(fulljid);
+        curr = g_list_next(curr);
+    }
+    g_list_free(resources);
+
+    return result;
+}
+
+/*
+ * Build the XEP-0115 verification string for a disco#info query and hash it.
+ * The string and the sort arrays are reused between calls, so checking a
+ * response does not allocate once they have grown to fit.
+ */
 char *
 caps_create_sha1_str(xmpp_stanza_t * const query)
 {
-    char *category = NULL;
-    char *type = NULL;
-    char *lang = NULL;
-    char *name = NULL;
-    char *feature_str = NULL;
-    GSList *identities = NULL;
-    GSList *features = NULL;
-    GSList *form_names = NULL;
-    DataForm *form = NULL;
-    FormField *field = NULL;
-    GHashTable *forms = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify)form_destroy);
-
+    if (ver_str == NULL) {
+        ver_str = g_string_sized_new(VER_STR_SIZE);
+        ver_scratch = g_string_sized_new(VER_STR_SIZE);
+        ver_identities = g_ptr_array_new();
+        ver_features = g_ptr_array_new();
+        ver_fields = g_ptr_array_new();
+        ver_values = g_ptr_array_new();
+        ver_forms = g_array_new(FALSE, FALSE, sizeof(CapsForm));
+    }
+    g_string_truncate(ver_str, 0);
+    g_string_truncate(ver_scratch, 0);
+    g_ptr_array_set_size(ver_identities, 0);
+    g_ptr_array_set_size(ver_features, 0);
+    g_array_set_size(ver_forms, 0);
+
+    // identities are formatted into the scratch buffer, by offset until it
+    // stops growing
     xmpp_stanza_t *child = xmpp_stanza_get_children(query);
     while (child) {
-        if (g_strcmp0(xmpp_stanza_get_name(child), STANZA_NAME_IDENTITY) == 0) {
-            category = xmpp_stanza_get_attribute(child, "category");
-            type = xmpp_stanza_get_attribute(child, "type");
-            lang = xmpp_stanza_get_attribute(child, "xml:lang");
-            name = xmpp_stanza_get_attribute(child, "name");
-
-            GString *identity_str = g_string_new(category);
-            g_string_append(identity_str, "/");
-            if (type) {
-                g_string_append(identity_str, type);
-            }
-            g_string_append(identity_str, "/");
-            if (lang) {
-                g_string_append(identity_str, lang);
+        const char *child_name = xmpp_stanza_get_name(child);
+        if (g_strcmp0(child_name, STANZA_NAME_IDENTITY) == 0) {
+            g_ptr_array_add(ver_identities, GSIZE_TO_POINTER(ver_scratch->len));
+            _append_attr(ver_scratch, child, "category");
+            g_string_append_c(ver_scratch, '/');
+            _append_attr(ver_scratch, child, "type");
+            g_string_append_c(ver_scratch, '/');
+            _append_attr(ver_scratch, child, "xml:lang");
+            g_string_append_c(ver_scratch, '/');
+            _append_attr(ver_scratch, child, "name");
+            g_string_append(ver_scratch, "<");
+            g_string_append_c(ver_scratch, '\0');
+        } else if (g_strcmp0(child_name, STANZA_NAME_FEATURE) == 0) {
+            char *feature = xmpp_stanza_get_attribute(child, "var");
+            if (feature) {
+                g_ptr_array_add(ver_features, feature);
             }
-            g_string_append(identity_str, "/");
-            if (name) {
-                g_string_append(identity_str, name);
-            }
-            g_string_append(identity_str, "<");
-            identities = g_slist_insert_sorted(identities, g_strdup(identity_str->str), (GCompareFunc)strcmp);
-            g_string_free(identity_str, TRUE);
-        } else if (g_strcmp0(xmpp_stanza_get_name(child), STANZA_NAME_FEATURE) == 0) {
-            feature_str = xmpp_stanza_get_attribute(child, "var");
-            features = g_slist_insert_sorted(features, g_strdup(feature_str), (GCompareFunc)strcmp);
-        } else if (g_strcmp0(xmpp_stanza_get_name(child), STANZA_NAME_X) == 0) {
+        } else if (g_strcmp0(child_name, STANZA_NAME_X) == 0) {
             if (g_strcmp0(xmpp_stanza_get_ns(child), STANZA_NS_DATA) == 0) {
-                form = form_create(child);
-                char *form_type = form_get_form_type_field(form);
-                form_names = g_slist_insert_sorted(form_names, g_strdup(form_type), (GCompareFunc)strcmp);
-                g_hash_table_insert(forms, g_strdup(form_type), form);
+                // forms without a FORM_TYPE are left out
+                CapsForm form;
+                form.type = ver_scratch->len;
+                form.stanza = child;
+                if (_append_form_type(ver_scratch, child)) {
+                    g_string_append_c(ver_scratch, '\0');
+                    g_array_append_val(ver_forms, form);
+                } else {
+                    g_string_truncate(ver_scratch, form.type);
+                }
             }
         }
         child = xmpp_stanza_get_next(child);
     }
 
-    GString *s = g_string_new("");
-
-    GSList *curr = identities;
-    while (curr) {
-        g_string_append(s, curr->data);
-        curr = g_slist_next(curr);
+    guint i;
+    for (i = 0; i < ver_identities->len; i++) {
+        ver_identities->pdata[i] = ver_scratch->str + GPOINTER_TO_SIZE(ver_identities->pdata[i]);
     }
-
-    curr = features;
-    while (curr) {
-        g_string_append(s, curr->data);
-        g_string_append(s, "<");
-        curr = g_slist_next(curr);
+    _sort_strings(ver_identities);
+    for (i = 0; i < ver_identities->len; i++) {
+        g_string_append(ver_str, g_ptr_array_index(ver_identities, i));
     }
 
-    curr = form_names;
-    while (curr) {
-        form = g_hash_table_lookup(forms, curr->data);
-        char *form_type = form_get_form_type_field(form);
-        g_string_append(s, form_type);
-        g_string_append(s, "<");
-
-        GSList *sorted_fields = form_get_non_form_type_fields_sorted(form);
-        GSList *curr_field = sorted_fields;
-        while (curr_field) {
-            field = curr_field->data;
-            g_string_append(s, field->var);
-            g_string_append(s, "<");
-
-            GSList *sorted_values = form_get_field_values_sorted(field);
-            GSList *curr_value = sorted_values;
-            while (curr_value) {
-                g_string_append(s, curr_value->data);
-                g_string_append(s, "<");
-                curr_value = g_slist_next(curr_value);
-            }
-            g_slist_free(sorted_values);
-            curr_field = g_slist_next(curr_field);
-        }
-        g_slist_free(sorted_fields);
-
-        curr = g_slist_next(curr);
+    _sort_strings(ver_features);
+    for (i = 0; i < ver_features->len; i++) {
+        g_string_append(ver_str, g_ptr_array_index(ver_features, i));
+        g_string_append_c(ver_str, '<');
     }
 
-    char *result = p_sha1_hash(s->str);
+    g_array_sort_with_data(ver_forms, _compare_forms, ver_scratch);
+    for (i = 0; i < ver_forms->len; i++) {
+        CapsForm *form = &g_array_index(ver_forms, CapsForm, i);
+        g_string_append(ver_str, ver_scratch->str + form->type);
+        g_string_append_c(ver_str, '<');
+        _append_form_fields(ver_str, form->stanza);
+    }
 
-    g_string_free(s, TRUE);
-    g_slist_free_full(identities, g_free);
-    g_slist_free_full(features, g_free);
-    g_slist_free_full(form_names, g_free);
-    g_hash_table_destroy(forms);
+    unsigned char digest[SHA1_DIGEST_SIZE];
+    sha1_digest(ver_str->str, ver_str->len, digest);
 
-    return result;
+    return g_base64_encode(digest, sizeof(digest));
 }
 
 Capabilities *
@@ -338,7 +501,7 @@ caps_create(xmpp_stanza_t *query)
     char *software_version = NULL;
     char *os = NULL;
     char *os_version = NULL;
-    GSList *features = NULL;
+    GPtrArray *features = g_ptr_array_new();
 
     xmpp_stanza_t *softwareinfo = xmpp_stanza_get_child_by_ns(query, STANZA_NS_DATA);
     if (softwareinfo != NULL) {
@@ -352,13 +515,13 @@ caps_create(xmpp_stanza_t *query)
                 formField = field->data;
                 if (formField->values != NULL) {
                     if (strcmp(formField->var, "software") == 0) {
-                        software = strdup(formField->values->data);
+                        software = g_strdup(formField->values->data);
                     } else if (strcmp(formField->var, "software_version") == 0) {
-                        software_version = strdup(formField->values->data);
+                        software_version = g_strdup(formField->values->data);
                     } else if (strcmp(formField->var, "os") == 0) {
-                        os = strdup(formField->values->data);
+                        os = g_strdup(formField->values->data);
                     } else if (strcmp(formField->var, "os_version") == 0) {
-                        os_version = strdup(formField->values->data);
+                        os_version = g_strdup(formField->values->data);
                     }
                 }
                 field = g_slist_next(field);
@@ -372,7 +535,10 @@ caps_create(xmpp_stanza_t *query)
     GSList *identity_stanzas = NULL;
     while (child != NULL) {
         if (g_strcmp0(xmpp_stanza_get_name(child), "feature") == 0) {
-            features = g_slist_append(features, strdup(xmpp_stanza_get_attribute(child, "var")));
+            char *var = xmpp_stanza_get_attribute(child, "var");
+            if (var != NULL) {
+                g_ptr_array_add(features, var);
+            }
         }
         if (g_strcmp0(xmpp_stanza_get_name(child), "identity") == 0) {
             identity_stanzas = g_slist_append(identity_stanzas, child);
@@ -434,48 +600,16 @@ caps_create(xmpp_stanza_t *query)
         name = xmpp_stanza_get_attribute(found, "name");
     }
 
-    Capabilities *new_caps = malloc(sizeof(struct capabilities_t));
-
-    if (category != NULL) {
-        new_caps->category = strdup(category);
-    } else {
-        new_caps->category = NULL;
-    }
-    if (type != NULL) {
-        new_caps->type = strdup(type);
-    } else {
-        new_caps->type = NULL;
-    }
-    if (name != NULL) {
-        new_caps->name = strdup(name);
-    } else {
-        new_caps->name = NULL;
-    }
-    if (software != NULL) {
-        new_caps->software = software;
-    } else {
-        new_caps->software = NULL;
-    }
-    if (software_version != NULL) {
-        new_caps->software_version = software_version;
-    } else {
-        new_caps->software_version = NULL;
-    }
-    if (os != NULL) {
-        new_caps->os = os;
-    } else {
-        new_caps->os = NULL;
-    }
-    if (os_version != NULL) {
-        new_caps->os_version = os_version;
-    } else {
-        new_caps->os_version = NULL;
-    }
-    if (features != NULL) {
-        new_caps->features = features;
-    } else {
-        new_caps->features = NULL;
-    }
+    Capabilities *new_caps = _caps_new();
+    new_caps->category = g_strdup(category);
+    new_caps->type = g_strdup(type);
+    new_caps->name = g_strdup(name);
+    new_caps->software = software;
+    new_caps->software_version = software_version;
+    new_caps->os = os;
+    new_caps->os_version = os_version;
+    _caps_set_features(new_caps, features);
+    g_ptr_array_free(features, TRUE);
 
     return new_caps;
 }
@@ -572,35 +706,345 @@ caps_create_query_response_stanza(xmpp_ctx_t * const ctx)
 static void
 _caps_close(void)
 {
-    g_key_file_free(cache);
+    // entries are already on disk, compacting can wait for the next start
+    if (compact_source != 0) {
+        g_source_remove(compact_source);
+        compact_source = 0;
+    }
+    capscache_close(cache);
     cache = NULL;
     g_hash_table_destroy(jid_lookup);
+    g_hash_table_destroy(caps_table);
+    g_hash_table_destroy(requests);
+    requests = NULL;
+
+    if (ver_str != NULL) {
+        g_string_free(ver_str, TRUE);
+        g_string_free(ver_scratch, TRUE);
+        g_ptr_array_free(ver_identities, TRUE);
+        g_ptr_array_free(ver_features, TRUE);
+        g_ptr_array_free(ver_fields, TRUE);
+        g_ptr_array_free(ver_values, TRUE);
+        g_array_free(ver_forms, TRUE);
+        ver_str = NULL;
+    }
+}
+
+static void
+_request_send_next(CapsRequest *request)
+{
+    if (request->timeout != 0) {
+        g_source_remove(request->timeout);
+        request->timeout = 0;
+    }
+    free(request->id);
+    request->id = NULL;
+
+    // nobody answered, ask again when the ver is next seen
+    if (request->tried == request->jids->len) {
+        log_info("No capabilities response for %s", request->ver);
+        g_hash_table_remove(requests, request->ver);
+        return;
+    }
+
+    if (jabber_get_connection_status() != JABBER_CONNECTED) {
+        log_debug("Not connected, dropping capabilities request for %s",
+            request->ver);
+        g_hash_table_remove(requests, request->ver);
+        return;
+    }
+
+    const char *jid = g_ptr_array_index(request->jids, request->tried++);
+    log_info("Sending service discovery request for %s to %s", request->ver, jid);
+    request->id = create_unique_id("caps");
+    iq_send_caps_request(jid, request->id, request->node, request->ver);
+    request->timeout = g_timeout_add_seconds(CAPS_REQUEST_TIMEOUT_SECS,
+        _request_timed_out, request);
+}
+
+static gboolean
+_request_timed_out(gpointer data)
+{
+    CapsRequest *request = data;
+    request->timeout = 0;
+    _request_send_next(request);
+    return FALSE;
+}
+
+static void
+_request_free(CapsRequest *request)
+{
+    if (request->timeout != 0) {
+        g_source_remove(request->timeout);
+    }
+    free(request->ver);
+    free(request->node);
+    free(request->id);
+    g_ptr_array_free(request->jids, TRUE);
+    free(request);
+}
+
+static Capabilities *
+_caps_new(void)
+{
+    Capabilities *new_caps = malloc(sizeof(struct capabilities_t));
+    new_caps->category = NULL;
+    new_caps->type = NULL;
+    new_caps->name = NULL;
+    new_caps->software = NULL;
+    new_caps->software_version = NULL;
+    new_caps->os = NULL;
+    new_caps->os_version = NULL;
+    new_caps->features = NULL;
+    new_caps->num_features = 0;
+    new_caps->feature_bits = NULL;
+    new_caps->num_feature_words = 0;
+    new_caps->refs = 1;
+
+    return new_caps;
+}
+
+static Capabilities *
+_caps_ref(Capabilities *caps)
+{
+    caps->refs++;
+    return caps;
 }
 
 static void
-_caps_destroy(Capabilities *caps)
+_caps_unref(Capabilities *caps)
 {
     if (caps != NULL) {
-        free(caps->category);
-        free(caps->type);
-        free(caps->name);
-        free(caps->software);
-        free(caps->software_version);
-        free(caps->os);
-        free(caps->os_version);
-        if (caps->features != NULL) {
-            g_slist_free_full(caps->features, free);
+        caps->refs--;
+        if (caps->refs > 0) {
+            return;
         }
+
+        g_free(caps->category);
+        g_free(caps->type);
+        g_free(caps->name);
+        g_free(caps->software);
+        g_free(caps->software_version);
+        g_free(caps->os);
+        g_free(caps->os_version);
+        free(caps->features);
+        free(caps->feature_bits);
         free(caps);
     }
 }
 
+/*
+ * Store the features as a sorted array of interned strings without
+ * duplicates, the strings in the given array are not kept
+ */
+static void
+_caps_set_features(Capabilities *caps, GPtrArray *features)
+{
+    if (features->len == 0) {
+        return;
+    }
+
+    caps->features = malloc(sizeof(gchar *) * features->len);
+    guint i;
+    for (i = 0; i < features->len; i++) {
+        caps->features[i] = g_intern_string(g_ptr_array_index(features, i));
+    }
+    qsort(caps->features, features->len, sizeof(gchar *), _compare_features);
+
+    caps->num_features = 1;
+    for (i = 1; i < features->len; i++) {
+        if (caps->features[i] != caps->features[caps->num_features - 1]) {
+            caps->features[caps->num_features++] = caps->features[i];
+        }
+    }
+}
+
+static int
+_compare_features(const void *a, const void *b)
+{
+    return strcmp(*(const gchar **)a, *(const gchar **)b);
+}
+
+// sort in place, checking first as most clients send their lists in order
+static void
+_sort_strings(GPtrArray *strings)
+{
+    guint i;
+    for (i = 1; i < strings->len; i++) {
+        if (strcmp(g_ptr_array_index(strings, i - 1), g_ptr_array_index(strings, i)) > 0) {
+            g_ptr_array_sort(strings, _compare_features);
+            return;
+        }
+    }
+}
+
+static void
+_append_attr(GString *str, xmpp_stanza_t * const stanza, const char * const attr)
+{
+    char *value = xmpp_stanza_get_attribute(stanza, attr);
+    if (value) {
+        g_string_append(str, value);
+    }
+}
+
+// the text of stanza as xmpp_stanza_get_text would return it, FALSE if empty
+static gboolean
+_append_text(GString *str, xmpp_stanza_t * const stanza)
+{
+    gsize len = str->len;
+    xmpp_stanza_t *child = xmpp_stanza_get_children(stanza);
+    while (child) {
+        if (xmpp_stanza_is_text(child)) {
+            g_string_append(str, xmpp_stanza_get_text_ptr(child));
+        }
+        child = xmpp_stanza_get_next(child);
+    }
+
+    return (str->len > len);
+}
+
+// the first value of the FORM_TYPE field, FALSE if there is none
+static gboolean
+_append_form_type(GString *str, xmpp_stanza_t * const form)
+{
+    xmpp_stanza_t *field = xmpp_stanza_get_children(form);
+    while (field) {
+        if ((g_strcmp0(xmpp_stanza_get_name(field), "field") == 0) &&
+                (g_strcmp0(xmpp_stanza_get_attribute(field, "var"), "FORM_TYPE") == 0)) {
+            xmpp_stanza_t *value = xmpp_stanza_get_children(field);
+            while (value) {
+                if ((g_strcmp0(xmpp_stanza_get_name(value), "value") == 0) &&
+                        _append_text(str, value)) {
+                    return TRUE;
+                }
+                value = xmpp_stanza_get_next(value);
+            }
+            return FALSE;
+        }
+        field = xmpp_stanza_get_next(field);
+    }
+
+    return FALSE;
+}
+
+// every field but FORM_TYPE sorted by var, each followed by its sorted values
+static void
+_append_form_fields(GString *str, xmpp_stanza_t * const form)
+{
+    g_ptr_array_set_size(ver_fields, 0);
+    xmpp_stanza_t *field = xmpp_stanza_get_children(form);
+    while (field) {
+        if (g_strcmp0(xmpp_stanza_get_name(field), "field") == 0) {
+            char *var = xmpp_stanza_get_attribute(field, "var");
+            if (var && (g_strcmp0(var, "FORM_TYPE") != 0)) {
+                g_ptr_array_add(ver_fields, field);
+            }
+        }
+        field = xmpp_stanza_get_next(field);
+    }
+    g_ptr_array_sort(ver_fields, _compare_field_vars);
+
+    guint i;
+    for (i = 0; i < ver_fields->len; i++) {
+        field = g_ptr_array_index(ver_fields, i);
+        g_string_append(str, xmpp_stanza_get_attribute(field, "var"));
+        g_string_append_c(str, '<');
+
+        // values are copied to the end of the scratch buffer to sort them
+        gsize start = ver_scratch->len;
+        g_ptr_array_set_size(ver_values, 0);
+        xmpp_stanza_t *value = xmpp_stanza_get_children(field);
+        while (value) {
+            if (g_strcmp0(xmpp_stanza_get_name(value), "value") == 0) {
+                gsize offset = ver_scratch->len;
+                if (_append_text(ver_scratch, value)) {
+                    g_string_append_c(ver_scratch, '\0');
+                    g_ptr_array_add(ver_values, GSIZE_TO_POINTER(offset));
+                }
+            }
+            value = xmpp_stanza_get_next(value);
+        }
+
+        guint j;
+        for (j = 0; j < ver_values->len; j++) {
+            ver_values->pdata[j] = ver_scratch->str + GPOINTER_TO_SIZE(ver_values->pdata[j]);
+        }
+        _sort_strings(ver_values);
+        for (j = 0; j < ver_values->len; j++) {
+            g_string_append(str, g_ptr_array_index(ver_values, j));
+            g_string_append_c(str, '<');
+        }
+        g_string_truncate(ver_scratch, start);
+    }
+}
+
+static gint
+_compare_forms(gconstpointer a, gconstpointer b, gpointer scratch)
+{
+    const gchar *str = ((GString *)scratch)->str;
+    return strcmp(str + ((const CapsForm *)a)->type, str + ((const CapsForm *)b)->type);
+}
+
+static int
+_compare_field_vars(const void *a, const void *b)
+{
+    return strcmp(xmpp_stanza_get_attribute(*(xmpp_stanza_t **)a, "var"),
+        xmpp_stanza_get_attribute(*(xmpp_stanza_t **)b, "var"));
+}
+
+/*
+ * Give each feature an id and set its bit, ids are handed out in the order
+ * features are first seen so the bitsets stay small
+ */
+static void
+_caps_set_feature_bits(Capabilities *caps)
+{
+    guint max_id = 0;
+    guint i;
+    for (i = 0; i < caps->num_features; i++) {
+        const gchar *feature = caps->features[i];
+        guint id = GPOINTER_TO_UINT(g_hash_table_lookup(feature_ids, feature));
+        if (id == 0) {
+            id = ++num_feature_ids;
+            g_hash_table_insert(feature_ids, (gpointer)feature, GUINT_TO_POINTER(id));
+        }
+        if (id > max_id) {
+            max_id = id;
+        }
+    }
+
+    caps->num_feature_words = (max_id / 32) + 1;
+    caps->feature_bits = calloc(caps->num_feature_words, sizeof(guint32));
+    for (i = 0; i < caps->num_features; i++) {
+        guint id = GPOINTER_TO_UINT(g_hash_table_lookup(feature_ids, caps->features[i]));
+        caps->feature_bits[id / 32] |= (1u << (id % 32));
+    }
+}
+
+// feature must be interned
+static gboolean
+_caps_test_feature(Capabilities *caps, const gchar *feature)
+{
+    if (caps->feature_bits == NULL) {
+        _caps_set_feature_bits(caps);
+    }
+
+    // features first seen after the bitset was built are not in it
+    guint id = GPOINTER_TO_UINT(g_hash_table_lookup(feature_ids, feature));
+    if ((id == 0) || ((id / 32) >= caps->num_feature_words)) {
+        return FALSE;
+    }
+
+    return ((caps->feature_bits[id / 32] & (1u << (id % 32))) != 0);
+}
+
 static gchar *
-_get_cache_file(void)
+_get_cache_file(const char * const name)
 {
     gchar *xdg_data = xdg_get_data_home();
     GString *cache_file = g_string_new(xdg_data);
-    g_string_append(cache_file, "/profanity/capscache");
+    g_string_append(cache_file, "/profanity/");
+    g_string_append(cache_file, name);
     gchar *result = strdup(cache_file->str);
     g_free(xdg_data);
     g_string_free(cache_file, TRUE);
@@ -609,18 +1053,80 @@ _get_cache_file(void)
 }
 
 static void
-_save_cache(void)
+_import_keyfile(const char * const keyfile_loc)
+{
+    GKeyFile *keyfile = g_key_file_new();
+    if (g_key_file_load_from_file(keyfile, keyfile_loc, G_KEY_FILE_NONE, NULL)) {
+        gsize num_vers = 0;
+        gchar **vers = g_key_file_get_groups(keyfile, &num_vers);
+        log_info("Importing %d capabilities from %s", (int)num_vers, keyfile_loc);
+
+        // build them all first so the cache is written once
+        GHashTable *imported = g_hash_table_new_full(g_str_hash, g_str_equal,
+            NULL, (GDestroyNotify)_caps_unref);
+        gsize i;
+        for (i = 0; i < num_vers; i++) {
+            g_hash_table_replace(imported, vers[i],
+                _caps_from_keyfile(keyfile, vers[i]));
+        }
+        capscache_add_all(cache, imported);
+        g_hash_table_destroy(imported);
+        g_strfreev(vers);
+    }
+    g_key_file_free(keyfile);
+}
+
+static Capabilities *
+_caps_from_keyfile(GKeyFile *keyfile, const char * const ver)
+{
+    Capabilities *caps = _caps_new();
+    caps->category = g_key_file_get_string(keyfile, ver, "category", NULL);
+    caps->type = g_key_file_get_string(keyfile, ver, "type", NULL);
+    caps->name = g_key_file_get_string(keyfile, ver, "name", NULL);
+    caps->software = g_key_file_get_string(keyfile, ver, "software", NULL);
+    caps->software_version = g_key_file_get_string(keyfile, ver, "software_version", NULL);
+    caps->os = g_key_file_get_string(keyfile, ver, "os", NULL);
+    caps->os_version = g_key_file_get_string(keyfile, ver, "os_version", NULL);
+
+    gsize features_len = 0;
+    gchar **features = g_key_file_get_string_list(keyfile, ver, "features", &features_len, NULL);
+    if (features != NULL) {
+        GPtrArray *features_arr = g_ptr_array_sized_new(features_len);
+        gsize i;
+        for (i = 0; i < features_len; i++) {
+            g_ptr_array_add(features_arr, features[i]);
+        }
+        _caps_set_features(caps, features_arr);
+        g_ptr_array_free(features_arr, TRUE);
+        g_strfreev(features);
+    }
+
+    return caps;
+}
+
+static void
+_compact_cache(void)
+{
+    if (compact_source != 0) {
+        g_source_remove(compact_source);
+    }
+    compact_source = g_timeout_add(CACHE_COMPACT_DELAY_MS, _compact_source_fired, NULL);
+}
+
+static gboolean
+_compact_source_fired(gpointer data)
 {
-    gsize g_data_size;
-    gchar *g_cache_data = g_key_file_to_data(cache, &g_data_size, NULL);
-    g_file_set_contents(cache_loc, g_cache_data, g_data_size, NULL);
-    g_free(g_cache_data);
+    compact_source = 0;
+    capscache_compact(cache);
+    return FALSE;
 }
 
 void
 capabilities_init_module(void)
 {
     caps_lookup = _caps_lookup;
+    caps_jid_known = _caps_jid_known;
+    caps_jid_supports = _caps_jid_supports;
     caps_close = _caps_close;
-    caps_destroy = _caps_destroy;
+    caps_unref = _caps_unref;
 }
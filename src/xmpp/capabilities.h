@@ -43,6 +43,11 @@ void caps_init(void);
 void caps_add(const char * const ver, Capabilities *caps);
 void caps_map(const char * const jid, const char * const ver);
 gboolean caps_contains(const char * const caps_ver);
+void caps_request(const char * const jid, const char * const node,
+    const char * const ver);
+void caps_request_complete(const char * const ver);
+void caps_request_failed(const char * const id);
+void caps_requests_clear(void);
 char* caps_create_sha1_str(xmpp_stanza_t * const query);
 xmpp_stanza_t* caps_create_query_response_stanza(xmpp_ctx_t * const ctx);
 Capabilities* caps_create(xmpp_stanza_t *query);
@@ -0,0 +1,526 @@
+/*
+ * capscache.c
+ *
+ * Copyright (C) 2012 - 2014 James Booth <boothj5@gmail.com>
+ *
+ * This file is part of Profanity.
+ *
+ * Profanity is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Profanity is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Profanity.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give permission to
+ * link the code of portions of this program with the OpenSSL library under
+ * certain conditions as described in each individual source file, and
+ * distribute linked combinations including the two.
+ *
+ * You must obey the GNU General Public License in all respects for all of the
+ * code used other than OpenSSL. If you modify file(s) with this exception, you
+ * may extend this exception to your version of the file(s), but you are not
+ * obligated to do so. If you do not wish to do so, delete this exception
+ * statement from your version. If you delete this exception statement from all
+ * source files in the program, then also delete it here.
+ *
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <glib.h>
+
+#include "common.h"
+#include "log.h"
+#include "xmpp/xmpp.h"
+#include "xmpp/capscache.h"
+
+#define CAPS_CACHE_MAGIC "PCC\n"
+#define CAPS_CACHE_VERSION 1
+#define CAPS_CACHE_HEADER_SIZE 12
+#define CAPS_CACHE_FIELDS 7
+#define CAPS_CACHE_NO_STRING G_MAXUINT32
+
+// record size without features: size, ver, fields and feature count
+#define CAPS_CACHE_RECORD_SIZE ((3 + CAPS_CACHE_FIELDS) * 4)
+
+// rewrite the file once this many records carry their own strings
+#define CAPS_CACHE_COMPACT_RECORDS 32
+
+/*
+ * All numbers are native 32 bit unsigned and all strings are nul terminated
+ * and referred to by their offset from the start of the file:
+ *
+ *   header   magic, format version, offset of the first record
+ *   strings  shared by the records written when the file was compacted
+ *   records  size, ver, category, type, name, software, software_version,
+ *            os, os_version, feature count, sorted feature offsets and, for
+ *            records appended since the last compaction, their own strings
+ */
+struct caps_cache_t {
+    gchar *filename;
+    GMappedFile *map;
+    const gchar *data;
+    gsize size;
+
+    // ver in the mapped file to record offset
+    GHashTable *index;
+
+    // vers appended since the file was mapped
+    GHashTable *appended;
+
+    // records holding their own strings
+    guint loose;
+};
+
+static void _map(CapsCache cache);
+static void _unmap(CapsCache cache);
+static gboolean _read_u32(CapsCache cache, gsize offset, guint32 *value);
+static const gchar * _string_at(CapsCache cache, gsize offset);
+static const gchar * _record_string(CapsCache cache, gsize offset);
+static Capabilities * _read_caps(CapsCache cache, gsize record);
+static gchar ** _caps_field(Capabilities *caps, int field);
+static void _put_u32(GString *bytes, guint32 value);
+static void _put_header(GString *bytes, guint32 records);
+static void _put_record(GString *records, GString *strings, GHashTable *offsets,
+    const gchar * const ver, const gchar **fields, const gchar **features,
+    guint32 num_features);
+static gboolean _rewrite(CapsCache cache, GHashTable *added);
+static guint32 _put_string(GString *strings, GHashTable *offsets,
+    guint32 base, const gchar * const str);
+
+CapsCache
+capscache_open(const char * const filename)
+{
+    CapsCache cache = malloc(sizeof(struct caps_cache_t));
+    cache->filename = strdup(filename);
+    cache->map = NULL;
+    cache->data = NULL;
+    cache->size = 0;
+    cache->index = g_hash_table_new(g_str_hash, g_str_equal);
+    cache->appended = g_hash_table_new_full(g_str_hash, g_str_equal, free, NULL);
+    cache->loose = 0;
+
+    _map(cache);
+
+    return cache;
+}
+
+void
+capscache_close(CapsCache cache)
+{
+    if (cache != NULL) {
+        _unmap(cache);
+        g_hash_table_destroy(cache->index);
+        g_hash_table_destroy(cache->appended);
+        free(cache->filename);
+        free(cache);
+    }
+}
+
+gboolean
+capscache_contains(CapsCache cache, const char * const ver)
+{
+    return (g_hash_table_contains(cache->index, ver) ||
+        g_hash_table_contains(cache->appended, ver));
+}
+
+Capabilities *
+capscache_get(CapsCache cache, const char * const ver)
+{
+    gpointer record = g_hash_table_lookup(cache->index, ver);
+
+    // written since the file was mapped
+    if ((record == NULL) && g_hash_table_contains(cache->appended, ver)) {
+        _unmap(cache);
+        _map(cache);
+        record = g_hash_table_lookup(cache->index, ver);
+    }
+
+    if (record == NULL) {
+        return NULL;
+    }
+
+    return _read_caps(cache, GPOINTER_TO_UINT(record));
+}
+
+gboolean
+capscache_add(CapsCache cache, const char * const ver, Capabilities *caps)
+{
+    FILE *f = fopen(cache->filename, "ab");
+    if (f == NULL) {
+        log_error("Could not write capabilities cache: %s", cache->filename);
+        return FALSE;
+    }
+    fseek(f, 0, SEEK_END);
+    long end = ftell(f);
+
+    GString *bytes = g_string_new(NULL);
+    if (end == 0) {
+        _put_header(bytes, CAPS_CACHE_HEADER_SIZE);
+    }
+
+    // the strings follow the record
+    guint32 record_size = CAPS_CACHE_RECORD_SIZE + (caps->num_features * 4);
+    guint32 base = end + bytes->len + record_size;
+    GString *strings = g_string_new(NULL);
+    GHashTable *offsets = g_hash_table_new(g_str_hash, g_str_equal);
+
+    GString *record = g_string_new(NULL);
+    _put_u32(record, _put_string(strings, offsets, base, ver));
+    int i;
+    for (i = 0; i < CAPS_CACHE_FIELDS; i++) {
+        _put_u32(record, _put_string(strings, offsets, base, *_caps_field(caps, i)));
+    }
+    _put_u32(record, caps->num_features);
+    guint j;
+    for (j = 0; j < caps->num_features; j++) {
+        _put_u32(record, _put_string(strings, offsets, base, caps->features[j]));
+    }
+
+    _put_u32(bytes, record_size + strings->len);
+    g_string_append_len(bytes, record->str, record->len);
+    g_string_append_len(bytes, strings->str, strings->len);
+
+    gboolean result = (fwrite(bytes->str, 1, bytes->len, f) == bytes->len);
+    if (fclose(f) != 0) {
+        result = FALSE;
+    }
+
+    g_hash_table_destroy(offsets);
+    g_string_free(record, TRUE);
+    g_string_free(strings, TRUE);
+    g_string_free(bytes, TRUE);
+
+    if (result) {
+        g_hash_table_insert(cache->appended, strdup(ver), NULL);
+        cache->loose++;
+    } else {
+        log_error("Could not write capabilities cache: %s", cache->filename);
+    }
+
+    return result;
+}
+
+gboolean
+capscache_needs_compact(CapsCache cache)
+{
+    return (cache->loose >= CAPS_CACHE_COMPACT_RECORDS);
+}
+
+/*
+ * Rewrite the file with every string stored once, replacing it in one step
+ * so a failed write leaves the old file in place
+ */
+gboolean
+capscache_compact(CapsCache cache)
+{
+    return _rewrite(cache, NULL);
+}
+
+/*
+ * Add every entry in caps, a table of ver to Capabilities, writing the file
+ * once. The result is compacted as by capscache_compact.
+ */
+gboolean
+capscache_add_all(CapsCache cache, GHashTable *caps)
+{
+    return _rewrite(cache, caps);
+}
+
+static gboolean
+_rewrite(CapsCache cache, GHashTable *added)
+{
+    if (g_hash_table_size(cache->appended) > 0) {
+        _unmap(cache);
+        _map(cache);
+    }
+
+    GString *strings = g_string_new(NULL);
+    GString *records = g_string_new(NULL);
+    GHashTable *offsets = g_hash_table_new(g_str_hash, g_str_equal);
+    const gchar *fields[CAPS_CACHE_FIELDS];
+    GPtrArray *features = g_ptr_array_new();
+
+    GHashTableIter iter;
+    gpointer ver, value;
+    g_hash_table_iter_init(&iter, cache->index);
+    while (g_hash_table_iter_next(&iter, &ver, &value)) {
+        // replaced by the new entry
+        if ((added != NULL) && g_hash_table_contains(added, ver)) {
+            continue;
+        }
+
+        gsize record = GPOINTER_TO_UINT(value);
+        guint32 num_features = 0;
+        _read_u32(cache, record + CAPS_CACHE_RECORD_SIZE - 4, &num_features);
+
+        int i;
+        for (i = 0; i < CAPS_CACHE_FIELDS; i++) {
+            fields[i] = _record_string(cache, record + 8 + (i * 4));
+        }
+        g_ptr_array_set_size(features, 0);
+        guint32 j;
+        for (j = 0; j < num_features; j++) {
+            g_ptr_array_add(features, (gpointer)_record_string(cache,
+                record + CAPS_CACHE_RECORD_SIZE + (j * 4)));
+        }
+        _put_record(records, strings, offsets, ver, fields,
+            (const gchar **)features->pdata, num_features);
+    }
+
+    if (added != NULL) {
+        g_hash_table_iter_init(&iter, added);
+        while (g_hash_table_iter_next(&iter, &ver, &value)) {
+            Capabilities *caps = value;
+            int i;
+            for (i = 0; i < CAPS_CACHE_FIELDS; i++) {
+                fields[i] = *_caps_field(caps, i);
+            }
+            _put_record(records, strings, offsets, ver, fields,
+                caps->features, caps->num_features);
+        }
+    }
+
+    GString *bytes = g_string_new(NULL);
+    _put_header(bytes, CAPS_CACHE_HEADER_SIZE + strings->len);
+    g_string_append_len(bytes, strings->str, strings->len);
+    g_string_append_len(bytes, records->str, records->len);
+
+    GError *error = NULL;
+    gboolean result = g_file_set_contents(cache->filename, bytes->str, bytes->len, &error);
+    if (!result) {
+        log_error("Could not write capabilities cache: %s", error->message);
+        g_error_free(error);
+    }
+
+    g_ptr_array_free(features, TRUE);
+    g_hash_table_destroy(offsets);
+    g_string_free(strings, TRUE);
+    g_string_free(records, TRUE);
+    g_string_free(bytes, TRUE);
+
+    _unmap(cache);
+    _map(cache);
+
+    return result;
+}
+
+static void
+_map(CapsCache cache)
+{
+    cache->map = g_mapped_file_new(cache->filename, FALSE, NULL);
+    if (cache->map == NULL) {
+        return;
+    }
+    cache->data = g_mapped_file_get_contents(cache->map);
+    cache->size = g_mapped_file_get_length(cache->map);
+
+    guint32 version = 0;
+    guint32 offset = 0;
+    if ((cache->size < CAPS_CACHE_HEADER_SIZE)
+            || (memcmp(cache->data, CAPS_CACHE_MAGIC, 4) != 0)
+            || !_read_u32(cache, 4, &version)
+            || (version != CAPS_CACHE_VERSION)
+            || !_read_u32(cache, 8, &offset)
+            || (offset > cache->size)) {
+        log_warning("Discarding unreadable capabilities cache: %s", cache->filename);
+        _unmap(cache);
+        remove(cache->filename);
+        return;
+    }
+
+    guint32 record_size = 0;
+    guint32 num_features = 0;
+    while (_read_u32(cache, offset, &record_size)) {
+        const gchar *ver = _record_string(cache, offset + 4);
+        if ((record_size < CAPS_CACHE_RECORD_SIZE)
+                || ((gsize)offset + record_size > cache->size)
+                || (ver == NULL)
+                || !_read_u32(cache, offset + CAPS_CACHE_RECORD_SIZE - 4, &num_features)
+                || (CAPS_CACHE_RECORD_SIZE + ((gsize)num_features * 4) > record_size)) {
+            break;
+        }
+
+        if (record_size > CAPS_CACHE_RECORD_SIZE + (num_features * 4)) {
+            cache->loose++;
+        }
+        g_hash_table_insert(cache->index, (gpointer)ver, GUINT_TO_POINTER(offset));
+        offset += record_size;
+    }
+
+    // drop anything left by an interrupted write so appends stay readable
+    if (offset < cache->size) {
+        log_warning("Truncating capabilities cache: %s", cache->filename);
+        if (truncate(cache->filename, offset) != 0) {
+            log_error("Could not truncate capabilities cache: %s", cache->filename);
+        }
+    }
+}
+
+static void
+_unmap(CapsCache cache)
+{
+    g_hash_table_remove_all(cache->index);
+    g_hash_table_remove_all(cache->appended);
+    if (cache->map != NULL) {
+        g_mapped_file_unref(cache->map);
+        cache->map = NULL;
+    }
+    cache->data = NULL;
+    cache->size = 0;
+    cache->loose = 0;
+}
+
+static gboolean
+_read_u32(CapsCache cache, gsize offset, guint32 *value)
+{
+    if (offset + 4 > cache->size) {
+        return FALSE;
+    }
+
+    memcpy(value, cache->data + offset, 4);
+    return TRUE;
+}
+
+static const gchar *
+_string_at(CapsCache cache, gsize offset)
+{
+    if (offset >= cache->size) {
+        return NULL;
+    }
+
+    // the string must end inside the file
+    if (memchr(cache->data + offset, '\0', cache->size - offset) == NULL) {
+        return NULL;
+    }
+
+    return cache->data + offset;
+}
+
+// the string referred to by the number at offset, NULL if there is none
+static const gchar *
+_record_string(CapsCache cache, gsize offset)
+{
+    guint32 string = CAPS_CACHE_NO_STRING;
+    if (!_read_u32(cache, offset, &string) || (string == CAPS_CACHE_NO_STRING)) {
+        return NULL;
+    }
+
+    return _string_at(cache, string);
+}
+
+static Capabilities *
+_read_caps(CapsCache cache, gsize record)
+{
+    Capabilities *caps = malloc(sizeof(struct capabilities_t));
+    int i;
+    for (i = 0; i < CAPS_CACHE_FIELDS; i++) {
+        *_caps_field(caps, i) = g_strdup(_record_string(cache, record + 8 + (i * 4)));
+    }
+
+    guint32 num_features = 0;
+    _read_u32(cache, record + CAPS_CACHE_RECORD_SIZE - 4, &num_features);
+    caps->features = NULL;
+    caps->num_features = 0;
+    if (num_features > 0) {
+        caps->features = malloc(sizeof(gchar *) * num_features);
+        guint32 j;
+        for (j = 0; j < num_features; j++) {
+            const gchar *feature = _record_string(cache, record + CAPS_CACHE_RECORD_SIZE + (j * 4));
+            if (feature != NULL) {
+                caps->features[caps->num_features++] = g_intern_string(feature);
+            }
+        }
+    }
+    caps->feature_bits = NULL;
+    caps->num_feature_words = 0;
+    caps->refs = 1;
+
+    return caps;
+}
+
+static gchar **
+_caps_field(Capabilities *caps, int field)
+{
+    switch (field) {
+    case 0:
+        return &caps->category;
+    case 1:
+        return &caps->type;
+    case 2:
+        return &caps->name;
+    case 3:
+        return &caps->software;
+    case 4:
+        return &caps->software_version;
+    case 5:
+        return &caps->os;
+    default:
+        return &caps->os_version;
+    }
+}
+
+static void
+_put_u32(GString *bytes, guint32 value)
+{
+    g_string_append_len(bytes, (const gchar *)&value, 4);
+}
+
+static void
+_put_header(GString *bytes, guint32 records)
+{
+    g_string_append_len(bytes, CAPS_CACHE_MAGIC, 4);
+    _put_u32(bytes, CAPS_CACHE_VERSION);
+    _put_u32(bytes, records);
+}
+
+// add a record whose strings go in the shared strings after the header
+static void
+_put_record(GString *records, GString *strings, GHashTable *offsets,
+    const gchar * const ver, const gchar **fields, const gchar **features,
+    guint32 num_features)
+{
+    _put_u32(records, CAPS_CACHE_RECORD_SIZE + (num_features * 4));
+    _put_u32(records, _put_string(strings, offsets, CAPS_CACHE_HEADER_SIZE, ver));
+    int i;
+    for (i = 0; i < CAPS_CACHE_FIELDS; i++) {
+        _put_u32(records, _put_string(strings, offsets, CAPS_CACHE_HEADER_SIZE, fields[i]));
+    }
+    _put_u32(records, num_features);
+    guint32 j;
+    for (j = 0; j < num_features; j++) {
+        _put_u32(records, _put_string(strings, offsets, CAPS_CACHE_HEADER_SIZE, features[j]));
+    }
+}
+
+// add a string once, returning its offset in the file
+static guint32
+_put_string(GString *strings, GHashTable *offsets, guint32 base,
+    const gchar * const str)
+{
+    if (str == NULL) {
+        return CAPS_CACHE_NO_STRING;
+    }
+
+    gpointer found = NULL;
+    if (g_hash_table_lookup_extended(offsets, str, NULL, &found)) {
+        return GPOINTER_TO_UINT(found);
+    }
+
+    guint32 offset = base + strings->len;
+    g_string_append_len(strings, str, strlen(str) + 1);
+    g_hash_table_insert(offsets, (gpointer)str, GUINT_TO_POINTER(offset));
+
+    return offset;
+}
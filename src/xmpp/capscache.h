@@ -0,0 +1,64 @@
+/*
+ * capscache.h
+ *
+ * Copyright (C) 2012 - 2014 James Booth <boothj5@gmail.com>
+ *
+ * This file is part of Profanity.
+ *
+ * Profanity is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Profanity is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Profanity.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give permission to
+ * link the code of portions of this program with the OpenSSL library under
+ * certain conditions as described in each individual source file, and
+ * distribute linked combinations including the two.
+ *
+ * You must obey the GNU General Public License in all respects for all of the
+ * code used other than OpenSSL. If you modify file(s) with this exception, you
+ * may extend this exception to your version of the file(s), but you are not
+ * obligated to do so. If you do not wish to do so, delete this exception
+ * statement from your version. If you delete this exception statement from all
+ * source files in the program, then also delete it here.
+ *
+ */
+
+
+#ifndef XMPP_CAPSCACHE_H
+#define XMPP_CAPSCACHE_H
+
+#include <glib.h>
+
+#include "xmpp/xmpp.h"
+
+typedef struct caps_cache_t *CapsCache;
+
+// map the cache file, an unreadable or invalid file gives an empty cache
+CapsCache capscache_open(const char * const filename);
+void capscache_close(CapsCache cache);
+
+gboolean capscache_contains(CapsCache cache, const char * const ver);
+
+// a new entry read from the file, NULL when not cached
+Capabilities* capscache_get(CapsCache cache, const char * const ver);
+
+// append an entry to the file, FALSE if it could not be written
+gboolean capscache_add(CapsCache cache, const char * const ver, Capabilities *caps);
+
+// add a table of ver to Capabilities in a single write
+gboolean capscache_add_all(CapsCache cache, GHashTable *caps);
+
+// rewrite the file with strings shared between entries
+gboolean capscache_needs_compact(CapsCache cache);
+gboolean capscache_compact(CapsCache cache);
+
+#endif
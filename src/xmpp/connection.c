@@ -32,7 +32,10 @@
  *
  */
 
+#include "config.h"
+
 #include <assert.h>
+#include <poll.h>
 #include <string.h>
 #include <stdlib.h>
 
@@ -83,7 +86,37 @@ static struct {
     int port;
 } saved_details;
 
-static GTimer *reconnect_timer;
+#ifdef HAVE_XMPP_CONN_SET_SOCKOPT_CALLBACK
+// socket activity wakes the main loop, only service for connect timeouts
+#define SERVICE_INTERVAL_MS 1000
+#else
+// libstrophe does not expose the socket, so poll the connection
+#define SERVICE_INTERVAL_MS 20
+#endif
+
+// libstrophe reads at most 4096 bytes per run and TLS can hold back up to
+// one 16KB record the socket no longer shows, so keep running until this
+// many runs in a row saw neither a stanza nor a readable socket
+#define SOCKET_QUIET_PASSES 4
+
+// most runs per wake-up, so a flood of stanzas cannot starve the UI
+#define SOCKET_DRAIN_MAX_PASSES 256
+
+// main loop sources, 0 when not running
+static guint reconnect_timer = 0;
+static guint service_timer = 0;
+static guint socket_watch = 0;
+
+#ifdef HAVE_XMPP_CONN_SET_SOCKOPT_CALLBACK
+static int socket_fd = -1;
+static GIOCondition socket_condition = 0;
+
+// TRUE until the socket first becomes writable
+static gboolean socket_connecting = FALSE;
+
+// bumped for every stanza, to tell whether a run made progress
+static guint stanzas_seen = 0;
+#endif
 
 static log_level_t _get_log_level(xmpp_log_level_t xmpp_level);
 static xmpp_log_level_t _get_xmpp_log_level();
@@ -95,6 +128,22 @@ static xmpp_log_t * _xmpp_get_file_logger();
 static jabber_conn_status_t _jabber_connect(const char * const fulljid,
     const char * const passwd, const char * const altdomain, int port);
 static void _jabber_reconnect(void);
+static gboolean _reconnect_timer_fired(gpointer data);
+static void _reconnect_timer_start(void);
+static void _reconnect_timer_stop(void);
+static gboolean _connection_service(gpointer data);
+#ifdef HAVE_XMPP_CONN_SET_SOCKOPT_CALLBACK
+static int _connection_sockopt_cb(xmpp_conn_t *conn, void *sock);
+static gboolean _connection_socket_ready(GIOChannel *source,
+    GIOCondition condition, gpointer data);
+static void _connection_watch_socket(int sock, GIOCondition condition);
+static void _connection_update_watch(void);
+static void _connection_drain(void);
+static gboolean _connection_socket_readable(void);
+static int _connection_stanza_seen(xmpp_conn_t * const conn,
+    xmpp_stanza_t * const stanza, void * const userdata);
+#endif
+static void _connection_unwatch(void);
 
 static void _connection_handler(xmpp_conn_t * const conn,
     const xmpp_conn_event_t status, const int error,
@@ -194,8 +243,9 @@ _jabber_disconnect(void)
         xmpp_disconnect(jabber_conn.conn);
 
         while (jabber_get_connection_status() == JABBER_DISCONNECTING) {
-            jabber_process_events();
+            xmpp_run_once(jabber_conn.ctx, 10);
         }
+        _connection_unwatch();
         _connection_free_saved_account();
         _connection_free_saved_details();
         _connection_free_session_data();
@@ -217,6 +267,8 @@ _jabber_disconnect(void)
 static void
 _jabber_shutdown(void)
 {
+    _reconnect_timer_stop();
+    _connection_unwatch();
     _connection_free_saved_account();
     _connection_free_saved_details();
     _connection_free_session_data();
@@ -227,23 +279,18 @@ _jabber_shutdown(void)
 static void
 _jabber_process_events(void)
 {
-    int reconnect_sec;
-
     switch (jabber_conn.conn_status)
     {
         case JABBER_CONNECTED:
         case JABBER_CONNECTING:
         case JABBER_DISCONNECTING:
-            xmpp_run_once(jabber_conn.ctx, 10);
-            break;
-        case JABBER_DISCONNECTED:
-            reconnect_sec = prefs_get_reconnect();
-            if ((reconnect_sec != 0) && (reconnect_timer != NULL)) {
-                int elapsed_sec = g_timer_elapsed(reconnect_timer, NULL);
-                if (elapsed_sec > reconnect_sec) {
-                    _jabber_reconnect();
-                }
+            xmpp_run_once(jabber_conn.ctx, 0);
+#ifdef HAVE_XMPP_CONN_SET_SOCKOPT_CALLBACK
+            // wake up when the socket can take what did not fit
+            if (socket_watch != 0) {
+                _connection_update_watch();
             }
+#endif
             break;
         default:
             break;
@@ -347,6 +394,8 @@ _connection_free_session_data(void)
     g_hash_table_remove_all(available_resources);
     chat_sessions_clear();
     presence_clear_sub_requests();
+    caps_requests_clear();
+    roster_cache_flush();
 }
 
 static jabber_conn_status_t
@@ -376,6 +425,7 @@ _jabber_connect(const char * const fulljid, const char * const passwd,
     }
     jabber_conn.log = _xmpp_get_file_logger();
 
+    _connection_unwatch();
     if (jabber_conn.conn != NULL) {
         xmpp_conn_release(jabber_conn.conn);
     }
@@ -397,14 +447,22 @@ _jabber_connect(const char * const fulljid, const char * const passwd,
     if (jabber_conn.tls_disabled) {
         xmpp_conn_disable_tls(jabber_conn.conn);
     }
+#ifdef HAVE_XMPP_CONN_SET_SOCKOPT_CALLBACK
+    xmpp_conn_set_sockopt_callback(jabber_conn.conn, _connection_sockopt_cb);
+    xmpp_handler_add(jabber_conn.conn, _connection_stanza_seen, NULL, NULL, NULL, NULL);
+#endif
 
     int connect_status = xmpp_connect_client(jabber_conn.conn, altdomain, port,
         _connection_handler, jabber_conn.ctx);
 
-    if (connect_status == 0)
+    if (connect_status == 0) {
         jabber_conn.conn_status = JABBER_CONNECTING;
-    else
+        if (service_timer == 0) {
+            service_timer = g_timeout_add(SERVICE_INTERVAL_MS, _connection_service, NULL);
+        }
+    } else {
         jabber_conn.conn_status = JABBER_DISCONNECTED;
+    }
 
     return jabber_conn.conn_status;
 }
@@ -422,7 +480,189 @@ _jabber_reconnect(void)
         log_debug("Attempting reconnect with account %s", account->name);
         _jabber_connect(fulljid, saved_account.passwd, account->server, account->port);
         free(fulljid);
-        g_timer_start(reconnect_timer);
+        _reconnect_timer_start();
+    }
+}
+
+static gboolean
+_reconnect_timer_fired(gpointer data)
+{
+    // previous attempt still in progress
+    if (jabber_conn.conn_status != JABBER_DISCONNECTED) {
+        return TRUE;
+    }
+
+    reconnect_timer = 0;
+    if (prefs_get_reconnect() != 0) {
+        _jabber_reconnect();
+    }
+
+    return FALSE;
+}
+
+static void
+_reconnect_timer_start(void)
+{
+    _reconnect_timer_stop();
+    reconnect_timer = g_timeout_add_seconds(prefs_get_reconnect(),
+        _reconnect_timer_fired, NULL);
+}
+
+static void
+_reconnect_timer_stop(void)
+{
+    if (reconnect_timer != 0) {
+        g_source_remove(reconnect_timer);
+        reconnect_timer = 0;
+    }
+}
+
+static gboolean
+_connection_service(gpointer data)
+{
+    switch (jabber_conn.conn_status)
+    {
+        case JABBER_CONNECTED:
+#if defined(HAVE_XMPP_CONN_SET_SOCKOPT_CALLBACK) && defined(HAVE_XMPP_CONN_SEND_QUEUE_LEN)
+            service_timer = 0;
+            return FALSE;
+#endif
+            // without the queue length, output left over when the socket
+            // was full is flushed here
+        case JABBER_CONNECTING:
+        case JABBER_DISCONNECTING:
+            xmpp_run_once(jabber_conn.ctx, 0);
+            return TRUE;
+        default:
+            service_timer = 0;
+            return FALSE;
+    }
+}
+
+#ifdef HAVE_XMPP_CONN_SET_SOCKOPT_CALLBACK
+static int
+_connection_sockopt_cb(xmpp_conn_t *conn, void *sock)
+{
+    // new socket for this connection attempt, wait for connect to complete
+    socket_connecting = TRUE;
+    _connection_watch_socket(*(int *)sock, G_IO_IN | G_IO_OUT);
+
+    return 0;
+}
+
+static gboolean
+_connection_socket_ready(GIOChannel *source, GIOCondition condition,
+    gpointer data)
+{
+    guint self = g_source_get_id(g_main_current_source());
+
+    if (condition & G_IO_OUT) {
+        socket_connecting = FALSE;
+    }
+
+    _connection_drain();
+
+    // watch was replaced or removed by a handler
+    if (socket_watch != self) {
+        return FALSE;
+    }
+
+    if (condition & (G_IO_HUP | G_IO_ERR | G_IO_NVAL)) {
+        socket_watch = 0;
+        return FALSE;
+    }
+
+    _connection_update_watch();
+    return (socket_watch == self);
+}
+
+/*
+ * Run libstrophe until it stops making progress, data TLS has already
+ * decrypted does not make the socket readable again
+ */
+static void
+_connection_drain(void)
+{
+    int quiet = 0;
+    int passes = 0;
+    while ((socket_watch != 0) && (quiet < SOCKET_QUIET_PASSES) &&
+            (passes < SOCKET_DRAIN_MAX_PASSES)) {
+        guint seen = stanzas_seen;
+        xmpp_run_once(jabber_conn.ctx, 0);
+        passes++;
+
+        if ((stanzas_seen != seen) || _connection_socket_readable()) {
+            quiet = 0;
+        } else {
+            quiet++;
+        }
+    }
+}
+
+// watch for output only while connecting or while output is queued
+static void
+_connection_update_watch(void)
+{
+    GIOCondition condition = G_IO_IN;
+    if (socket_connecting) {
+        condition |= G_IO_OUT;
+    }
+#ifdef HAVE_XMPP_CONN_SEND_QUEUE_LEN
+    if ((jabber_conn.conn != NULL) && (xmpp_conn_send_queue_len(jabber_conn.conn) > 0)) {
+        condition |= G_IO_OUT;
+    }
+#endif
+
+    if (condition != socket_condition) {
+        _connection_watch_socket(socket_fd, condition);
+    }
+}
+
+static void
+_connection_watch_socket(int sock, GIOCondition condition)
+{
+    if (socket_watch != 0) {
+        g_source_remove(socket_watch);
+    }
+
+    socket_fd = sock;
+    socket_condition = condition;
+    GIOChannel *channel = g_io_channel_unix_new(sock);
+    socket_watch = g_io_add_watch(channel, condition | G_IO_HUP | G_IO_ERR,
+        _connection_socket_ready, NULL);
+    g_io_channel_unref(channel);
+}
+
+static gboolean
+_connection_socket_readable(void)
+{
+    struct pollfd pfd;
+    pfd.fd = socket_fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    return (poll(&pfd, 1, 0) > 0) && (pfd.revents & POLLIN);
+}
+
+static int
+_connection_stanza_seen(xmpp_conn_t * const conn,
+    xmpp_stanza_t * const stanza, void * const userdata)
+{
+    stanzas_seen++;
+    return 1;
+}
+#endif
+
+static void
+_connection_unwatch(void)
+{
+    if (socket_watch != 0) {
+        g_source_remove(socket_watch);
+        socket_watch = 0;
+    }
+    if (service_timer != 0) {
+        g_source_remove(service_timer);
+        service_timer = 0;
     }
 }
 
@@ -468,23 +708,19 @@ _connection_handler(xmpp_conn_t * const conn,
         bookmark_request();
         jabber_conn.conn_status = JABBER_CONNECTED;
 
-        if (prefs_get_reconnect() != 0) {
-            if (reconnect_timer != NULL) {
-                g_timer_destroy(reconnect_timer);
-                reconnect_timer = NULL;
-            }
-        }
+        _reconnect_timer_stop();
 
     } else if (status == XMPP_CONN_DISCONNECT) {
         log_debug("Connection handler: XMPP_CONN_DISCONNECT");
+        _connection_unwatch();
 
         // lost connection for unknown reason
         if (jabber_conn.conn_status == JABBER_CONNECTED) {
             log_debug("Connection handler: Lost connection for unknown reason");
             handle_lost_connection();
             if (prefs_get_reconnect() != 0) {
-                assert(reconnect_timer == NULL);
-                reconnect_timer = g_timer_new();
+                assert(reconnect_timer == 0);
+                _reconnect_timer_start();
                 // free resources but leave saved_user untouched
                 _connection_free_session_data();
             } else {
@@ -496,7 +732,7 @@ _connection_handler(xmpp_conn_t * const conn,
         // login attempt failed
         } else if (jabber_conn.conn_status != JABBER_DISCONNECTING) {
             log_debug("Connection handler: Login failed");
-            if (reconnect_timer == NULL) {
+            if (reconnect_timer == 0) {
                 log_debug("Connection handler: No reconnect timer");
                 handle_failed_login();
                 _connection_free_saved_account();
@@ -505,7 +741,7 @@ _connection_handler(xmpp_conn_t * const conn,
             } else {
                 log_debug("Connection handler: Restarting reconnect timer");
                 if (prefs_get_reconnect() != 0) {
-                    g_timer_start(reconnect_timer);
+                    _reconnect_timer_start();
                 }
                 // free resources but leave saved_user untouched
                 _connection_free_session_data();
@@ -58,6 +58,9 @@
 
 #define HANDLE(ns, type, func) xmpp_handler_add(conn, func, ns, STANZA_NAME_IQ, type, ctx)
 
+// main loop source for autoping, 0 when not running
+static guint autoping_timer = 0;
+
 static int _error_handler(xmpp_conn_t * const conn,
     xmpp_stanza_t * const stanza, void * const userdata);
 static int _ping_get_handler(xmpp_conn_t * const conn,
@@ -82,8 +85,9 @@ static int _room_config_submit_handler(xmpp_conn_t * const conn,
     xmpp_stanza_t * const stanza, void * const userdata);
 static int _manual_pong_handler(xmpp_conn_t *const conn,
     xmpp_stanza_t * const stanza, void * const userdata);
-static int _ping_timed_handler(xmpp_conn_t * const conn,
-    void * const userdata);
+static gboolean _ping_timed_handler(gpointer data);
+static void _autoping_timer_start(const int seconds);
+static void _autoping_timer_stop(void);
 static int _caps_response_handler(xmpp_conn_t *const conn,
     xmpp_stanza_t * const stanza, void * const userdata);
 
@@ -105,26 +109,33 @@ iq_add_handlers(void)
 
     HANDLE(STANZA_NS_PING,      STANZA_TYPE_GET,    _ping_get_handler);
 
-    if (prefs_get_autoping() != 0) {
-        int millis = prefs_get_autoping() * 1000;
-        xmpp_timed_handler_add(conn, _ping_timed_handler, millis, ctx);
-    }
+    _autoping_timer_start(prefs_get_autoping());
 }
 
 static void
 _iq_set_autoping(const int seconds)
 {
-    xmpp_conn_t * const conn = connection_get_conn();
-    xmpp_ctx_t * const ctx = connection_get_ctx();
-
     if (jabber_get_connection_status() == JABBER_CONNECTED) {
-        xmpp_timed_handler_delete(conn, _ping_timed_handler);
+        _autoping_timer_start(seconds);
+    }
+}
 
-        if (seconds != 0) {
-            int millis = seconds * 1000;
-            xmpp_timed_handler_add(conn, _ping_timed_handler, millis,
-                ctx);
-        }
+static void
+_autoping_timer_start(const int seconds)
+{
+    _autoping_timer_stop();
+
+    if (seconds != 0) {
+        autoping_timer = g_timeout_add_seconds(seconds, _ping_timed_handler, NULL);
+    }
+}
+
+static void
+_autoping_timer_stop(void)
+{
+    if (autoping_timer != 0) {
+        g_source_remove(autoping_timer);
+        autoping_timer = 0;
     }
 }
 
@@ -324,7 +335,7 @@ _pong_handler(xmpp_conn_t *const conn, xmpp_stanza_t * const stanza,
                     if (strcmp(errtype, "cancel") == 0) {
                         log_warning("Server ping (id=%s) error type 'cancel', disabling autoping.", id);
                         handle_autoping_cancel();
-                        xmpp_timed_handler_delete(conn, _ping_timed_handler);
+                        _autoping_timer_stop();
                     }
                 }
             }
@@ -360,17 +371,20 @@ _caps_response_handler(xmpp_conn_t *const conn, xmpp_stanza_t * const stanza,
         char *error_message = stanza_get_error_message(stanza);
         log_warning("Error received for capabilities response from %s: ", from, error_message);
         free(error_message);
+        caps_request_failed(id);
         return 0;
     }
 
     if (query == NULL) {
         log_warning("No query element found.");
+        caps_request_failed(id);
         return 0;
     }
 
     char *node = xmpp_stanza_get_attribute(query, STANZA_ATTR_NODE);
     if (node == NULL) {
         log_warning("No node attribute found");
+        caps_request_failed(id);
         return 0;
     }
 
@@ -383,6 +397,7 @@ _caps_response_handler(xmpp_conn_t *const conn, xmpp_stanza_t * const stanza,
         log_warning("Generated sha-1 does not match given:");
         log_warning("Generated : %s", generated_sha1);
         log_warning("Given     : %s", given_sha1);
+        caps_request_failed(id);
     } else {
         log_info("Valid SHA-1 hash found: %s", given_sha1);
 
@@ -392,10 +407,11 @@ _caps_response_handler(xmpp_conn_t *const conn, xmpp_stanza_t * const stanza,
             log_info("Capabilities not cached: %s, storing", given_sha1);
             Capabilities *capabilities = caps_create(query);
             caps_add(given_sha1, capabilities);
-            caps_destroy(capabilities);
+            caps_unref(capabilities);
         }
 
         caps_map(from, given_sha1);
+        caps_request_complete(given_sha1);
     }
 
     g_free(generated_sha1);
@@ -432,24 +448,28 @@ _manual_pong_handler(xmpp_conn_t *const conn, xmpp_stanza_t * const stanza,
     return 0;
 }
 
-static int
-_ping_timed_handler(xmpp_conn_t * const conn, void * const userdata)
+static gboolean
+_ping_timed_handler(gpointer data)
 {
-    xmpp_ctx_t *ctx = (xmpp_ctx_t *)userdata;
+    // stop pinging once the connection has gone, restarted on next login
+    if (jabber_get_connection_status() != JABBER_CONNECTED) {
+        autoping_timer = 0;
+        return FALSE;
+    }
 
-    if (jabber_get_connection_status() == JABBER_CONNECTED) {
+    xmpp_conn_t * const conn = connection_get_conn();
+    xmpp_ctx_t * const ctx = connection_get_ctx();
 
-        xmpp_stanza_t *iq = stanza_create_ping_iq(ctx, NULL);
-        char *id = xmpp_stanza_get_id(iq);
+    xmpp_stanza_t *iq = stanza_create_ping_iq(ctx, NULL);
+    char *id = xmpp_stanza_get_id(iq);
 
-        // add pong handler
-        xmpp_id_handler_add(conn, _pong_handler, id, ctx);
+    // add pong handler
+    xmpp_id_handler_add(conn, _pong_handler, id, ctx);
 
-        xmpp_send(conn, iq);
-        xmpp_stanza_release(iq);
-    }
+    xmpp_send(conn, iq);
+    xmpp_stanza_release(iq);
 
-    return 1;
+    return TRUE;
 }
 
 static int
@@ -90,9 +90,11 @@ _message_send(const char * const msg, const char * const recipient)
         jid = recipient;
     }
 
+    // without capabilities to go by, send <active/> to find out
     if (prefs_get_boolean(PREF_STATES)) {
         if (!chat_session_exists(jid)) {
-            chat_session_start(jid, TRUE);
+            chat_session_start(jid, !caps_jid_known(jid) ||
+                caps_jid_supports(jid, STANZA_NS_CHATSTATES));
         }
     }
 
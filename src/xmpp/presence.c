@@ -516,13 +516,9 @@ _handle_caps(xmpp_stanza_t *const stanza)
                     log_info("Capabilities cached: %s", ver);
                     caps_map(from, ver);
                 } else {
-                    log_info("Capabilities not cached: %s, sending service discovery request", ver);
+                    log_info("Capabilities not cached: %s, requesting service discovery", ver);
                     char *node = stanza_caps_get_node(stanza);
-                    char *id = create_unique_id("caps");
-
-                    iq_send_caps_request(from, id, node, ver);
-
-                    free(id);
+                    caps_request(from, node, ver);
                 }
             }
 
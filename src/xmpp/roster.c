@@ -33,12 +33,14 @@
  */
 
 #include <assert.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include <glib.h>
 #include <strophe.h>
 
+#include "common.h"
 #include "log.h"
 #include "profanity.h"
 #include "server_events.h"
@@ -52,6 +54,16 @@
 #define HANDLE(type, func) xmpp_handler_add(conn, func, XMPP_NS_ROSTER, \
 STANZA_NAME_IQ, type, ctx)
 
+// roster cache group holding the roster version
+#define CACHE_ROSTER ":roster"
+
+// roster pushes arrive in bursts, write the cache once they settle
+#define CACHE_SAVE_DELAY_MS 500
+
+// cached roster and version for the logged in jid (XEP-0237)
+static gchar *cache_loc;
+static GKeyFile *cache;
+
 // callback data for group commands
 typedef struct _group_data {
     char *name;
@@ -75,6 +87,20 @@ _group_remove_handler(xmpp_conn_t * const conn, xmpp_stanza_t * const stanza,
 // helper functions
 GSList * _get_groups_from_item(xmpp_stanza_t *item);
 
+// roster cache functions
+static void _cache_load(void);
+static void _cache_save(void);
+static void _cache_set_ver(const char * const ver);
+static void _cache_add(const char * const barejid, const char * const name,
+    GSList *groups, const char * const sub, gboolean pending_out);
+static void _cache_remove(const char * const barejid);
+static void _cache_to_roster(void);
+static gchar * _cache_group(const char * const barejid);
+static gchar * _cache_barejid(const char * const group);
+
+static DelayedWrite cache_write = { CACHE_SAVE_DELAY_MS, DELAYED_WRITE_MAX_MS,
+    _cache_save, 0, 0 };
+
 void
 roster_add_handlers(void)
 {
@@ -90,9 +116,21 @@ roster_request(void)
 {
     xmpp_conn_t * const conn = connection_get_conn();
     xmpp_ctx_t * const ctx = connection_get_ctx();
-    xmpp_stanza_t *iq = stanza_create_roster_iq(ctx);
+
+    // only send a version if the server gave us one, which it will only do
+    // if it supports roster versioning
+    _cache_load();
+    char *ver = g_key_file_get_string(cache, CACHE_ROSTER, STANZA_ATTR_VER, NULL);
+    xmpp_stanza_t *iq = stanza_create_roster_iq(ctx, ver);
     xmpp_send(conn, iq);
     xmpp_stanza_release(iq);
+    g_free(ver);
+}
+
+void
+roster_cache_flush(void)
+{
+    delayed_write_flush(&cache_write);
 }
 
 static void
@@ -244,6 +282,7 @@ _roster_set_handler(xmpp_conn_t * const conn, xmpp_stanza_t * const stanza,
     const char *name = xmpp_stanza_get_attribute(item, STANZA_ATTR_NAME);
     const char *sub = xmpp_stanza_get_attribute(item, STANZA_ATTR_SUBSCRIPTION);
     const char *ask = xmpp_stanza_get_attribute(item, STANZA_ATTR_ASK);
+    const char *ver = xmpp_stanza_get_attribute(query, STANZA_ATTR_VER);
 
     // remove from roster
     if (g_strcmp0(sub, "remove") == 0) {
@@ -252,6 +291,11 @@ _roster_set_handler(xmpp_conn_t * const conn, xmpp_stanza_t * const stanza,
             name = barejid;
         }
 
+        if (ver != NULL) {
+            _cache_remove(barejid);
+            _cache_set_ver(ver);
+        }
+
         roster_remove(name, barejid);
 
         handle_roster_remove(barejid);
@@ -267,6 +311,11 @@ _roster_set_handler(xmpp_conn_t * const conn, xmpp_stanza_t * const stanza,
 
         GSList *groups = _get_groups_from_item(item);
 
+        if (ver != NULL) {
+            _cache_add(barejid, name, groups, sub, pending_out);
+            _cache_set_ver(ver);
+        }
+
         // update the local roster
         PContact contact = roster_get_contact(barejid);
         if (contact == NULL) {
@@ -292,33 +341,61 @@ _roster_result_handler(xmpp_conn_t * const conn, xmpp_stanza_t * const stanza,
     if (g_strcmp0(id, "roster") == 0) {
         xmpp_stanza_t *query = xmpp_stanza_get_child_by_name(stanza,
             STANZA_NAME_QUERY);
-        xmpp_stanza_t *item = xmpp_stanza_get_children(query);
-
-        while (item != NULL) {
-            const char *barejid =
-                xmpp_stanza_get_attribute(item, STANZA_ATTR_JID);
-            const char *name =
-                xmpp_stanza_get_attribute(item, STANZA_ATTR_NAME);
-            const char *sub =
-                xmpp_stanza_get_attribute(item, STANZA_ATTR_SUBSCRIPTION);
-
-            gboolean pending_out = FALSE;
-            const char *ask = xmpp_stanza_get_attribute(item, STANZA_ATTR_ASK);
-            if (g_strcmp0(ask, "subscribe") == 0) {
-                pending_out = TRUE;
-            }
 
-            GSList *groups = _get_groups_from_item(item);
+        roster_batch_begin();
 
-            gboolean added = roster_add(barejid, name, groups, sub, pending_out);
+        // empty result, roster unchanged since the cached version
+        if (query == NULL) {
+            log_debug("Roster unchanged, loading from cache");
+            _cache_to_roster();
 
-            if (!added) {
-                log_warning("Attempt to add contact twice: %s", barejid);
+        // full roster
+        } else {
+            const char *ver = xmpp_stanza_get_attribute(query, STANZA_ATTR_VER);
+            g_key_file_free(cache);
+            cache = g_key_file_new();
+
+            xmpp_stanza_t *item = xmpp_stanza_get_children(query);
+            while (item != NULL) {
+                const char *barejid =
+                    xmpp_stanza_get_attribute(item, STANZA_ATTR_JID);
+                const char *name =
+                    xmpp_stanza_get_attribute(item, STANZA_ATTR_NAME);
+                const char *sub =
+                    xmpp_stanza_get_attribute(item, STANZA_ATTR_SUBSCRIPTION);
+
+                gboolean pending_out = FALSE;
+                const char *ask = xmpp_stanza_get_attribute(item, STANZA_ATTR_ASK);
+                if (g_strcmp0(ask, "subscribe") == 0) {
+                    pending_out = TRUE;
+                }
+
+                GSList *groups = _get_groups_from_item(item);
+
+                if (ver != NULL) {
+                    _cache_add(barejid, name, groups, sub, pending_out);
+                }
+
+                gboolean added = roster_add(barejid, name, groups, sub, pending_out);
+
+                if (!added) {
+                    log_warning("Attempt to add contact twice: %s", barejid);
+                }
+
+                item = xmpp_stanza_get_next(item);
             }
 
-            item = xmpp_stanza_get_next(item);
+            // server does not support roster versioning
+            if (ver == NULL) {
+                delayed_write_flush(&cache_write);
+                remove(cache_loc);
+            } else {
+                _cache_set_ver(ver);
+            }
         }
 
+        roster_batch_commit();
+
         resource_presence_t conn_presence =
             accounts_get_login_presence(jabber_get_account_name());
         presence_update(conn_presence, NULL, 0);
@@ -346,6 +423,170 @@ _get_groups_from_item(xmpp_stanza_t *item)
     return groups;
 }
 
+static void
+_cache_load(void)
+{
+    // anything pending belongs to the cache being replaced
+    delayed_write_flush(&cache_write);
+
+    Jid *my_jid = jid_create(jabber_get_fulljid());
+    gchar *xdg_data = xdg_get_data_home();
+    GString *cache_file = g_string_new(xdg_data);
+    g_string_append(cache_file, "/profanity/rosters/");
+    gchar *account_file = str_replace(my_jid->barejid, "@", "_at_");
+    g_string_append(cache_file, account_file);
+    free(account_file);
+    g_free(xdg_data);
+    jid_destroy(my_jid);
+
+    g_free(cache_loc);
+    cache_loc = g_string_free(cache_file, FALSE);
+
+    if (cache != NULL) {
+        g_key_file_free(cache);
+    }
+    cache = g_key_file_new();
+    g_key_file_load_from_file(cache, cache_loc, G_KEY_FILE_KEEP_COMMENTS,
+        NULL);
+}
+
+static void
+_cache_save(void)
+{
+    gsize g_data_size;
+    gchar *g_cache_data = g_key_file_to_data(cache, &g_data_size, NULL);
+    g_file_set_contents(cache_loc, g_cache_data, g_data_size, NULL);
+    g_free(g_cache_data);
+}
+
+static void
+_cache_set_ver(const char * const ver)
+{
+    g_key_file_set_string(cache, CACHE_ROSTER, STANZA_ATTR_VER, ver);
+    delayed_write_schedule(&cache_write);
+}
+
+static void
+_cache_add(const char * const barejid, const char * const name,
+    GSList *groups, const char * const sub, gboolean pending_out)
+{
+    // replace any previous entry
+    _cache_remove(barejid);
+
+    gchar *group = _cache_group(barejid);
+    if (name != NULL) {
+        g_key_file_set_string(cache, group, "name", name);
+    }
+    if (sub != NULL) {
+        g_key_file_set_string(cache, group, "subscription", sub);
+    }
+    g_key_file_set_boolean(cache, group, "pending_out", pending_out);
+
+    if (groups != NULL) {
+        int num = g_slist_length(groups);
+        const gchar* groups_list[num];
+        int curr = 0;
+        while (groups != NULL) {
+            groups_list[curr++] = groups->data;
+            groups = g_slist_next(groups);
+        }
+        g_key_file_set_string_list(cache, group, "groups", groups_list, num);
+    }
+    g_free(group);
+}
+
+static void
+_cache_remove(const char * const barejid)
+{
+    gchar *group = _cache_group(barejid);
+    if (g_key_file_has_group(cache, group)) {
+        g_key_file_remove_group(cache, group, NULL);
+    }
+    g_free(group);
+}
+
+static void
+_cache_to_roster(void)
+{
+    gsize num_jids = 0;
+    gchar **jids = g_key_file_get_groups(cache, &num_jids);
+
+    gsize i;
+    for (i = 0; i < num_jids; i++) {
+        const gchar *group = jids[i];
+        if (strcmp(group, CACHE_ROSTER) == 0) {
+            continue;
+        }
+
+        gchar *name = g_key_file_get_string(cache, group, "name", NULL);
+        gchar *sub = g_key_file_get_string(cache, group, "subscription", NULL);
+        gboolean pending_out =
+            g_key_file_get_boolean(cache, group, "pending_out", NULL);
+
+        GSList *groups = NULL;
+        gsize num_groups = 0;
+        gchar **groups_list = g_key_file_get_string_list(cache, group,
+            "groups", &num_groups, NULL);
+        gsize j;
+        for (j = 0; j < num_groups; j++) {
+            groups = g_slist_append(groups, g_strdup(groups_list[j]));
+        }
+        g_strfreev(groups_list);
+
+        gchar *barejid = _cache_barejid(group);
+        roster_add(barejid, name, groups, sub, pending_out);
+
+        g_free(barejid);
+        g_free(name);
+        g_free(sub);
+    }
+
+    g_strfreev(jids);
+}
+
+/*
+ * Key file group names may not contain '[' or ']', which a jid can (for
+ * example an IPv6 literal domain). '&' is not allowed anywhere in a jid,
+ * so it is safe to use as the escape character.
+ */
+static gchar *
+_cache_group(const char * const barejid)
+{
+    GString *group = g_string_new(NULL);
+    const char *c;
+    for (c = barejid; *c != '\0'; c++) {
+        if (*c == '[') {
+            g_string_append(group, "&5b");
+        } else if (*c == ']') {
+            g_string_append(group, "&5d");
+        } else {
+            g_string_append_c(group, *c);
+        }
+    }
+
+    return g_string_free(group, FALSE);
+}
+
+static gchar *
+_cache_barejid(const char * const group)
+{
+    GString *barejid = g_string_new(NULL);
+    const char *c;
+    for (c = group; *c != '\0'; c++) {
+        if (g_str_has_prefix(c, "&5b")) {
+            g_string_append_c(barejid, '[');
+            c += 2;
+        } else if (g_str_has_prefix(c, "&5d")) {
+            g_string_append_c(barejid, ']');
+            c += 2;
+        } else {
+            g_string_append_c(barejid, *c);
+        }
+    }
+
+    return g_string_free(barejid, FALSE);
+}
+
 void
 roster_init_module(void)
 {
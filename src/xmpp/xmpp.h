@@ -73,7 +73,17 @@ typedef struct capabilities_t {
     char *software_version;
     char *os;
     char *os_version;
-    GSList *features;
+
+    // interned and sorted, without duplicates
+    const gchar **features;
+    guint num_features;
+
+    // a bit per feature id, built when first asked, see caps_jid_supports
+    guint32 *feature_bits;
+    guint num_feature_words;
+
+    // instances are shared by every jid with the same ver
+    gint refs;
 } Capabilities;
 
 typedef struct disco_item_t {
@@ -194,8 +204,10 @@ void (*iq_send_caps_request)(const char * const to, const char * const id,
 
 // caps functions
 Capabilities* (*caps_lookup)(const char * const jid);
+gboolean (*caps_jid_known)(const char * const jid);
+gboolean (*caps_jid_supports)(const char * const jid, const char * const feature);
 void (*caps_close)(void);
-void (*caps_destroy)(Capabilities *caps);
+void (*caps_unref)(Capabilities *caps);
 
 gboolean (*bookmark_add)(const char *jid, const char *nick, const char *password, const char *autojoin_str);
 gboolean (*bookmark_update)(const char *jid, const char *nick, const char *password, const char *autojoin_str);
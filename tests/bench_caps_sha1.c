@@ -0,0 +1,154 @@
+/*
+ * Compare SHA-1 throughput on XEP-0115 verification strings, build with
+ * make tests/bench_caps_sha1
+ *
+ * The corpus is made up like the disco#info responses seen from real
+ * clients: one or two identities, a few dozen features and sometimes a
+ * softwareinfo form.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+
+#include "tools/sha1.h"
+
+#define CORPUS_SIZE 1000
+#define ROUNDS 200
+
+static const char *features[] = {
+    "http://jabber.org/protocol/caps",
+    "http://jabber.org/protocol/chatstates",
+    "http://jabber.org/protocol/disco#info",
+    "http://jabber.org/protocol/disco#items",
+    "http://jabber.org/protocol/muc",
+    "http://jabber.org/protocol/muc#user",
+    "http://jabber.org/protocol/ibb",
+    "http://jabber.org/protocol/si",
+    "http://jabber.org/protocol/si/profile/file-transfer",
+    "http://jabber.org/protocol/bytestreams",
+    "http://jabber.org/protocol/xhtml-im",
+    "http://jabber.org/protocol/mood+notify",
+    "http://jabber.org/protocol/tune+notify",
+    "http://jabber.org/protocol/geoloc+notify",
+    "http://jabber.org/protocol/nick+notify",
+    "http://jabber.org/protocol/activity+notify",
+    "jabber:iq:last",
+    "jabber:iq:privacy",
+    "jabber:iq:roster",
+    "jabber:iq:time",
+    "jabber:iq:version",
+    "jabber:x:conference",
+    "jabber:x:data",
+    "urn:xmpp:attention:0",
+    "urn:xmpp:avatar:metadata+notify",
+    "urn:xmpp:bob",
+    "urn:xmpp:carbons:2",
+    "urn:xmpp:jingle:1",
+    "urn:xmpp:jingle:apps:rtp:1",
+    "urn:xmpp:jingle:apps:rtp:audio",
+    "urn:xmpp:jingle:apps:rtp:video",
+    "urn:xmpp:jingle:transports:ice-udp:1",
+    "urn:xmpp:mam:0",
+    "urn:xmpp:message-correct:0",
+    "urn:xmpp:ping",
+    "urn:xmpp:receipts",
+    "urn:xmpp:time",
+    "vcard-temp"
+};
+
+static GPtrArray *
+_create_corpus(void)
+{
+    GPtrArray *corpus = g_ptr_array_new_with_free_func(g_free);
+    GRand *rand = g_rand_new_with_seed(115);
+    int num_features = G_N_ELEMENTS(features);
+
+    int i;
+    for (i = 0; i < CORPUS_SIZE; i++) {
+        GString *s = g_string_new("client/pc//");
+        g_string_append_printf(s, "Client %d<", g_rand_int_range(rand, 0, 100));
+        if (g_rand_boolean(rand)) {
+            g_string_append_printf(s, "client/pc/en/Client %d<", i);
+        }
+
+        // features are listed in order, pick each with the same chance
+        int wanted = g_rand_int_range(rand, 5, num_features);
+        int j;
+        for (j = 0; j < num_features; j++) {
+            if (g_rand_int_range(rand, 0, num_features) < wanted) {
+                g_string_append(s, features[j]);
+                g_string_append_c(s, '<');
+            }
+        }
+
+        if (g_rand_boolean(rand)) {
+            g_string_append_printf(s,
+                "urn:xmpp:dataforms:softwareinfo<os<Linux<os_version<3.%d<"
+                "software<Client<software_version<0.%d.%d<",
+                g_rand_int_range(rand, 0, 20), g_rand_int_range(rand, 0, 10),
+                g_rand_int_range(rand, 0, 10));
+        }
+
+        g_ptr_array_add(corpus, g_string_free(s, FALSE));
+    }
+
+    g_rand_free(rand);
+    return corpus;
+}
+
+static void
+_run(const char * const name, GPtrArray *corpus, gsize bytes,
+    void (*digest_func)(const void * const, size_t, unsigned char *))
+{
+    unsigned char digest[SHA1_DIGEST_SIZE];
+    GTimer *timer = g_timer_new();
+
+    int round;
+    for (round = 0; round < ROUNDS; round++) {
+        guint i;
+        for (i = 0; i < corpus->len; i++) {
+            const char *str = g_ptr_array_index(corpus, i);
+            digest_func(str, strlen(str), digest);
+        }
+    }
+
+    gdouble secs = g_timer_elapsed(timer, NULL);
+    g_timer_destroy(timer);
+
+    gdouble hashes = (gdouble)corpus->len * ROUNDS;
+    printf("%-12s %10.0f hashes/s %8.1f MB/s\n", name, hashes / secs,
+        ((gdouble)bytes * ROUNDS) / secs / (1024 * 1024));
+}
+
+int
+main(void)
+{
+    GPtrArray *corpus = _create_corpus();
+    gsize bytes = 0;
+    guint i;
+    for (i = 0; i < corpus->len; i++) {
+        bytes += strlen(g_ptr_array_index(corpus, i));
+    }
+    printf("%u verification strings, %lu bytes on average\n", corpus->len,
+        (unsigned long)(bytes / corpus->len));
+
+    // check the two agree before timing them
+    for (i = 0; i < corpus->len; i++) {
+        const char *str = g_ptr_array_index(corpus, i);
+        unsigned char a[SHA1_DIGEST_SIZE], b[SHA1_DIGEST_SIZE];
+        sha1_digest_portable(str, strlen(str), a);
+        sha1_digest(str, strlen(str), b);
+        if (memcmp(a, b, SHA1_DIGEST_SIZE) != 0) {
+            printf("Digests differ for: %s\n", str);
+            return 1;
+        }
+    }
+
+    _run("portable", corpus, bytes, sha1_digest_portable);
+    _run(sha1_backend(), corpus, bytes, sha1_digest);
+
+    g_ptr_array_free(corpus, TRUE);
+    return 0;
+}
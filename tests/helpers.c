@@ -53,6 +53,7 @@ void remove_data_dir(void **state)
 {
     rmdir("./tests/files/xdg_data_home/profanity");
     rmdir("./tests/files/xdg_data_home");
+    rmdir("./tests/files");
 }
 
 void load_preferences(void **state)
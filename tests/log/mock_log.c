@@ -26,6 +26,8 @@
 
 #include "log.h"
 
+log_level_t log_level_filter = PROF_LEVEL_DEBUG;
+
 void log_init(log_level_t filter) {}
 log_level_t log_get_filter(void)
 {
@@ -33,10 +35,7 @@ log_level_t log_get_filter(void)
 }
 void log_reinit(void) {}
 void log_close(void) {}
-void log_debug(const char * const msg, ...) {}
-void log_info(const char * const msg, ...) {}
-void log_warning(const char * const msg, ...) {}
-void log_error(const char * const msg, ...) {}
+void log_format(log_level_t level, const char * const msg, ...) {}
 void log_msg(log_level_t level, const char * const area,
     const char * const msg) {}
 char * get_log_file_location(void)
@@ -53,9 +52,38 @@ void chat_log_init(void) {}
 void chat_log_chat(const gchar * const login, gchar *other,
     const gchar * const msg, chat_log_direction_t direction, GTimeVal *tv_stamp) {}
 void chat_log_close(void) {}
+void chat_log_update_flush_policy(void) {}
+void chat_log_flush(void) {}
 GSList * chat_log_get_previous(const gchar * const login,
-    const gchar * const recipient)
+    const gchar * const recipient, int max_lines, ChatLogPos *start)
+{
+    return mock_ptr_type(GSList *);
+}
+
+ChatLogPos chat_log_get_end(const gchar * const login,
+    const gchar * const recipient, gboolean room)
+{
+    ChatLogPos end = { 0, 0 };
+    return end;
+}
+
+// each page read moves back one line
+GSList * chat_log_get_before(const gchar * const login,
+    const gchar * const recipient, gboolean room, ChatLogPos *pos,
+    long *end, int max_lines)
+{
+    GSList *lines = mock_ptr_type(GSList *);
+    if (lines != NULL) {
+        *end = pos->offset;
+        pos->offset--;
+    }
+    return lines;
+}
+
+GSList * chat_log_get_range(const gchar * const login,
+    const gchar * const recipient, gboolean room, ChatLogPos start, long end)
 {
+    check_expected(end);
     return mock_ptr_type(GSList *);
 }
 
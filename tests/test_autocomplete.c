@@ -113,3 +113,69 @@ void add_two_same_updates(void **state)
 
     autocomplete_clear(ac);
 }
+
+void complete_cycles_back_to_first(void **state)
+{
+    Autocomplete ac = autocomplete_new();
+    autocomplete_add(ac, "Hello");
+    autocomplete_add(ac, "Help");
+    autocomplete_add(ac, "Other");
+    char *result1 = autocomplete_complete(ac, "Hel", TRUE);
+    char *result2 = autocomplete_complete(ac, result1, TRUE);
+    char *result3 = autocomplete_complete(ac, result2, TRUE);
+
+    assert_string_equal("Hello", result3);
+
+    free(result1);
+    free(result2);
+    free(result3);
+    autocomplete_clear(ac);
+}
+
+void complete_continues_after_add_before_last_found(void **state)
+{
+    Autocomplete ac = autocomplete_new();
+    autocomplete_add(ac, "Hello");
+    autocomplete_add(ac, "Help");
+    char *result1 = autocomplete_complete(ac, "Hel", TRUE);
+    autocomplete_add(ac, "Abc");
+    char *result2 = autocomplete_complete(ac, result1, TRUE);
+
+    assert_string_equal("Help", result2);
+
+    free(result1);
+    free(result2);
+    autocomplete_clear(ac);
+}
+
+void remove_and_contains(void **state)
+{
+    Autocomplete ac = autocomplete_new();
+    autocomplete_add(ac, "Hello");
+    autocomplete_add(ac, "Help");
+    autocomplete_add(ac, "Other");
+    autocomplete_remove(ac, "Help");
+
+    assert_int_equal(2, autocomplete_length(ac));
+    assert_true(autocomplete_contains(ac, "Hello"));
+    assert_false(autocomplete_contains(ac, "Help"));
+    assert_true(autocomplete_contains(ac, "Other"));
+
+    autocomplete_clear(ac);
+}
+
+void get_list_is_sorted(void **state)
+{
+    Autocomplete ac = autocomplete_new();
+    autocomplete_add(ac, "Charlie");
+    autocomplete_add(ac, "Alpha");
+    autocomplete_add(ac, "Bravo");
+    GSList *result = autocomplete_get_list(ac);
+
+    assert_string_equal("Alpha", g_slist_nth_data(result, 0));
+    assert_string_equal("Bravo", g_slist_nth_data(result, 1));
+    assert_string_equal("Charlie", g_slist_nth_data(result, 2));
+
+    g_slist_free_full(result, free);
+    autocomplete_clear(ac);
+}
@@ -8,3 +8,7 @@ void add_two_and_complete_returns_second(void **state);
 void add_two_adds_two(void **state);
 void add_two_same_adds_one(void **state);
 void add_two_same_updates(void **state);
+void complete_cycles_back_to_first(void **state);
+void complete_continues_after_add_before_last_found(void **state);
+void remove_and_contains(void **state);
+void get_list_is_sorted(void **state);
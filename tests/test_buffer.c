@@ -0,0 +1,69 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdlib.h>
+
+#include "ui/buffer.h"
+
+void buffer_empty_after_create(void **state)
+{
+    ProfBuff buffer = buffer_create(3);
+    assert_int_equal(0, buffer_size(buffer));
+    buffer_free(buffer);
+}
+
+void buffer_push_stores_entry(void **state)
+{
+    ProfBuff buffer = buffer_create(3);
+    buffer_push(buffer, '-', "%H:%M", 0, 0, "bob", "hello");
+
+    ProfBuffEntry *entry = buffer_yield_entry(buffer, 0);
+    assert_int_equal(1, buffer_size(buffer));
+    assert_int_equal('-', entry->show_char);
+    assert_string_equal("%H:%M", entry->date_fmt);
+    assert_string_equal("bob", entry->from);
+    assert_string_equal("hello", entry->message);
+    buffer_free(buffer);
+}
+
+void buffer_push_when_full_drops_oldest(void **state)
+{
+    ProfBuff buffer = buffer_create(3);
+    buffer_push(buffer, '-', "", 0, 0, "", "one");
+    buffer_push(buffer, '-', "", 0, 0, "", "two");
+    buffer_push(buffer, '-', "", 0, 0, "", "three");
+    buffer_push(buffer, '-', "", 0, 0, "", "four");
+    buffer_push(buffer, '-', "", 0, 0, "", "five");
+
+    assert_int_equal(3, buffer_size(buffer));
+    assert_string_equal("three", buffer_yield_entry(buffer, 0)->message);
+    assert_string_equal("four", buffer_yield_entry(buffer, 1)->message);
+    assert_string_equal("five", buffer_yield_entry(buffer, 2)->message);
+    buffer_free(buffer);
+}
+
+void buffer_push_entry_has_no_layout(void **state)
+{
+    ProfBuff buffer = buffer_create(3);
+    buffer_push(buffer, '-', "", 0, 0, "", "hello");
+
+    assert_int_equal(0, buffer_yield_entry(buffer, 0)->layout_width);
+    buffer_free(buffer);
+}
+
+void buffer_pushed_counts_dropped_entries(void **state)
+{
+    ProfBuff buffer = buffer_create(3);
+    assert_int_equal(0, buffer_pushed(buffer));
+
+    buffer_push(buffer, '-', "", 0, 0, "", "one");
+    buffer_push(buffer, '-', "", 0, 0, "", "two");
+    buffer_push(buffer, '-', "", 0, 0, "", "three");
+    buffer_push(buffer, '-', "", 0, 0, "", "four");
+    buffer_push(buffer, '-', "", 0, 0, "", "five");
+
+    assert_int_equal(5, buffer_pushed(buffer));
+    assert_int_equal(3, buffer_size(buffer));
+    buffer_free(buffer);
+}
@@ -0,0 +1,5 @@
+void buffer_empty_after_create(void **state);
+void buffer_push_stores_entry(void **state);
+void buffer_push_when_full_drops_oldest(void **state);
+void buffer_push_entry_has_no_layout(void **state);
+void buffer_pushed_counts_dropped_entries(void **state);
@@ -0,0 +1,395 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <glib.h>
+#include <strophe.h>
+
+#include "helpers.h"
+#include "roster_list.h"
+#include "xmpp/stanza.h"
+#include "xmpp/capabilities.h"
+#include "xmpp/mock_xmpp.h"
+
+#define CACHE_FILE "./tests/files/xdg_data_home/profanity/capscache.bin"
+#define NODE "http://code.google.com/p/exodus"
+#define VER "QgayPKawpkPSDYmwT/WM94uAlu0="
+
+static xmpp_stanza_t *
+_add_child(xmpp_ctx_t *ctx, xmpp_stanza_t *parent, const char * const name)
+{
+    xmpp_stanza_t *child = xmpp_stanza_new(ctx);
+    xmpp_stanza_set_name(child, name);
+    xmpp_stanza_add_child(parent, child);
+    xmpp_stanza_release(child);
+
+    return child;
+}
+
+static void
+_add_identity(xmpp_ctx_t *ctx, xmpp_stanza_t *query, const char * const lang,
+    const char * const name)
+{
+    xmpp_stanza_t *identity = _add_child(ctx, query, STANZA_NAME_IDENTITY);
+    xmpp_stanza_set_attribute(identity, "category", "client");
+    xmpp_stanza_set_attribute(identity, "type", "pc");
+    if (lang != NULL) {
+        xmpp_stanza_set_attribute(identity, "xml:lang", lang);
+    }
+    xmpp_stanza_set_attribute(identity, "name", name);
+}
+
+static void
+_add_feature(xmpp_ctx_t *ctx, xmpp_stanza_t *query, const char * const var)
+{
+    xmpp_stanza_t *feature = _add_child(ctx, query, STANZA_NAME_FEATURE);
+    xmpp_stanza_set_attribute(feature, "var", var);
+}
+
+static void
+_add_field(xmpp_ctx_t *ctx, xmpp_stanza_t *form, const char * const var,
+    const char * const value1, const char * const value2)
+{
+    xmpp_stanza_t *field = _add_child(ctx, form, "field");
+    xmpp_stanza_set_attribute(field, "var", var);
+
+    const char *values[] = { value1, value2 };
+    int i;
+    for (i = 0; i < 2 && values[i] != NULL; i++) {
+        xmpp_stanza_t *value = _add_child(ctx, field, "value");
+        xmpp_stanza_t *text = xmpp_stanza_new(ctx);
+        xmpp_stanza_set_text(text, values[i]);
+        xmpp_stanza_add_child(value, text);
+        xmpp_stanza_release(text);
+    }
+}
+
+static xmpp_stanza_t *
+_new_query(xmpp_ctx_t *ctx)
+{
+    xmpp_stanza_t *query = xmpp_stanza_new(ctx);
+    xmpp_stanza_set_name(query, STANZA_NAME_QUERY);
+    xmpp_stanza_set_ns(query, XMPP_NS_DISCO_INFO);
+
+    return query;
+}
+
+// XEP-0115 5.2
+static xmpp_stanza_t *
+_simple_query(xmpp_ctx_t *ctx)
+{
+    xmpp_stanza_t *query = _new_query(ctx);
+    _add_identity(ctx, query, NULL, "Exodus 0.9.1");
+    _add_feature(ctx, query, "http://jabber.org/protocol/caps");
+    _add_feature(ctx, query, "http://jabber.org/protocol/disco#info");
+    _add_feature(ctx, query, "http://jabber.org/protocol/disco#items");
+    _add_feature(ctx, query, "http://jabber.org/protocol/muc");
+
+    return query;
+}
+
+static void
+_add_softwareinfo(xmpp_ctx_t *ctx, xmpp_stanza_t *query, gboolean reversed)
+{
+    xmpp_stanza_t *form = _add_child(ctx, query, STANZA_NAME_X);
+    xmpp_stanza_set_ns(form, STANZA_NS_DATA);
+    xmpp_stanza_set_attribute(form, "type", "result");
+
+    if (reversed) {
+        _add_field(ctx, form, "software_version", "0.11", NULL);
+        _add_field(ctx, form, "software", "Psi", NULL);
+        _add_field(ctx, form, "os_version", "10.5.1", NULL);
+        _add_field(ctx, form, "os", "Mac", NULL);
+        _add_field(ctx, form, "ip_version", "ipv6", "ipv4");
+        _add_field(ctx, form, "FORM_TYPE", STANZA_DATAFORM_SOFTWARE, NULL);
+    } else {
+        _add_field(ctx, form, "FORM_TYPE", STANZA_DATAFORM_SOFTWARE, NULL);
+        _add_field(ctx, form, "ip_version", "ipv4", "ipv6");
+        _add_field(ctx, form, "os", "Mac", NULL);
+        _add_field(ctx, form, "os_version", "10.5.1", NULL);
+        _add_field(ctx, form, "software", "Psi", NULL);
+        _add_field(ctx, form, "software_version", "0.11", NULL);
+    }
+}
+
+// XEP-0115 5.3
+static xmpp_stanza_t *
+_complex_query(xmpp_ctx_t *ctx, gboolean reversed)
+{
+    xmpp_stanza_t *query = _new_query(ctx);
+
+    if (reversed) {
+        _add_softwareinfo(ctx, query, TRUE);
+        _add_feature(ctx, query, "http://jabber.org/protocol/muc");
+        _add_feature(ctx, query, "http://jabber.org/protocol/disco#items");
+        _add_feature(ctx, query, "http://jabber.org/protocol/disco#info");
+        _add_feature(ctx, query, "http://jabber.org/protocol/caps");
+        _add_identity(ctx, query, "el", "\xce\xa8 0.11");
+        _add_identity(ctx, query, "en", "Psi 0.11");
+    } else {
+        _add_identity(ctx, query, "en", "Psi 0.11");
+        _add_identity(ctx, query, "el", "\xce\xa8 0.11");
+        _add_feature(ctx, query, "http://jabber.org/protocol/caps");
+        _add_feature(ctx, query, "http://jabber.org/protocol/disco#info");
+        _add_feature(ctx, query, "http://jabber.org/protocol/disco#items");
+        _add_feature(ctx, query, "http://jabber.org/protocol/muc");
+        _add_softwareinfo(ctx, query, FALSE);
+    }
+
+    return query;
+}
+
+void caps_sha1_str_simple_generation(void **state)
+{
+    xmpp_ctx_t *ctx = xmpp_ctx_new(NULL, NULL);
+    xmpp_stanza_t *query = _simple_query(ctx);
+
+    char *ver = caps_create_sha1_str(query);
+
+    assert_string_equal("QgayPKawpkPSDYmwT/WM94uAlu0=", ver);
+
+    g_free(ver);
+    xmpp_stanza_release(query);
+    xmpp_ctx_free(ctx);
+}
+
+void caps_sha1_str_complex_generation(void **state)
+{
+    xmpp_ctx_t *ctx = xmpp_ctx_new(NULL, NULL);
+    xmpp_stanza_t *query = _complex_query(ctx, FALSE);
+
+    char *ver = caps_create_sha1_str(query);
+
+    assert_string_equal("q07IKJEyjvHSyhy//CH0CxmKi8w=", ver);
+
+    g_free(ver);
+    xmpp_stanza_release(query);
+    xmpp_ctx_free(ctx);
+}
+
+void caps_sha1_str_ignores_element_order(void **state)
+{
+    xmpp_ctx_t *ctx = xmpp_ctx_new(NULL, NULL);
+    xmpp_stanza_t *query = _complex_query(ctx, TRUE);
+
+    char *ver = caps_create_sha1_str(query);
+
+    assert_string_equal("q07IKJEyjvHSyhy//CH0CxmKi8w=", ver);
+
+    g_free(ver);
+    xmpp_stanza_release(query);
+    xmpp_ctx_free(ctx);
+}
+
+void caps_sha1_str_reused_after_larger_query(void **state)
+{
+    xmpp_ctx_t *ctx = xmpp_ctx_new(NULL, NULL);
+    xmpp_stanza_t *complex = _complex_query(ctx, FALSE);
+    xmpp_stanza_t *simple = _simple_query(ctx);
+
+    char *complex_ver = caps_create_sha1_str(complex);
+    char *simple_ver = caps_create_sha1_str(simple);
+
+    assert_string_equal("q07IKJEyjvHSyhy//CH0CxmKi8w=", complex_ver);
+    assert_string_equal("QgayPKawpkPSDYmwT/WM94uAlu0=", simple_ver);
+
+    g_free(complex_ver);
+    g_free(simple_ver);
+    xmpp_stanza_release(complex);
+    xmpp_stanza_release(simple);
+    xmpp_ctx_free(ctx);
+}
+
+static void
+_add_simple_caps(const char * const ver)
+{
+    xmpp_ctx_t *ctx = xmpp_ctx_new(NULL, NULL);
+    xmpp_stanza_t *query = _simple_query(ctx);
+    Capabilities *caps = caps_create(query);
+    caps_add(ver, caps);
+    caps_unref(caps);
+    xmpp_stanza_release(query);
+    xmpp_ctx_free(ctx);
+}
+
+void init_caps(void **state)
+{
+    create_data_dir(state);
+    remove(CACHE_FILE);
+    capabilities_init_module();
+    mock_iq_send_caps_request();
+    caps_init();
+}
+
+void close_caps(void **state)
+{
+    caps_close();
+    remove(CACHE_FILE);
+    remove_data_dir(state);
+}
+
+void caps_request_sends_one_request_per_ver(void **state)
+{
+    mock_connection_status(JABBER_CONNECTED);
+    iq_send_caps_request_expect("bob@server.org/laptop", VER);
+
+    caps_request("bob@server.org/laptop", NODE, VER);
+    caps_request("kate@server.org/pc", NODE, VER);
+    caps_request("bob@server.org/laptop", NODE, VER);
+}
+
+void caps_request_failed_asks_next_jid(void **state)
+{
+    mock_connection_status(JABBER_CONNECTED);
+    mock_connection_status(JABBER_CONNECTED);
+    iq_send_caps_request_expect("bob@server.org/laptop", VER);
+    iq_send_caps_request_expect("kate@server.org/pc", VER);
+
+    caps_request("bob@server.org/laptop", NODE, VER);
+    caps_request("kate@server.org/pc", NODE, VER);
+    char *bob_id = strdup(iq_send_caps_request_last_id());
+    caps_request_failed(bob_id);
+
+    assert_string_not_equal(bob_id, iq_send_caps_request_last_id());
+
+    // an answer to the earlier request no longer moves it on
+    caps_request_failed(bob_id);
+    free(bob_id);
+}
+
+void caps_request_dropped_when_every_jid_failed(void **state)
+{
+    mock_connection_status(JABBER_CONNECTED);
+    mock_connection_status(JABBER_CONNECTED);
+    iq_send_caps_request_expect("bob@server.org/laptop", VER);
+    iq_send_caps_request_expect("bob@server.org/laptop", VER);
+
+    caps_request("bob@server.org/laptop", NODE, VER);
+    caps_request_failed(iq_send_caps_request_last_id());
+
+    // asked again when the ver is next seen
+    caps_request("bob@server.org/laptop", NODE, VER);
+}
+
+void caps_request_complete_maps_every_waiter(void **state)
+{
+    mock_connection_status(JABBER_CONNECTED);
+    iq_send_caps_request_expect("bob@server.org/laptop", VER);
+
+    caps_request("bob@server.org/laptop", NODE, VER);
+    caps_request("kate@server.org/pc", NODE, VER);
+    assert_false(caps_jid_known("bob@server.org/laptop"));
+
+    _add_simple_caps(VER);
+    caps_request_complete(VER);
+
+    assert_true(caps_jid_known("bob@server.org/laptop"));
+    assert_true(caps_jid_known("kate@server.org/pc"));
+}
+
+void caps_lookup_returns_shared_entry(void **state)
+{
+    caps_map("bob@server.org/laptop", VER);
+    caps_map("kate@server.org/pc", VER);
+    _add_simple_caps(VER);
+
+    Capabilities *bob_caps = caps_lookup("bob@server.org/laptop");
+    Capabilities *kate_caps = caps_lookup("kate@server.org/pc");
+
+    assert_non_null(bob_caps);
+    assert_true(bob_caps == kate_caps);
+    assert_int_equal(3, bob_caps->refs);
+
+    caps_unref(bob_caps);
+    caps_unref(kate_caps);
+}
+
+void caps_unref_keeps_table_reference(void **state)
+{
+    caps_map("bob@server.org/laptop", VER);
+    _add_simple_caps(VER);
+
+    Capabilities *caps = caps_lookup("bob@server.org/laptop");
+    caps_unref(caps);
+    caps = caps_lookup("bob@server.org/laptop");
+
+    assert_non_null(caps);
+    assert_int_equal(2, caps->refs);
+    assert_string_equal("Exodus 0.9.1", caps->name);
+    assert_int_equal(4, caps->num_features);
+
+    caps_unref(caps);
+}
+
+// a ver whose features are all new, so their ids are past those of VER
+static void
+_add_many_features_caps(const char * const ver)
+{
+    xmpp_ctx_t *ctx = xmpp_ctx_new(NULL, NULL);
+    xmpp_stanza_t *query = _new_query(ctx);
+    int i;
+    for (i = 0; i < 40; i++) {
+        gchar *var = g_strdup_printf("urn:example:feature:%d", i);
+        _add_feature(ctx, query, var);
+        g_free(var);
+    }
+    Capabilities *caps = caps_create(query);
+    caps_add(ver, caps);
+    caps_unref(caps);
+    xmpp_stanza_release(query);
+    xmpp_ctx_free(ctx);
+}
+
+void caps_jid_supports_advertised_feature(void **state)
+{
+    caps_map("bob@server.org/laptop", VER);
+    _add_simple_caps(VER);
+
+    assert_true(caps_jid_supports("bob@server.org/laptop", "http://jabber.org/protocol/muc"));
+    assert_true(caps_jid_supports("bob@server.org/laptop", "http://jabber.org/protocol/caps"));
+}
+
+void caps_jid_supports_false_for_unknown_feature(void **state)
+{
+    caps_map("bob@server.org/laptop", VER);
+    _add_simple_caps(VER);
+
+    assert_false(caps_jid_supports("bob@server.org/laptop", "urn:example:never-advertised"));
+    assert_false(caps_jid_supports("kate@server.org/pc", "http://jabber.org/protocol/muc"));
+}
+
+void caps_jid_supports_false_for_feature_seen_after_bitset(void **state)
+{
+    caps_map("bob@server.org/laptop", VER);
+    _add_simple_caps(VER);
+    assert_true(caps_jid_supports("bob@server.org/laptop", "http://jabber.org/protocol/muc"));
+
+    caps_map("kate@server.org/pc", "kate_ver");
+    _add_many_features_caps("kate_ver");
+
+    assert_true(caps_jid_supports("kate@server.org/pc", "urn:example:feature:39"));
+    assert_false(caps_jid_supports("bob@server.org/laptop", "urn:example:feature:39"));
+    assert_false(caps_jid_supports("kate@server.org/pc", "http://jabber.org/protocol/muc"));
+}
+
+void caps_jid_supports_bare_jid_asks_available_resources(void **state)
+{
+    roster_init();
+    roster_add("bob@server.org", NULL, NULL, "both", FALSE);
+    roster_update_presence("bob@server.org",
+        resource_new("laptop", RESOURCE_ONLINE, NULL, 10), NULL);
+    roster_update_presence("bob@server.org",
+        resource_new("phone", RESOURCE_AWAY, NULL, 5), NULL);
+    caps_map("bob@server.org/phone", VER);
+    _add_simple_caps(VER);
+
+    assert_true(caps_jid_known("bob@server.org"));
+    assert_true(caps_jid_supports("bob@server.org", "http://jabber.org/protocol/muc"));
+    assert_false(caps_jid_supports("bob@server.org", "urn:example:never-advertised"));
+    assert_false(caps_jid_known("kate@server.org"));
+
+    roster_free();
+}
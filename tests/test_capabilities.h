@@ -0,0 +1,16 @@
+void caps_sha1_str_simple_generation(void **state);
+void caps_sha1_str_complex_generation(void **state);
+void caps_sha1_str_ignores_element_order(void **state);
+void caps_sha1_str_reused_after_larger_query(void **state);
+void init_caps(void **state);
+void close_caps(void **state);
+void caps_request_sends_one_request_per_ver(void **state);
+void caps_request_failed_asks_next_jid(void **state);
+void caps_request_dropped_when_every_jid_failed(void **state);
+void caps_request_complete_maps_every_waiter(void **state);
+void caps_lookup_returns_shared_entry(void **state);
+void caps_unref_keeps_table_reference(void **state);
+void caps_jid_supports_advertised_feature(void **state);
+void caps_jid_supports_false_for_unknown_feature(void **state);
+void caps_jid_supports_false_for_feature_seen_after_bitset(void **state);
+void caps_jid_supports_bare_jid_asks_available_resources(void **state);
@@ -0,0 +1,224 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <glib.h>
+
+#include "xmpp/xmpp.h"
+#include "xmpp/capscache.h"
+#include "helpers.h"
+
+#define CACHE_FILE "./tests/files/xdg_data_home/profanity/capscache.bin"
+
+static const gchar *features[] = {
+    "http://jabber.org/protocol/caps",
+    "http://jabber.org/protocol/chatstates",
+    "urn:xmpp:ping"
+};
+
+static Capabilities *
+_create_caps(const char * const name)
+{
+    Capabilities *caps = malloc(sizeof(struct capabilities_t));
+    caps->category = g_strdup("client");
+    caps->type = g_strdup("pc");
+    caps->name = g_strdup(name);
+    caps->software = NULL;
+    caps->software_version = NULL;
+    caps->os = g_strdup("Linux");
+    caps->os_version = NULL;
+    caps->features = malloc(sizeof(features));
+    memcpy(caps->features, features, sizeof(features));
+    caps->num_features = 3;
+    caps->feature_bits = NULL;
+    caps->num_feature_words = 0;
+    caps->refs = 1;
+
+    return caps;
+}
+
+static void
+_free_caps(Capabilities *caps)
+{
+    g_free(caps->category);
+    g_free(caps->type);
+    g_free(caps->name);
+    g_free(caps->software);
+    g_free(caps->software_version);
+    g_free(caps->os);
+    g_free(caps->os_version);
+    free(caps->features);
+    free(caps->feature_bits);
+    free(caps);
+}
+
+static CapsCache
+_open_cache(void)
+{
+    remove(CACHE_FILE);
+    return capscache_open(CACHE_FILE);
+}
+
+static void
+_close_cache(CapsCache cache)
+{
+    capscache_close(cache);
+    remove(CACHE_FILE);
+}
+
+static void
+_add(CapsCache cache, const char * const ver, const char * const name)
+{
+    Capabilities *caps = _create_caps(name);
+    assert_true(capscache_add(cache, ver, caps));
+    _free_caps(caps);
+}
+
+static void
+_assert_entry(CapsCache cache, const char * const ver, const char * const name)
+{
+    Capabilities *caps = capscache_get(cache, ver);
+
+    assert_non_null(caps);
+    assert_string_equal("client", caps->category);
+    assert_string_equal("pc", caps->type);
+    assert_string_equal(name, caps->name);
+    assert_null(caps->software);
+    assert_string_equal("Linux", caps->os);
+    assert_int_equal(3, caps->num_features);
+    assert_string_equal("urn:xmpp:ping", caps->features[2]);
+
+    _free_caps(caps);
+}
+
+void capscache_get_returns_added_entry(void **state)
+{
+    CapsCache cache = _open_cache();
+    _add(cache, "ver1", "Psi");
+
+    assert_true(capscache_contains(cache, "ver1"));
+    _assert_entry(cache, "ver1", "Psi");
+
+    _close_cache(cache);
+}
+
+void capscache_get_returns_null_when_not_cached(void **state)
+{
+    CapsCache cache = _open_cache();
+    _add(cache, "ver1", "Psi");
+
+    assert_false(capscache_contains(cache, "ver2"));
+    assert_null(capscache_get(cache, "ver2"));
+
+    _close_cache(cache);
+}
+
+void capscache_reopen_finds_entries(void **state)
+{
+    CapsCache cache = _open_cache();
+    _add(cache, "ver1", "Psi");
+    _add(cache, "ver2", "Gajim");
+    capscache_close(cache);
+
+    cache = capscache_open(CACHE_FILE);
+
+    assert_true(capscache_contains(cache, "ver1"));
+    _assert_entry(cache, "ver1", "Psi");
+    _assert_entry(cache, "ver2", "Gajim");
+
+    _close_cache(cache);
+}
+
+void capscache_compact_keeps_entries(void **state)
+{
+    CapsCache cache = _open_cache();
+    _add(cache, "ver1", "Psi");
+    _add(cache, "ver2", "Gajim");
+
+    assert_true(capscache_compact(cache));
+
+    _assert_entry(cache, "ver1", "Psi");
+    _assert_entry(cache, "ver2", "Gajim");
+    assert_false(capscache_needs_compact(cache));
+
+    _close_cache(cache);
+}
+
+void capscache_ignores_invalid_file(void **state)
+{
+    g_file_set_contents(CACHE_FILE, "[ver1]\nname=Psi\n", -1, NULL);
+
+    CapsCache cache = capscache_open(CACHE_FILE);
+    assert_false(capscache_contains(cache, "ver1"));
+
+    _add(cache, "ver2", "Gajim");
+    _assert_entry(cache, "ver2", "Gajim");
+
+    _close_cache(cache);
+}
+
+void capscache_truncates_torn_append(void **state)
+{
+    CapsCache cache = _open_cache();
+    _add(cache, "ver1", "Psi");
+    _add(cache, "ver2", "Gajim");
+    capscache_close(cache);
+
+    gchar *contents = NULL;
+    gsize size = 0;
+    assert_true(g_file_get_contents(CACHE_FILE, &contents, &size, NULL));
+    g_free(contents);
+
+    // a record size and the start of a record, as left by a crash mid write
+    FILE *f = fopen(CACHE_FILE, "ab");
+    guint32 record_size = 200;
+    fwrite(&record_size, 4, 1, f);
+    fwrite("torn", 1, 4, f);
+    fclose(f);
+
+    cache = capscache_open(CACHE_FILE);
+    _assert_entry(cache, "ver1", "Psi");
+    _assert_entry(cache, "ver2", "Gajim");
+
+    gsize truncated = 0;
+    assert_true(g_file_get_contents(CACHE_FILE, &contents, &truncated, NULL));
+    g_free(contents);
+    assert_int_equal(size, truncated);
+
+    // later appends are readable after the torn record is dropped
+    _add(cache, "ver3", "Pidgin");
+    capscache_close(cache);
+
+    cache = capscache_open(CACHE_FILE);
+    _assert_entry(cache, "ver2", "Gajim");
+    _assert_entry(cache, "ver3", "Pidgin");
+
+    _close_cache(cache);
+}
+
+void capscache_add_all_writes_compacted(void **state)
+{
+    CapsCache cache = _open_cache();
+    _add(cache, "ver1", "Psi");
+
+    GHashTable *caps = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+        (GDestroyNotify)_free_caps);
+    g_hash_table_insert(caps, "ver2", _create_caps("Gajim"));
+    g_hash_table_insert(caps, "ver3", _create_caps("Pidgin"));
+
+    assert_true(capscache_add_all(cache, caps));
+    g_hash_table_destroy(caps);
+    capscache_close(cache);
+
+    cache = capscache_open(CACHE_FILE);
+    _assert_entry(cache, "ver1", "Psi");
+    _assert_entry(cache, "ver2", "Gajim");
+    _assert_entry(cache, "ver3", "Pidgin");
+    assert_false(capscache_needs_compact(cache));
+
+    _close_cache(cache);
+}
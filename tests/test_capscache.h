@@ -0,0 +1,7 @@
+void capscache_get_returns_added_entry(void **state);
+void capscache_get_returns_null_when_not_cached(void **state);
+void capscache_reopen_finds_entries(void **state);
+void capscache_compact_keeps_entries(void **state);
+void capscache_ignores_invalid_file(void **state);
+void capscache_truncates_torn_append(void **state);
+void capscache_add_all_writes_compacted(void **state);
@@ -0,0 +1,61 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdlib.h>
+#include <glib.h>
+
+#include "chat_session.h"
+
+void next_state_change_none_without_sessions(void **state)
+{
+    chat_sessions_init();
+
+    assert_int_equal(-1, chat_sessions_next_state_change());
+}
+
+void next_state_change_inactive_after_start(void **state)
+{
+    chat_sessions_init();
+    chat_session_start("bob@server.org", TRUE);
+
+    gint next = chat_sessions_next_state_change();
+
+    assert_true(next > 29000);
+    assert_true(next <= 30001);
+    chat_sessions_clear();
+}
+
+void next_state_change_paused_when_composing(void **state)
+{
+    chat_sessions_init();
+    chat_session_start("bob@server.org", TRUE);
+    chat_session_start("kate@server.org", TRUE);
+    chat_session_set_composing("kate@server.org");
+
+    gint next = chat_sessions_next_state_change();
+
+    assert_true(next > 9000);
+    assert_true(next <= 10001);
+    chat_sessions_clear();
+}
+
+void next_state_change_none_when_recipient_unsupported(void **state)
+{
+    chat_sessions_init();
+    chat_session_start("bob@server.org", FALSE);
+    chat_session_set_composing("bob@server.org");
+
+    assert_int_equal(-1, chat_sessions_next_state_change());
+    chat_sessions_clear();
+}
+
+void next_state_change_none_when_gone(void **state)
+{
+    chat_sessions_init();
+    chat_session_start("bob@server.org", TRUE);
+    chat_session_set_gone("bob@server.org");
+
+    assert_int_equal(-1, chat_sessions_next_state_change());
+    chat_sessions_clear();
+}
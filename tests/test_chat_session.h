@@ -0,0 +1,5 @@
+void next_state_change_none_without_sessions(void **state);
+void next_state_change_inactive_after_start(void **state);
+void next_state_change_paused_when_composing(void **state);
+void next_state_change_none_when_recipient_unsupported(void **state);
+void next_state_change_none_when_gone(void **state);
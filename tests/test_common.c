@@ -544,3 +544,87 @@ void test_p_sha1_hash7(void **state)
 
     assert_string_equal(result, "bNfKVfqEOGmzlH8M+e8FYTB46SU=");
 }
+
+void test_p_sha1_hash_caps_ver(void **state)
+{
+    char *inp = "client/pc//Exodus 0.9.1<http://jabber.org/protocol/caps<http://jabber.org/protocol/disco#info<http://jabber.org/protocol/disco#items<http://jabber.org/protocol/muc<";
+    char *result = p_sha1_hash(inp);
+
+    assert_string_equal(result, "QgayPKawpkPSDYmwT/WM94uAlu0=");
+}
+
+static int delayed_writes = 0;
+
+static void
+_count_write(void)
+{
+    delayed_writes++;
+}
+
+static gboolean
+_keep_changing(gpointer data)
+{
+    delayed_write_schedule(data);
+    return TRUE;
+}
+
+static gboolean
+_quit_loop(gpointer data)
+{
+    g_main_loop_quit(data);
+    return FALSE;
+}
+
+void delayed_write_waits_for_changes_to_stop(void **state)
+{
+    DelayedWrite dw = { 20, 1000, _count_write, 0, 0 };
+    GMainLoop *loop = g_main_loop_new(NULL, FALSE);
+    delayed_writes = 0;
+
+    delayed_write_schedule(&dw);
+    delayed_write_schedule(&dw);
+    g_timeout_add(100, _quit_loop, loop);
+    g_main_loop_run(loop);
+
+    assert_int_equal(1, delayed_writes);
+    assert_int_equal(0, dw.source);
+    assert_int_equal(0, dw.deadline);
+
+    g_main_loop_unref(loop);
+}
+
+void delayed_write_writes_by_deadline_while_changing(void **state)
+{
+    DelayedWrite dw = { 50, 100, _count_write, 0, 0 };
+    GMainLoop *loop = g_main_loop_new(NULL, FALSE);
+    delayed_writes = 0;
+
+    // a change every 10ms never lets delay_ms pass quietly
+    guint changes = g_timeout_add(10, _keep_changing, &dw);
+    g_timeout_add(250, _quit_loop, loop);
+    g_main_loop_run(loop);
+    g_source_remove(changes);
+
+    assert_true(delayed_writes >= 1);
+
+    delayed_write_flush(&dw);
+    g_main_loop_unref(loop);
+}
+
+void delayed_write_flush_writes_pending(void **state)
+{
+    DelayedWrite dw = { 10000, 20000, _count_write, 0, 0 };
+    delayed_writes = 0;
+
+    delayed_write_flush(&dw);
+    assert_int_equal(0, delayed_writes);
+
+    delayed_write_schedule(&dw);
+    delayed_write_flush(&dw);
+    assert_int_equal(1, delayed_writes);
+    assert_int_equal(0, dw.source);
+    assert_int_equal(0, dw.deadline);
+
+    delayed_write_flush(&dw);
+    assert_int_equal(1, delayed_writes);
+}
@@ -46,3 +46,7 @@ void test_p_sha1_hash5(void **state);
 void test_p_sha1_hash6(void **state);
 void test_p_sha1_hash6(void **state);
 void test_p_sha1_hash7(void **state);
+void test_p_sha1_hash_caps_ver(void **state);
+void delayed_write_waits_for_changes_to_stop(void **state);
+void delayed_write_writes_by_deadline_while_changing(void **state);
+void delayed_write_flush_writes_pending(void **state);
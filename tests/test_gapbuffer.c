@@ -0,0 +1,169 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+
+#include "tools/gapbuffer.h"
+
+static void
+_insert(GapBuffer gb, const char * const text)
+{
+    gap_buffer_insert(gb, text, strlen(text));
+}
+
+void insert_appends_at_cursor(void **state)
+{
+    GapBuffer gb = gap_buffer_new();
+
+    _insert(gb, "hello");
+    _insert(gb, " world");
+
+    assert_string_equal("hello world", gap_buffer_text(gb));
+    assert_int_equal(11, gap_buffer_length(gb));
+    assert_int_equal(11, gap_buffer_cursor(gb));
+
+    gap_buffer_free(gb);
+}
+
+void insert_in_middle_after_moving_left(void **state)
+{
+    GapBuffer gb = gap_buffer_new();
+    _insert(gb, "helloworld");
+
+    int i;
+    for (i = 0; i < 5; i++) {
+        gap_buffer_left(gb);
+    }
+    _insert(gb, ", ");
+
+    assert_string_equal("hello, world", gap_buffer_text(gb));
+    assert_int_equal(7, gap_buffer_cursor(gb));
+    assert_int_equal('w', gap_buffer_after(gb));
+
+    gap_buffer_free(gb);
+}
+
+void delete_before_and_after_cursor(void **state)
+{
+    GapBuffer gb = gap_buffer_new();
+    _insert(gb, "abcd");
+    gap_buffer_left(gb);
+    gap_buffer_left(gb);
+
+    assert_true(gap_buffer_delete_before(gb));
+    assert_true(gap_buffer_delete_after(gb));
+
+    assert_string_equal("ad", gap_buffer_text(gb));
+    assert_int_equal(1, gap_buffer_cursor(gb));
+
+    gap_buffer_free(gb);
+}
+
+void cursor_tracks_characters_and_columns(void **state)
+{
+    GapBuffer gb = gap_buffer_new();
+
+    // e acute is two bytes and one column, the CJK character is three bytes
+    // and two columns
+    _insert(gb, "a\xc3\xa9\xe4\xb8\xad");
+
+    assert_int_equal(6, gap_buffer_bytes(gb));
+    assert_int_equal(3, gap_buffer_length(gb));
+    assert_int_equal(4, gap_buffer_column(gb));
+
+    gap_buffer_left(gb);
+    assert_int_equal(2, gap_buffer_cursor(gb));
+    assert_int_equal(2, gap_buffer_column(gb));
+
+    gap_buffer_free(gb);
+}
+
+void up_and_down_keep_column(void **state)
+{
+    GapBuffer gb = gap_buffer_new();
+    _insert(gb, "first line\nsecond");
+    gap_buffer_left(gb);
+    gap_buffer_left(gb);
+
+    assert_true(gap_buffer_up(gb));
+    assert_int_equal(0, gap_buffer_line(gb));
+    assert_int_equal(4, gap_buffer_column(gb));
+    assert_int_equal('t', gap_buffer_after(gb));
+
+    assert_true(gap_buffer_down(gb));
+    assert_int_equal(1, gap_buffer_line(gb));
+    assert_int_equal(4, gap_buffer_column(gb));
+    assert_int_equal('n', gap_buffer_after(gb));
+
+    gap_buffer_free(gb);
+}
+
+void up_on_first_line_returns_false(void **state)
+{
+    GapBuffer gb = gap_buffer_new();
+    _insert(gb, "one line");
+
+    assert_false(gap_buffer_up(gb));
+    assert_false(gap_buffer_down(gb));
+    assert_int_equal(8, gap_buffer_cursor(gb));
+
+    gap_buffer_free(gb);
+}
+
+void set_replaces_text_with_cursor_at_end(void **state)
+{
+    GapBuffer gb = gap_buffer_new();
+    _insert(gb, "old text");
+    gap_buffer_home(gb);
+
+    gap_buffer_set(gb, "/join room@conference.server");
+
+    assert_string_equal("/join room@conference.server", gap_buffer_text(gb));
+    assert_int_equal(28, gap_buffer_cursor(gb));
+    assert_true(gap_buffer_starts_with(gb, "/"));
+
+    gap_buffer_free(gb);
+}
+
+void at_reads_either_side_of_gap(void **state)
+{
+    GapBuffer gb = gap_buffer_new();
+    _insert(gb, "abcdef");
+    gap_buffer_left(gb);
+    gap_buffer_left(gb);
+
+    assert_int_equal(4, gap_buffer_point(gb));
+    assert_int_equal('a', *gap_buffer_at(gb, 0));
+    assert_int_equal('d', *gap_buffer_at(gb, 3));
+    assert_int_equal('e', *gap_buffer_at(gb, 4));
+    assert_int_equal('f', *gap_buffer_at(gb, 5));
+
+    gap_buffer_free(gb);
+}
+
+void take_changed_returns_earliest_edit(void **state)
+{
+    GapBuffer gb = gap_buffer_new();
+    _insert(gb, "hello world");
+    gsize from = 99;
+    assert_true(gap_buffer_take_changed(gb, &from));
+    assert_int_equal(0, from);
+
+    gap_buffer_left(gb);
+    assert_false(gap_buffer_take_changed(gb, &from));
+
+    gap_buffer_home(gb);
+    gap_buffer_right(gb);
+    gap_buffer_right(gb);
+    gap_buffer_delete_after(gb);
+    gap_buffer_end(gb);
+    _insert(gb, "!");
+    assert_true(gap_buffer_take_changed(gb, &from));
+    assert_int_equal(2, from);
+    assert_false(gap_buffer_take_changed(gb, &from));
+
+    gap_buffer_free(gb);
+}
@@ -0,0 +1,9 @@
+void insert_appends_at_cursor(void **state);
+void insert_in_middle_after_moving_left(void **state);
+void delete_before_and_after_cursor(void **state);
+void cursor_tracks_characters_and_columns(void **state);
+void up_and_down_keep_column(void **state);
+void up_on_first_line_returns_false(void **state);
+void set_replaces_text_with_cursor_at_end(void **state);
+void at_reads_either_side_of_gap(void **state);
+void take_changed_returns_earliest_edit(void **state);
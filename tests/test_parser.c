@@ -3,9 +3,15 @@
 #include <setjmp.h>
 #include <cmocka.h>
 #include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <glib.h>
 
 #include "tools/parser.h"
 
+#define BENCHMARK_INPUT_SIZE (64 * 1024)
+#define BENCHMARK_RUNS 20
+
 void
 parse_null_returns_null(void **state)
 {
@@ -659,4 +665,90 @@ parse_options_with_duplicated_option_sets_error(void **state)
     assert_false(res);
 
     options_destroy(options);
-}
\ No newline at end of file
+}
+
+// input of a command followed by text of repeated words up to the given size
+static gchar *
+_benchmark_input(const char * const cmd, const char * const word, gboolean quoted)
+{
+    GString *inp = g_string_new(cmd);
+    if (quoted) {
+        g_string_append_c(inp, '"');
+    }
+    while (inp->len < BENCHMARK_INPUT_SIZE) {
+        g_string_append(inp, word);
+    }
+    if (quoted) {
+        g_string_append_c(inp, '"');
+    }
+
+    return g_string_free(inp, FALSE);
+}
+
+static gchar **
+_benchmark_parse(const char * const name, const char * const inp, int min,
+    int max, gboolean freetext)
+{
+    gchar **args = NULL;
+    gboolean result = FALSE;
+    GTimer *timer = g_timer_new();
+
+    int i;
+    for (i = 0; i < BENCHMARK_RUNS; i++) {
+        g_strfreev(args);
+        if (freetext) {
+            args = parse_args_with_freetext(inp, min, max, &result);
+        } else {
+            args = parse_args(inp, min, max, &result);
+        }
+    }
+
+    g_timer_stop(timer);
+    printf("%s: %.3f ms per 64KB input\n", name,
+        (g_timer_elapsed(timer, NULL) * 1000) / BENCHMARK_RUNS);
+    g_timer_destroy(timer);
+
+    assert_true(result);
+    return args;
+}
+
+void
+benchmark_parse_args_quoted_64kb(void **state)
+{
+    gchar *inp = _benchmark_input("/cmd arg1 ", "some quoted text ", TRUE);
+
+    gchar **args = _benchmark_parse("parse_args quoted", inp, 2, 2, FALSE);
+
+    assert_int_equal(2, g_strv_length(args));
+    assert_string_equal("arg1", args[0]);
+    assert_int_equal(strlen(inp) - strlen("/cmd arg1 \"\""), strlen(args[1]));
+    g_strfreev(args);
+    g_free(inp);
+}
+
+void
+benchmark_parse_args_too_many_64kb(void **state)
+{
+    gchar *inp = _benchmark_input("/cmd", " arg", FALSE);
+    gboolean result = TRUE;
+
+    gchar **args = parse_args(inp, 1, 2, &result);
+
+    assert_false(result);
+    assert_null(args);
+    g_free(inp);
+}
+
+void
+benchmark_parse_args_with_freetext_64kb(void **state)
+{
+    gchar *inp = _benchmark_input("/msg someone@server.org ", "h\xc3\xa9llo w\xc3\xb6rld ", FALSE);
+
+    gchar **args = _benchmark_parse("parse_args_with_freetext", inp, 1, 2, TRUE);
+
+    assert_int_equal(2, g_strv_length(args));
+    assert_string_equal("someone@server.org", args[0]);
+    assert_true(g_str_has_prefix(args[1], "h\xc3\xa9llo w\xc3\xb6rld"));
+    g_strfreev(args);
+    g_free(inp);
+}
@@ -48,3 +48,6 @@ void parse_options_when_opt3_no_val_sets_error(void **state);
 void parse_options_when_three_returns_map(void **state);
 void parse_options_when_unknown_opt_sets_error(void **state);
 void parse_options_with_duplicated_option_sets_error(void **state);
+void benchmark_parse_args_quoted_64kb(void **state);
+void benchmark_parse_args_too_many_64kb(void **state);
+void benchmark_parse_args_with_freetext_64kb(void **state);
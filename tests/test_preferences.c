@@ -31,3 +31,82 @@ void statuses_muc_defaults_to_all(void **state)
     assert_non_null(setting);
     assert_string_equal("all", setting);
 }
+
+void set_pref_not_written_until_save(void **state)
+{
+    prefs_set_string(PREF_STATUSES_CONSOLE, "none");
+
+    GKeyFile *file = g_key_file_new();
+    g_key_file_load_from_file(file, "./tests/files/xdg_config_home/profanity/profrc",
+        G_KEY_FILE_NONE, NULL);
+    char *setting = g_key_file_get_string(file, "ui", "statuses.console", NULL);
+
+    assert_null(setting);
+
+    g_key_file_free(file);
+}
+
+void prefs_save_writes_pending_changes(void **state)
+{
+    prefs_set_string(PREF_STATUSES_CONSOLE, "none");
+    prefs_save();
+
+    GKeyFile *file = g_key_file_new();
+    g_key_file_load_from_file(file, "./tests/files/xdg_config_home/profanity/profrc",
+        G_KEY_FILE_NONE, NULL);
+    char *setting = g_key_file_get_string(file, "ui", "statuses.console", NULL);
+
+    assert_non_null(setting);
+    assert_string_equal("none", setting);
+
+    g_free(setting);
+    g_key_file_free(file);
+}
+
+void get_string_value_returns_set_value(void **state)
+{
+    prefs_set_string(PREF_STATUSES_CHAT, "online");
+
+    assert_string_equal("online", prefs_get_string_value(PREF_STATUSES_CHAT));
+
+    prefs_set_string(PREF_STATUSES_CHAT, NULL);
+
+    assert_string_equal("all", prefs_get_string_value(PREF_STATUSES_CHAT));
+}
+
+void max_fps_defaults_to_30(void **state)
+{
+    assert_int_equal(PREFS_DEFAULT_MAX_FPS, prefs_get_max_fps());
+}
+
+void max_fps_returns_set_value(void **state)
+{
+    prefs_set_max_fps(0);
+
+    assert_int_equal(0, prefs_get_max_fps());
+}
+
+void buffer_sizes_default_by_window_type(void **state)
+{
+    assert_int_equal(PREFS_DEFAULT_BUFFER_CONSOLE, prefs_get_buffer_console());
+    assert_int_equal(PREFS_DEFAULT_BUFFER_CHAT, prefs_get_buffer_chat());
+    assert_int_equal(PREFS_DEFAULT_BUFFER_MUC, prefs_get_buffer_muc());
+}
+
+void buffer_sizes_read_from_preferences(void **state)
+{
+    prefs_close();
+    GKeyFile *file = g_key_file_new();
+    g_key_file_set_integer(file, "ui", "buffer.console", 100);
+    g_key_file_set_integer(file, "ui", "buffer.chat", 0);
+    g_key_file_set_integer(file, "ui", "buffer.muc", PREFS_MAX_BUFFER_SIZE + 1);
+    gchar *data = g_key_file_to_data(file, NULL, NULL);
+    g_file_set_contents("./tests/files/xdg_config_home/profanity/profrc", data, -1, NULL);
+    g_free(data);
+    g_key_file_free(file);
+    prefs_load();
+
+    assert_int_equal(100, prefs_get_buffer_console());
+    assert_int_equal(PREFS_DEFAULT_BUFFER_CHAT, prefs_get_buffer_chat());
+    assert_int_equal(PREFS_MAX_BUFFER_SIZE, prefs_get_buffer_muc());
+}
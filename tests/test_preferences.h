@@ -1,3 +1,10 @@
 void statuses_console_defaults_to_all(void **state);
 void statuses_chat_defaults_to_all(void **state);
 void statuses_muc_defaults_to_all(void **state);
+void set_pref_not_written_until_save(void **state);
+void prefs_save_writes_pending_changes(void **state);
+void get_string_value_returns_set_value(void **state);
+void max_fps_defaults_to_30(void **state);
+void max_fps_returns_set_value(void **state);
+void buffer_sizes_default_by_window_type(void **state);
+void buffer_sizes_read_from_preferences(void **state);
@@ -269,3 +269,75 @@ void find_twice_returns_first_when_two_match_and_reset(void **state)
     free(result2);
     roster_free();
 }
+
+void batch_add_finds_contacts_after_commit(void **state)
+{
+    roster_init();
+    roster_batch_begin();
+    roster_add("james@server.org", "James", NULL, NULL, FALSE);
+    roster_add("bob@server.org", NULL, NULL, NULL, FALSE);
+    roster_add("jamie@server.org", "Jamie", NULL, NULL, FALSE);
+    roster_batch_commit();
+
+    char *result1 = roster_find_contact("Jam");
+    char *result2 = roster_find_contact(result1);
+    assert_string_equal("James", result1);
+    assert_string_equal("Jamie", result2);
+    assert_string_equal("jamie@server.org", roster_barejid_from_name("Jamie"));
+    free(result1);
+    free(result2);
+    roster_free();
+}
+
+void batch_add_twice_adds_once(void **state)
+{
+    roster_init();
+    roster_batch_begin();
+    gboolean first = roster_add("James", NULL, NULL, NULL, FALSE);
+    gboolean second = roster_add("James", NULL, NULL, NULL, FALSE);
+    roster_batch_commit();
+
+    GSList *list = roster_get_contacts();
+    assert_true(first);
+    assert_false(second);
+    assert_int_equal(1, g_slist_length(list));
+    g_slist_free(list);
+    roster_free();
+}
+
+void batch_add_large_roster(void **state)
+{
+    int count = 50000;
+    int i;
+
+    roster_init();
+    GTimer *timer = g_timer_new();
+
+    roster_batch_begin();
+    for (i = 0; i < count; i++) {
+        char *barejid = g_strdup_printf("contact%d@server.org", i);
+        char *name = g_strdup_printf("Contact %d", i);
+        GSList *groups = g_slist_append(NULL, g_strdup_printf("group%d", i % 100));
+        roster_add(barejid, name, groups, "both", FALSE);
+        g_free(barejid);
+        g_free(name);
+    }
+    roster_batch_commit();
+
+    gdouble elapsed = g_timer_elapsed(timer, NULL);
+    g_timer_destroy(timer);
+    assert_true(elapsed < 2.0);
+
+    GSList *groups = roster_get_groups();
+    assert_int_equal(100, g_slist_length(groups));
+    g_slist_free_full(groups, free);
+
+    assert_non_null(roster_get_contact("contact49999@server.org"));
+    assert_string_equal("contact123@server.org",
+        roster_barejid_from_name("Contact 123"));
+
+    char *found = roster_find_jid("contact4999");
+    assert_string_equal("contact4999@server.org", found);
+    free(found);
+    roster_free();
+}
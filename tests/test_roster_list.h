@@ -16,3 +16,6 @@ void find_on_empty_returns_null(void **state);
 void find_twice_returns_second_when_two_match(void **state);
 void find_five_times_finds_fifth(void **state);
 void find_twice_returns_first_when_two_match_and_reset(void **state);
+void batch_add_finds_contacts_after_commit(void **state);
+void batch_add_twice_adds_once(void **state);
+void batch_add_large_roster(void **state);
@@ -0,0 +1,104 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+
+#include "log.h"
+#include "ui/scrollback.h"
+
+static ProfScrollback
+_create_scrollback(void)
+{
+    ChatLogPos anchor = { 20140601, 100 };
+    return scrollback_create("me@server.org", "buddy@server.org", FALSE, anchor);
+}
+
+static GSList *
+_lines(const char * const line)
+{
+    return g_slist_append(NULL, strdup(line));
+}
+
+void scrollback_older_returns_page_from_log(void **state)
+{
+    ProfScrollback scrollback = _create_scrollback();
+    will_return(chat_log_get_before, _lines("10:00:00 - buddy: hello"));
+
+    GSList *lines = scrollback_older(scrollback);
+
+    assert_non_null(lines);
+    assert_string_equal("10:00:00 - buddy: hello", lines->data);
+    assert_true(scrollback_showing(scrollback));
+
+    scrollback_free(scrollback);
+}
+
+void scrollback_older_returns_null_at_start_of_log(void **state)
+{
+    ProfScrollback scrollback = _create_scrollback();
+    will_return(chat_log_get_before, _lines("10:00:00 - buddy: hello"));
+    will_return(chat_log_get_before, NULL);
+
+    scrollback_older(scrollback);
+    GSList *lines = scrollback_older(scrollback);
+
+    assert_null(lines);
+    assert_true(scrollback_showing(scrollback));
+
+    scrollback_free(scrollback);
+}
+
+void scrollback_newer_from_first_page_returns_to_window(void **state)
+{
+    ProfScrollback scrollback = _create_scrollback();
+    will_return(chat_log_get_before, _lines("10:00:00 - buddy: hello"));
+
+    scrollback_older(scrollback);
+    GSList *lines = scrollback_newer(scrollback);
+
+    assert_null(lines);
+    assert_false(scrollback_showing(scrollback));
+
+    scrollback_free(scrollback);
+}
+
+void scrollback_older_again_uses_cached_page(void **state)
+{
+    ProfScrollback scrollback = _create_scrollback();
+    will_return(chat_log_get_before, _lines("10:00:00 - buddy: hello"));
+
+    scrollback_older(scrollback);
+    scrollback_newer(scrollback);
+    GSList *lines = scrollback_older(scrollback);
+
+    assert_non_null(lines);
+    assert_string_equal("10:00:00 - buddy: hello", lines->data);
+
+    scrollback_free(scrollback);
+}
+
+void scrollback_newer_rereads_evicted_page(void **state)
+{
+    ProfScrollback scrollback = _create_scrollback();
+    int i;
+    for (i = 0; i <= SCROLLBACK_CACHED_PAGES; i++) {
+        will_return(chat_log_get_before, _lines("old line"));
+        scrollback_older(scrollback);
+    }
+
+    expect_value(chat_log_get_range, end, 100);
+    will_return(chat_log_get_range, _lines("10:00:00 - buddy: reread"));
+
+    GSList *lines = NULL;
+    for (i = 0; i < SCROLLBACK_CACHED_PAGES; i++) {
+        lines = scrollback_newer(scrollback);
+    }
+
+    assert_non_null(lines);
+    assert_string_equal("10:00:00 - buddy: reread", lines->data);
+
+    scrollback_free(scrollback);
+}
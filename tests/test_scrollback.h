@@ -0,0 +1,5 @@
+void scrollback_older_returns_page_from_log(void **state);
+void scrollback_older_returns_null_at_start_of_log(void **state);
+void scrollback_newer_from_first_page_returns_to_window(void **state);
+void scrollback_older_again_uses_cached_page(void **state);
+void scrollback_newer_rereads_evicted_page(void **state);
@@ -0,0 +1,274 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <glib.h>
+
+#include "common.h"
+#include "helpers.h"
+#include "search.h"
+
+#define LOGIN "me@server.org"
+#define CHATLOGS_DIR "./tests/files/xdg_data_home/profanity/chatlogs"
+#define LOGS_DIR CHATLOGS_DIR "/me_at_server.org"
+#define INDEX_FILE LOGS_DIR "/searchindex.bin"
+
+// append a line to a day log as the chat logs do, adding it to the index
+// when indexed is TRUE
+static void
+_log(const char * const contact, gboolean room, guint32 date,
+    const char * const line, gboolean indexed)
+{
+    char *contact_dir = str_replace(contact, "@", "_at_");
+    gchar *dir = g_strdup_printf("%s%s/%s", LOGS_DIR, room ? "/rooms" : "",
+        contact_dir);
+    mkdir_recursive(dir);
+    gchar *filename = g_strdup_printf("%s/%04u_%02u_%02u.log", dir,
+        date / 10000, (date / 100) % 100, date % 100);
+
+    FILE *logp = fopen(filename, "a");
+    long offset = ftell(logp);
+    fprintf(logp, "%s\n", line);
+    fclose(logp);
+
+    if (indexed) {
+        search_add(LOGIN, contact, room, date, offset, line);
+    }
+
+    g_free(filename);
+    g_free(dir);
+    free(contact_dir);
+}
+
+static void
+_finish_build(void)
+{
+    while (g_main_context_iteration(NULL, FALSE));
+}
+
+static void
+_remove_dir(const char * const path)
+{
+    GDir *dir = g_dir_open(path, 0, NULL);
+    if (dir != NULL) {
+        const gchar *name;
+        while ((name = g_dir_read_name(dir)) != NULL) {
+            gchar *child = g_strdup_printf("%s/%s", path, name);
+            _remove_dir(child);
+            g_free(child);
+        }
+        g_dir_close(dir);
+    }
+    remove(path);
+}
+
+static GSList *
+_query(const char * const query)
+{
+    gchar **args = g_strsplit(query, " ", 0);
+    GSList *results = NULL;
+    gboolean valid = search_query(LOGIN, args, &results);
+    g_strfreev(args);
+    assert_true(valid);
+
+    return results;
+}
+
+void create_search_logs(void **state)
+{
+    create_data_dir(state);
+
+    // logged before the index existed
+    _log("bob@server.org", FALSE, 20140301,
+        "10:00:00 - bob: Are we still on for lunch", FALSE);
+    _log("bob@server.org", FALSE, 20140302,
+        "11:00:00 - me: lunch is still on", FALSE);
+
+    _log("kate@server.org", FALSE, 20140310,
+        "12:00:00 - kate: I had lunch already", TRUE);
+    _log("room@conference.server.org", TRUE, 20140315,
+        "13:00:00 - mike: who is still here", TRUE);
+    _finish_build();
+}
+
+void remove_search_logs(void **state)
+{
+    search_close();
+    _remove_dir(CHATLOGS_DIR);
+    remove_data_dir(state);
+}
+
+void search_finds_word(void **state)
+{
+    GSList *results = _query("lunch");
+
+    assert_int_equal(3, g_slist_length(results));
+    assert_non_null(strstr(results->data, "Are we still on for lunch"));
+    assert_non_null(strstr(g_slist_last(results)->data, "I had lunch already"));
+
+    g_slist_free_full(results, free);
+}
+
+void search_ignores_case(void **state)
+{
+    GSList *results = _query("LUNCH");
+
+    assert_int_equal(3, g_slist_length(results));
+
+    g_slist_free_full(results, free);
+}
+
+void search_finds_phrase(void **state)
+{
+    gchar *args[] = { "still on", NULL };
+    GSList *results = NULL;
+    search_query(LOGIN, args, &results);
+
+    assert_int_equal(2, g_slist_length(results));
+
+    g_slist_free_full(results, free);
+}
+
+void search_phrase_requires_adjacent_words(void **state)
+{
+    gchar *args[] = { "lunch still", NULL };
+    GSList *results = NULL;
+    search_query(LOGIN, args, &results);
+
+    assert_int_equal(0, g_slist_length(results));
+
+    g_slist_free_full(results, free);
+}
+
+void search_filters_by_contact(void **state)
+{
+    GSList *results = _query("still with:room@conference.server.org");
+
+    assert_int_equal(1, g_slist_length(results));
+    assert_non_null(strstr(results->data, "who is still here"));
+
+    g_slist_free_full(results, free);
+}
+
+void search_filters_by_date(void **state)
+{
+    GSList *results = _query("lunch from:2014-03-02 to:2014-03-09");
+
+    assert_int_equal(1, g_slist_length(results));
+    assert_non_null(strstr(results->data, "lunch is still on"));
+
+    g_slist_free_full(results, free);
+}
+
+void search_invalid_date_returns_false(void **state)
+{
+    gchar *args[] = { "lunch", "from:2014-02-30", NULL };
+    GSList *results = NULL;
+    gboolean valid = search_query(LOGIN, args, &results);
+
+    assert_false(valid);
+    assert_null(results);
+}
+
+void search_finds_lines_after_close(void **state)
+{
+    search_close();
+
+    GSList *results = _query("lunch with:kate@server.org");
+
+    assert_int_equal(1, g_slist_length(results));
+    assert_non_null(strstr(results->data, "I had lunch already"));
+
+    g_slist_free_full(results, free);
+}
+
+void search_adds_lines_logged_after_build(void **state)
+{
+    _log("bob@server.org", FALSE, 20140302, "11:05:00 - bob: see you at lunch", TRUE);
+    _log("dave@server.org", FALSE, 20140320, "09:00:00 - dave: lunch tomorrow?", TRUE);
+
+    GSList *results = _query("lunch");
+    assert_int_equal(5, g_slist_length(results));
+    g_slist_free_full(results, free);
+
+    search_close();
+
+    results = _query("lunch");
+    assert_int_equal(5, g_slist_length(results));
+    assert_non_null(strstr(g_slist_last(results)->data, "lunch tomorrow?"));
+    g_slist_free_full(results, free);
+}
+
+void search_resumes_interrupted_build(void **state)
+{
+    _log("bob@server.org", FALSE, 20140301, "10:00:00 - bob: lunch", FALSE);
+    _log("bob@server.org", FALSE, 20140302, "10:00:00 - bob: lunch", FALSE);
+    _log("kate@server.org", FALSE, 20140303, "10:00:00 - kate: lunch", FALSE);
+
+    // one day log is added on each pass of the main loop
+    assert_false(search_built(LOGIN));
+    g_main_context_iteration(NULL, FALSE);
+    search_close();
+
+    assert_false(search_built(LOGIN));
+    _finish_build();
+    assert_true(search_built(LOGIN));
+
+    GSList *results = _query("lunch");
+    assert_int_equal(3, g_slist_length(results));
+    g_slist_free_full(results, free);
+}
+
+void search_build_reads_lines_logged_while_waiting(void **state)
+{
+    _log("bob@server.org", FALSE, 20140301, "10:00:00 - bob: lunch", FALSE);
+    assert_false(search_built(LOGIN));
+
+    // left for the build, which reads the whole day log
+    _log("bob@server.org", FALSE, 20140301, "10:01:00 - me: lunch", TRUE);
+    _finish_build();
+
+    GSList *results = _query("lunch");
+    assert_int_equal(2, g_slist_length(results));
+    g_slist_free_full(results, free);
+}
+
+void search_truncates_torn_append(void **state)
+{
+    search_close();
+
+    // part of a record left by an interrupted write
+    FILE *index = fopen(INDEX_FILE, "ab");
+    guint32 partial[] = { 3, 100, 0 };
+    fwrite(partial, sizeof(guint32), 3, index);
+    fclose(index);
+
+    GSList *results = _query("lunch");
+    assert_int_equal(3, g_slist_length(results));
+    g_slist_free_full(results, free);
+
+    _log("kate@server.org", FALSE, 20140310, "12:30:00 - kate: lunch was good", TRUE);
+    search_close();
+
+    results = _query("lunch");
+    assert_int_equal(4, g_slist_length(results));
+    g_slist_free_full(results, free);
+}
+
+void search_adds_lines_logged_before_index_read(void **state)
+{
+    search_close();
+
+    // the index file is read from the main loop, not by logging a line
+    _log("kate@server.org", FALSE, 20140310, "12:30:00 - kate: lunch was good", TRUE);
+    search_close();
+
+    GSList *results = _query("lunch");
+    assert_int_equal(4, g_slist_length(results));
+    assert_non_null(strstr(g_slist_last(results)->data, "lunch was good"));
+    g_slist_free_full(results, free);
+}
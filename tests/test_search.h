@@ -0,0 +1,15 @@
+void create_search_logs(void **state);
+void remove_search_logs(void **state);
+void search_finds_word(void **state);
+void search_ignores_case(void **state);
+void search_finds_phrase(void **state);
+void search_phrase_requires_adjacent_words(void **state);
+void search_filters_by_contact(void **state);
+void search_filters_by_date(void **state);
+void search_invalid_date_returns_false(void **state);
+void search_finds_lines_after_close(void **state);
+void search_adds_lines_logged_after_build(void **state);
+void search_adds_lines_logged_before_index_read(void **state);
+void search_resumes_interrupted_build(void **state);
+void search_build_reads_lines_logged_while_waiting(void **state);
+void search_truncates_torn_append(void **state);
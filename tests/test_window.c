@@ -0,0 +1,186 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdlib.h>
+#include <glib.h>
+
+#include "ui/buffer.h"
+#include "ui/window.h"
+
+static ProfBuff buffer;
+
+static ProfBuffEntry *
+_layout(int flags, const char * const from, const char * const message,
+    int width, int start_col)
+{
+    buffer = buffer_create(1);
+    buffer_push(buffer, '-', "12:00", flags, 0, from, message);
+    ProfBuffEntry *e = buffer_yield_entry(buffer, 0);
+    win_layout_entry(e, width, start_col);
+
+    return e;
+}
+
+void layout_short_line_takes_one_row(void **state)
+{
+    ProfBuffEntry *e = _layout(NO_DATE, "", "hello", 20, 0);
+
+    assert_int_equal(1, e->rows);
+    assert_int_equal(0, e->end_col);
+
+    buffer_free(buffer);
+}
+
+void layout_wraps_at_width(void **state)
+{
+    ProfBuffEntry *e = _layout(NO_DATE | NO_EOL, "", "abcdefghijklmnopqrstuvwxy", 10, 0);
+
+    assert_int_equal(2, e->rows);
+    assert_int_equal(5, e->end_col);
+
+    buffer_free(buffer);
+}
+
+void layout_full_row_then_newline_leaves_blank_row(void **state)
+{
+    // ncurses moves to the next row after the last column, the newline
+    // then moves down again
+    ProfBuffEntry *e = _layout(NO_DATE, "", "abcdefghij", 10, 0);
+
+    assert_int_equal(2, e->rows);
+    assert_int_equal(0, e->end_col);
+
+    buffer_free(buffer);
+}
+
+void layout_counts_date_and_from(void **state)
+{
+    // "12:00 - bob: hi"
+    ProfBuffEntry *e = _layout(NO_EOL, "bob", "hi", 20, 0);
+
+    assert_int_equal(0, e->rows);
+    assert_int_equal(15, e->end_col);
+
+    buffer_free(buffer);
+}
+
+void layout_me_message(void **state)
+{
+    // "*bob waves"
+    ProfBuffEntry *e = _layout(NO_DATE | NO_EOL, "bob", "/me waves", 20, 0);
+
+    assert_int_equal(0, e->rows);
+    assert_int_equal(10, e->end_col);
+
+    buffer_free(buffer);
+}
+
+void layout_wide_chars_take_two_columns(void **state)
+{
+    // three double width characters
+    ProfBuffEntry *e = _layout(NO_DATE | NO_EOL, "", "\xe4\xb8\xad\xe6\x96\x87\xe5\xad\x97", 10, 0);
+
+    assert_int_equal(0, e->rows);
+    assert_int_equal(6, e->end_col);
+
+    buffer_free(buffer);
+}
+
+void layout_wide_char_not_split_across_rows(void **state)
+{
+    // the third would start in the last column, it moves to the next row
+    ProfBuffEntry *e = _layout(NO_DATE | NO_EOL, "", "\xe4\xb8\xad\xe6\x96\x87\xe5\xad\x97", 5, 0);
+
+    assert_int_equal(1, e->rows);
+    assert_int_equal(2, e->end_col);
+
+    buffer_free(buffer);
+}
+
+void layout_tab_moves_to_next_stop(void **state)
+{
+    ProfBuffEntry *e = _layout(NO_DATE | NO_EOL, "", "a\tb", 20, 0);
+
+    assert_int_equal(0, e->rows);
+    assert_int_equal(9, e->end_col);
+
+    buffer_free(buffer);
+}
+
+void layout_tab_wraps_past_width(void **state)
+{
+    // the tab from column 9 would end past the edge, ncurses moves to the
+    // start of the next row instead
+    ProfBuffEntry *e = _layout(NO_DATE | NO_EOL, "", "abcdefghi\tx", 10, 0);
+
+    assert_int_equal(1, e->rows);
+    assert_int_equal(1, e->end_col);
+
+    buffer_free(buffer);
+}
+
+void layout_control_chars_take_two_columns(void **state)
+{
+    // printed as ^A
+    ProfBuffEntry *e = _layout(NO_DATE | NO_EOL, "", "a\001b", 20, 0);
+
+    assert_int_equal(0, e->rows);
+    assert_int_equal(4, e->end_col);
+
+    buffer_free(buffer);
+}
+
+void layout_newline_in_message_starts_row(void **state)
+{
+    ProfBuffEntry *e = _layout(NO_DATE, "", "one\ntwo", 20, 0);
+
+    assert_int_equal(2, e->rows);
+    assert_int_equal(0, e->end_col);
+
+    buffer_free(buffer);
+}
+
+void layout_no_eol_continues_from_start_col(void **state)
+{
+    ProfBuffEntry *e = _layout(NO_DATE | NO_EOL, "", "abcdefgh", 20, 15);
+
+    assert_int_equal(1, e->rows);
+    assert_int_equal(3, e->end_col);
+
+    buffer_free(buffer);
+}
+
+void layout_recalculated_for_new_width(void **state)
+{
+    ProfBuffEntry *e = _layout(NO_DATE | NO_EOL, "", "abcdefghijklmnopqrstuvwxy", 10, 0);
+    assert_int_equal(2, e->rows);
+
+    win_layout_entry(e, 20, 0);
+
+    assert_int_equal(20, e->layout_width);
+    assert_int_equal(1, e->rows);
+    assert_int_equal(5, e->end_col);
+
+    buffer_free(buffer);
+}
+
+void layout_carriage_return_moves_to_start_of_row(void **state)
+{
+    ProfBuffEntry *e = _layout(NO_DATE | NO_EOL, "", "abcdef\rxy", 20, 0);
+
+    assert_int_equal(0, e->rows);
+    assert_int_equal(2, e->end_col);
+
+    buffer_free(buffer);
+}
+
+void layout_backspace_moves_back_one_column(void **state)
+{
+    ProfBuffEntry *e = _layout(NO_DATE | NO_EOL, "", "abc\b\bd", 20, 0);
+
+    assert_int_equal(0, e->rows);
+    assert_int_equal(2, e->end_col);
+
+    buffer_free(buffer);
+}
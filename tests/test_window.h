@@ -0,0 +1,15 @@
+void layout_short_line_takes_one_row(void **state);
+void layout_wraps_at_width(void **state);
+void layout_full_row_then_newline_leaves_blank_row(void **state);
+void layout_counts_date_and_from(void **state);
+void layout_me_message(void **state);
+void layout_wide_chars_take_two_columns(void **state);
+void layout_wide_char_not_split_across_rows(void **state);
+void layout_tab_moves_to_next_stop(void **state);
+void layout_tab_wraps_past_width(void **state);
+void layout_control_chars_take_two_columns(void **state);
+void layout_newline_in_message_starts_row(void **state);
+void layout_no_eol_continues_from_start_col(void **state);
+void layout_recalculated_for_new_width(void **state);
+void layout_carriage_return_moves_to_start_of_row(void **state);
+void layout_backspace_moves_back_one_column(void **state);
@@ -32,6 +32,14 @@
 #include "test_cmd_roster.h"
 #include "test_cmd_win.h"
 #include "test_form.h"
+#include "test_buffer.h"
+#include "test_window.h"
+#include "test_scrollback.h"
+#include "test_gapbuffer.h"
+#include "test_capscache.h"
+#include "test_capabilities.h"
+#include "test_search.h"
+#include "test_chat_session.h"
 
 int main(int argc, char* argv[]) {
     const UnitTest all_tests[] = {
@@ -82,6 +90,10 @@ int main(int argc, char* argv[]) {
         unit_test(test_p_sha1_hash5),
         unit_test(test_p_sha1_hash6),
         unit_test(test_p_sha1_hash7),
+        unit_test(test_p_sha1_hash_caps_ver),
+        unit_test(delayed_write_waits_for_changes_to_stop),
+        unit_test(delayed_write_writes_by_deadline_while_changing),
+        unit_test(delayed_write_flush_writes_pending),
 
         unit_test(clear_empty),
         unit_test(reset_after_create),
@@ -93,6 +105,10 @@ int main(int argc, char* argv[]) {
         unit_test(add_two_adds_two),
         unit_test(add_two_same_adds_one),
         unit_test(add_two_same_updates),
+        unit_test(complete_cycles_back_to_first),
+        unit_test(complete_continues_after_add_before_last_found),
+        unit_test(remove_and_contains),
+        unit_test(get_list_is_sorted),
 
         unit_test(previous_on_empty_returns_null),
         unit_test(next_on_empty_returns_null),
@@ -182,6 +198,9 @@ int main(int argc, char* argv[]) {
         unit_test(parse_options_when_three_returns_map),
         unit_test(parse_options_when_unknown_opt_sets_error),
         unit_test(parse_options_with_duplicated_option_sets_error),
+        unit_test(benchmark_parse_args_quoted_64kb),
+        unit_test(benchmark_parse_args_too_many_64kb),
+        unit_test(benchmark_parse_args_with_freetext_64kb),
 
         unit_test(empty_list_when_none_added),
         unit_test(contains_one_element),
@@ -201,6 +220,9 @@ int main(int argc, char* argv[]) {
         unit_test(find_twice_returns_second_when_two_match),
         unit_test(find_five_times_finds_fifth),
         unit_test(find_twice_returns_first_when_two_match_and_reset),
+        unit_test(batch_add_finds_contacts_after_commit),
+        unit_test(batch_add_twice_adds_once),
+        unit_test(batch_add_large_roster),
 
         unit_test(cmd_connect_shows_message_when_disconnecting),
         unit_test(cmd_connect_shows_message_when_connecting),
@@ -369,6 +391,27 @@ int main(int argc, char* argv[]) {
         unit_test_setup_teardown(statuses_muc_defaults_to_all,
             load_preferences,
             close_preferences),
+        unit_test_setup_teardown(set_pref_not_written_until_save,
+            load_preferences,
+            close_preferences),
+        unit_test_setup_teardown(prefs_save_writes_pending_changes,
+            load_preferences,
+            close_preferences),
+        unit_test_setup_teardown(get_string_value_returns_set_value,
+            load_preferences,
+            close_preferences),
+        unit_test_setup_teardown(max_fps_defaults_to_30,
+            load_preferences,
+            close_preferences),
+        unit_test_setup_teardown(max_fps_returns_set_value,
+            load_preferences,
+            close_preferences),
+        unit_test_setup_teardown(buffer_sizes_default_by_window_type,
+            load_preferences,
+            close_preferences),
+        unit_test_setup_teardown(buffer_sizes_read_from_preferences,
+            load_preferences,
+            close_preferences),
 
         unit_test_setup_teardown(console_doesnt_show_online_presence_when_set_none,
             load_preferences,
@@ -552,6 +595,157 @@ int main(int argc, char* argv[]) {
         unit_test(remove_text_multi_value_does_nothing_when_doesnt_exist),
         unit_test(remove_text_multi_value_removes_when_one),
         unit_test(remove_text_multi_value_removes_when_many),
+
+        unit_test(buffer_empty_after_create),
+        unit_test(buffer_push_stores_entry),
+        unit_test(buffer_push_when_full_drops_oldest),
+        unit_test(buffer_push_entry_has_no_layout),
+        unit_test(buffer_pushed_counts_dropped_entries),
+
+        unit_test(layout_short_line_takes_one_row),
+        unit_test(layout_wraps_at_width),
+        unit_test(layout_full_row_then_newline_leaves_blank_row),
+        unit_test(layout_counts_date_and_from),
+        unit_test(layout_me_message),
+        unit_test(layout_wide_chars_take_two_columns),
+        unit_test(layout_wide_char_not_split_across_rows),
+        unit_test(layout_tab_moves_to_next_stop),
+        unit_test(layout_tab_wraps_past_width),
+        unit_test(layout_control_chars_take_two_columns),
+        unit_test(layout_newline_in_message_starts_row),
+        unit_test(layout_no_eol_continues_from_start_col),
+        unit_test(layout_recalculated_for_new_width),
+        unit_test(layout_carriage_return_moves_to_start_of_row),
+        unit_test(layout_backspace_moves_back_one_column),
+
+        unit_test(scrollback_older_returns_page_from_log),
+        unit_test(scrollback_older_returns_null_at_start_of_log),
+        unit_test(scrollback_newer_from_first_page_returns_to_window),
+        unit_test(scrollback_older_again_uses_cached_page),
+        unit_test(scrollback_newer_rereads_evicted_page),
+
+        unit_test(insert_appends_at_cursor),
+        unit_test(insert_in_middle_after_moving_left),
+        unit_test(delete_before_and_after_cursor),
+        unit_test(cursor_tracks_characters_and_columns),
+        unit_test(up_and_down_keep_column),
+        unit_test(up_on_first_line_returns_false),
+        unit_test(set_replaces_text_with_cursor_at_end),
+        unit_test(at_reads_either_side_of_gap),
+        unit_test(take_changed_returns_earliest_edit),
+
+        unit_test_setup_teardown(capscache_get_returns_added_entry,
+            create_data_dir,
+            remove_data_dir),
+        unit_test_setup_teardown(capscache_get_returns_null_when_not_cached,
+            create_data_dir,
+            remove_data_dir),
+        unit_test_setup_teardown(capscache_reopen_finds_entries,
+            create_data_dir,
+            remove_data_dir),
+        unit_test_setup_teardown(capscache_compact_keeps_entries,
+            create_data_dir,
+            remove_data_dir),
+        unit_test_setup_teardown(capscache_ignores_invalid_file,
+            create_data_dir,
+            remove_data_dir),
+        unit_test_setup_teardown(capscache_truncates_torn_append,
+            create_data_dir,
+            remove_data_dir),
+        unit_test_setup_teardown(capscache_add_all_writes_compacted,
+            create_data_dir,
+            remove_data_dir),
+
+        unit_test(caps_sha1_str_simple_generation),
+        unit_test(caps_sha1_str_complex_generation),
+        unit_test(caps_sha1_str_ignores_element_order),
+        unit_test(caps_sha1_str_reused_after_larger_query),
+        unit_test_setup_teardown(caps_request_sends_one_request_per_ver,
+            init_caps,
+            close_caps),
+        unit_test_setup_teardown(caps_request_failed_asks_next_jid,
+            init_caps,
+            close_caps),
+        unit_test_setup_teardown(caps_request_dropped_when_every_jid_failed,
+            init_caps,
+            close_caps),
+        unit_test_setup_teardown(caps_request_complete_maps_every_waiter,
+            init_caps,
+            close_caps),
+        unit_test_setup_teardown(caps_lookup_returns_shared_entry,
+            init_caps,
+            close_caps),
+        unit_test_setup_teardown(caps_unref_keeps_table_reference,
+            init_caps,
+            close_caps),
+        unit_test_setup_teardown(caps_jid_supports_advertised_feature,
+            init_caps,
+            close_caps),
+        unit_test_setup_teardown(caps_jid_supports_false_for_unknown_feature,
+            init_caps,
+            close_caps),
+        unit_test_setup_teardown(caps_jid_supports_false_for_feature_seen_after_bitset,
+            init_caps,
+            close_caps),
+        unit_test_setup_teardown(caps_jid_supports_bare_jid_asks_available_resources,
+            init_caps,
+            close_caps),
+
+        unit_test_setup_teardown(search_finds_word,
+            create_search_logs,
+            remove_search_logs),
+        unit_test_setup_teardown(search_ignores_case,
+            create_search_logs,
+            remove_search_logs),
+        unit_test_setup_teardown(search_finds_phrase,
+            create_search_logs,
+            remove_search_logs),
+        unit_test_setup_teardown(search_phrase_requires_adjacent_words,
+            create_search_logs,
+            remove_search_logs),
+        unit_test_setup_teardown(search_filters_by_contact,
+            create_search_logs,
+            remove_search_logs),
+        unit_test_setup_teardown(search_filters_by_date,
+            create_search_logs,
+            remove_search_logs),
+        unit_test_setup_teardown(search_invalid_date_returns_false,
+            create_search_logs,
+            remove_search_logs),
+        unit_test_setup_teardown(search_finds_lines_after_close,
+            create_search_logs,
+            remove_search_logs),
+        unit_test_setup_teardown(search_adds_lines_logged_after_build,
+            create_search_logs,
+            remove_search_logs),
+        unit_test_setup_teardown(search_adds_lines_logged_before_index_read,
+            create_search_logs,
+            remove_search_logs),
+        unit_test_setup_teardown(search_resumes_interrupted_build,
+            create_data_dir,
+            remove_search_logs),
+        unit_test_setup_teardown(search_build_reads_lines_logged_while_waiting,
+            create_data_dir,
+            remove_search_logs),
+        unit_test_setup_teardown(search_truncates_torn_append,
+            create_search_logs,
+            remove_search_logs),
+
+        unit_test_setup_teardown(next_state_change_none_without_sessions,
+            load_preferences,
+            close_preferences),
+        unit_test_setup_teardown(next_state_change_inactive_after_start,
+            load_preferences,
+            close_preferences),
+        unit_test_setup_teardown(next_state_change_paused_when_composing,
+            load_preferences,
+            close_preferences),
+        unit_test_setup_teardown(next_state_change_none_when_recipient_unsupported,
+            load_preferences,
+            close_preferences),
+        unit_test_setup_teardown(next_state_change_none_when_gone,
+            load_preferences,
+            close_preferences),
     };
 
     return run_tests(all_tests);
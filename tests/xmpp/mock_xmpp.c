@@ -118,6 +118,18 @@ _mock_roster_send_name_change(const char * const barejid, const char * const new
     check_expected(groups);
 }
 
+static char *caps_request_id = NULL;
+
+static void
+_mock_iq_send_caps_request(const char * const to, const char * const id,
+    const char * const node, const char * const ver)
+{
+    check_expected(to);
+    check_expected(ver);
+    free(caps_request_id);
+    caps_request_id = strdup(id);
+}
+
 void
 mock_jabber_connect_with_details(void)
 {
@@ -179,6 +191,12 @@ mock_roster_send_name_change(void)
     roster_send_name_change = _mock_roster_send_name_change;
 }
 
+void
+mock_iq_send_caps_request(void)
+{
+    iq_send_caps_request = _mock_iq_send_caps_request;
+}
+
 void
 bookmark_get_list_returns(GList *bookmarks)
 {
@@ -332,3 +350,17 @@ roster_send_name_change_expect(char *jid, char *nick, GSList *groups)
     }
     expect_memory(_mock_roster_send_name_change, groups, groups, sizeof(GSList));
 }
+
+void
+iq_send_caps_request_expect(char *to, char *ver)
+{
+    expect_string(_mock_iq_send_caps_request, to, to);
+    expect_string(_mock_iq_send_caps_request, ver, ver);
+}
+
+// the id of the last request sent, for answering it
+const char *
+iq_send_caps_request_last_id(void)
+{
+    return caps_request_id;
+}
@@ -44,4 +44,8 @@ void roster_send_remove_expect(char *jid);
 void mock_roster_send_name_change(void);
 void roster_send_name_change_expect(char *jid, char *name, GSList *groups);
 
+void mock_iq_send_caps_request(void);
+void iq_send_caps_request_expect(char *to, char *ver);
+const char * iq_send_caps_request_last_id(void);
+
 #endif